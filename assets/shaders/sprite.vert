@@ -0,0 +1,34 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(push_constant) uniform Camera {
+    vec2 scale;
+    vec2 offset;
+} camera;
+
+// Per vertex, the unit quad
+layout(location = 0) in vec2 inCorner;
+layout(location = 1) in vec3 inColor;
+
+// Per instance, see Vertex::SpriteInstance
+layout(location = 2) in vec2 inPosition;
+layout(location = 3) in vec2 inSize;
+layout(location = 4) in vec4 inUVRect;
+layout(location = 5) in vec4 inTint;
+layout(location = 6) in float inLayer;
+
+layout(location = 0) out vec2 fragUV;
+layout(location = 1) out vec4 fragColor;
+
+out gl_PerVertex {
+    vec4 gl_Position;
+};
+
+void main() {
+    vec2 world = inPosition + inCorner * inSize;
+    // Higher layers get a smaller depth so a depth test, once there is one, agrees with the draw order.
+    float depth = 1.0 - clamp(inLayer, 0.0, 255.0) / 256.0;
+    gl_Position = vec4(world * camera.scale + camera.offset, depth, 1.0);
+    fragUV = mix(inUVRect.xy, inUVRect.zw, inCorner);
+    fragColor = vec4(inColor, 1.0) * inTint;
+}
\ No newline at end of file
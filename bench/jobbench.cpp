@@ -0,0 +1,148 @@
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <thread>
+
+#include "jobsystem.h"
+
+// Job system microbenchmarks: raw spawn/run overhead, stealing under recursive splitting,
+// and ParallelFor scaling from one worker thread up to every hardware thread.
+// Usage: ./jobbench [scaling elements]
+
+const uint32_t SPAWN_JOBS = 1000000;
+const uint32_t SPAWN_BATCH = 1024; // Below the deque capacity, so nothing runs inline on overflow
+const uint32_t SPLIT_LEAF_SIZE = 256;
+
+using Clock = std::chrono::steady_clock;
+
+static double elapsedMilliseconds(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Per-element work heavy enough that scaling is limited by the scheduler and memory, not by job overhead.
+static float work(float value)
+{
+    for (int i = 0; i < 32; i++)
+    {
+        value = std::sqrt(value * value + 1.0f) * 0.5f;
+    }
+    return value;
+}
+
+struct SplitTask
+{
+    const float *values;
+    size_t begin;
+    size_t end;
+    double *result;
+};
+
+// Halves the range until it is small, spawning one half and recursing into the other, like a parallel reduce.
+static void splitSum(SplitTask task)
+{
+    if (task.end - task.begin <= SPLIT_LEAF_SIZE)
+    {
+        double sum = 0.0;
+        for (size_t i = task.begin; i < task.end; i++)
+        {
+            sum += task.values[i];
+        }
+        *task.result = sum;
+        return;
+    }
+
+    size_t middle = task.begin + (task.end - task.begin) / 2;
+    double left = 0.0;
+    double right = 0.0;
+    SplitTask leftTask = {task.values, task.begin, middle, &left};
+    SplitTask rightTask = {task.values, middle, task.end, &right};
+    JobSystem::Counter counter;
+    JobSystem::Run([rightTask]() { splitSum(rightTask); }, &counter);
+    splitSum(leftTask);
+    JobSystem::Wait(counter);
+    *task.result = left + right;
+}
+
+static void benchmarkSpawn()
+{
+    JobSystem::ResetStats();
+    Clock::time_point start = Clock::now();
+    for (uint32_t batch = 0; batch < SPAWN_JOBS / SPAWN_BATCH; batch++)
+    {
+        JobSystem::Counter counter;
+        for (uint32_t i = 0; i < SPAWN_BATCH; i++)
+        {
+            JobSystem::Run([]() {}, &counter);
+        }
+        JobSystem::Wait(counter);
+    }
+    double milliseconds = elapsedMilliseconds(start);
+    JobSystem::Stats stats = JobSystem::GetStats();
+    std::cout << "spawn+run empty jobs: " << milliseconds * 1e6 / SPAWN_JOBS << "ns/job, "
+              << stats.jobsStolen << " of " << stats.jobsExecuted << " stolen" << std::endl;
+}
+
+static void benchmarkSteal(const std::vector<float> &values)
+{
+    JobSystem::ResetStats();
+    double sum = 0.0;
+    Clock::time_point start = Clock::now();
+    splitSum({values.data(), 0, values.size(), &sum});
+    double milliseconds = elapsedMilliseconds(start);
+    JobSystem::Stats stats = JobSystem::GetStats();
+    std::cout << "recursive split sum: " << milliseconds << "ms, " << stats.jobsStolen << " of " << stats.jobsExecuted
+              << " jobs stolen (sum " << sum << ")" << std::endl;
+}
+
+static double runScaling(const std::vector<float> &input, std::vector<float> &output)
+{
+    Clock::time_point start = Clock::now();
+    JobSystem::ParallelFor(input.size(), 4096, [&input, &output](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+        {
+            output[i] = work(input[i]);
+        }
+    });
+    return elapsedMilliseconds(start);
+}
+
+int main(int argc, const char *argv[])
+{
+    size_t elementCount = argc > 1 ? static_cast<size_t>(std::atoll(argv[1])) : 4 * 1024 * 1024;
+    std::vector<float> input(elementCount);
+    std::vector<float> output(elementCount);
+    for (size_t i = 0; i < elementCount; i++)
+    {
+        input[i] = static_cast<float>(i % 1000);
+    }
+
+    JobSystem::Init();
+    std::cout << "workers: " << JobSystem::GetWorkerCount() << std::endl;
+    benchmarkSpawn();
+    benchmarkSteal(input);
+    JobSystem::Shutdown();
+
+    Clock::time_point serialStart = Clock::now();
+    for (size_t i = 0; i < elementCount; i++)
+    {
+        output[i] = work(input[i]);
+    }
+    double serialMilliseconds = elapsedMilliseconds(serialStart);
+    std::cout << "ParallelFor over " << elementCount << " elements, serial loop: " << serialMilliseconds << "ms" << std::endl;
+    std::cout << "workers\tms\tspeedup" << std::endl;
+
+    uint32_t hardwareThreads = std::max(2u, std::thread::hardware_concurrency());
+    for (uint32_t workerThreads = 1; workerThreads < hardwareThreads; workerThreads++)
+    {
+        JobSystem::Init(workerThreads);
+        runScaling(input, output); // Warm up, lets every worker get scheduled once
+        double milliseconds = runScaling(input, output);
+        std::cout << JobSystem::GetWorkerCount() << "\t" << milliseconds << "\t" << serialMilliseconds / milliseconds << "x" << std::endl;
+        JobSystem::Shutdown();
+    }
+
+    return EXIT_SUCCESS;
+}
\ No newline at end of file
@@ -0,0 +1,91 @@
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+
+#include "meshoptimizer.h"
+
+// Mesh optimizer throughput and cache efficiency on a shuffled grid, plus the small meshes that once lost triangles.
+// Exits with 1 if any mesh comes out with a different triangle count than it went in with.
+// Usage: ./meshbench [grid size]
+
+using Clock = std::chrono::steady_clock;
+
+static double elapsedMilliseconds(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static Vertex::Vertex gridVertex(uint32_t x, uint32_t y, uint32_t size)
+{
+    return {VertexFormat::Snorm16x2(x * 2.0f / size - 1.0f, y * 2.0f / size - 1.0f), VertexFormat::Unorm8x4(1.0f, 1.0f, 1.0f)};
+}
+
+// Two triangles per cell, in random order, so there is something for the cache optimization to fix.
+static std::vector<Vertex::Vertex> shuffledGrid(uint32_t size)
+{
+    std::vector<std::array<Vertex::Vertex, 3>> triangles;
+    for (uint32_t y = 0; y < size; y++)
+    {
+        for (uint32_t x = 0; x < size; x++)
+        {
+            triangles.push_back({gridVertex(x, y, size), gridVertex(x + 1, y, size), gridVertex(x + 1, y + 1, size)});
+            triangles.push_back({gridVertex(x, y, size), gridVertex(x + 1, y + 1, size), gridVertex(x, y + 1, size)});
+        }
+    }
+    std::mt19937 random(1);
+    std::shuffle(triangles.begin(), triangles.end(), random);
+    std::vector<Vertex::Vertex> list;
+    for (const std::array<Vertex::Vertex, 3> &triangle : triangles)
+    {
+        list.insert(list.end(), triangle.begin(), triangle.end());
+    }
+    return list;
+}
+
+static bool keepsTriangles(const char *name, const std::vector<Vertex::Vertex> &triangleList)
+{
+    MeshOptimizer::IndexedMesh mesh = MeshOptimizer::Build(triangleList);
+    bool kept = mesh.indices.size() == triangleList.size();
+    std::cout << name << ": " << triangleList.size() / 3 << " triangles in, " << mesh.indices.size() / 3 << " out" << (kept ? "" : "  FAILED") << std::endl;
+    return kept;
+}
+
+int main(int argc, const char *argv[])
+{
+    uint32_t gridSize = argc > 1 ? static_cast<uint32_t>(std::atoi(argv[1])) : 256;
+
+    bool passed = true;
+    // Leading triangles that don't miss three times: a degenerate one, and one sharing vertices with the next.
+    std::vector<Vertex::Vertex> strip = shuffledGrid(4);
+    std::vector<Vertex::Vertex> leadingDegenerate = {strip[0], strip[0], strip[0]};
+    leadingDegenerate.insert(leadingDegenerate.end(), strip.begin(), strip.end());
+    passed &= keepsTriangles("leading degenerate", leadingDegenerate);
+    passed &= keepsTriangles("single degenerate", {strip[0], strip[0], strip[0]});
+    std::vector<Vertex::Vertex> partiallyCached = {strip[0], strip[1], strip[0]};
+    partiallyCached.insert(partiallyCached.end(), strip.begin(), strip.end());
+    passed &= keepsTriangles("partially cached first", partiallyCached);
+
+    std::vector<Vertex::Vertex> grid = shuffledGrid(gridSize);
+    MeshOptimizer::IndexedMesh mesh = MeshOptimizer::Deduplicate(grid);
+    float before = MeshOptimizer::AverageCacheMissRatio(mesh.indices, mesh.vertices.size());
+
+    Clock::time_point start = Clock::now();
+    MeshOptimizer::OptimizeVertexCache(mesh.indices, mesh.vertices.size());
+    double cacheMilliseconds = elapsedMilliseconds(start);
+    float afterCache = MeshOptimizer::AverageCacheMissRatio(mesh.indices, mesh.vertices.size());
+
+    start = Clock::now();
+    MeshOptimizer::OptimizeOverdraw(mesh.indices, MeshOptimizer::Positions(mesh.vertices));
+    double overdrawMilliseconds = elapsedMilliseconds(start);
+    float afterOverdraw = MeshOptimizer::AverageCacheMissRatio(mesh.indices, mesh.vertices.size());
+    passed &= mesh.indices.size() == grid.size();
+
+    std::cout << gridSize << "x" << gridSize << " grid, " << grid.size() / 3 << " triangles, " << mesh.vertices.size() << " vertices" << std::endl;
+    std::cout << "OptimizeVertexCache: " << cacheMilliseconds << "ms, miss ratio " << before << " -> " << afterCache << std::endl;
+    std::cout << "OptimizeOverdraw: " << overdrawMilliseconds << "ms, miss ratio " << afterCache << " -> " << afterOverdraw << std::endl;
+    return passed ? 0 : 1;
+}
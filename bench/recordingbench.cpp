@@ -0,0 +1,95 @@
+#include <SDL2/SDL.h>
+#include <vulkan/vulkan.h>
+
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+
+#include "renderer.h"
+#include "jobsystem.h"
+
+// Measures CPU time spent recording the frame's command buffers against the number of recording threads.
+// Usage: ./recordingbench [draws per frame] [measured frames]
+// Run from the build directory so ./assets resolves. One worker is the inline, single threaded path.
+
+const int WARMUP_FRAMES = 20;
+
+static void pumpEvents()
+{
+    SDL_Event e;
+    while (SDL_PollEvent(&e))
+    {
+    }
+}
+
+static void drawFrame(Renderer &renderer, uint32_t drawCount)
+{
+    DrawCommand triangle = renderer.CreateMeshDraw(renderer.GetDemoMesh());
+    for (uint32_t i = 0; i < drawCount; i++)
+    {
+        renderer.Draw(triangle);
+    }
+    renderer.DrawFrame();
+    pumpEvents();
+}
+
+int main(int argc, const char *argv[])
+{
+    uint32_t drawCount = argc > 1 ? static_cast<uint32_t>(std::atoi(argv[1])) : 20000;
+    int frameCount = argc > 2 ? std::atoi(argv[2]) : 200;
+
+    if (SDL_Init(SDL_INIT_VIDEO) < 0)
+    {
+        std::cerr << "Failed to initialize SDL2: " << SDL_GetError() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    JobSystem::Init();
+    try
+    {
+        Renderer renderer;
+        uint32_t maxWorkers = JobSystem::GetWorkerCount();
+        double singleThreadMilliseconds = 0.0;
+
+        std::cout << "draws/frame: " << drawCount << ", frames: " << frameCount << std::endl;
+        std::cout << "workers\tsecondaries\tavg ms\tmin ms\tspeedup" << std::endl;
+        for (uint32_t workers = 1; workers <= maxWorkers; workers++)
+        {
+            renderer.SetRecordingWorkers(workers);
+            for (int i = 0; i < WARMUP_FRAMES; i++)
+            {
+                drawFrame(renderer, drawCount);
+            }
+
+            double total = 0.0;
+            double best = 1e30;
+            for (int i = 0; i < frameCount; i++)
+            {
+                drawFrame(renderer, drawCount);
+                double recordMilliseconds = renderer.GetLastFrameStats().recordMilliseconds;
+                total += recordMilliseconds;
+                best = std::min(best, recordMilliseconds);
+            }
+
+            double average = total / frameCount;
+            if (workers == 1)
+            {
+                singleThreadMilliseconds = average;
+            }
+            std::cout << workers << "\t" << renderer.GetLastFrameStats().secondaryBuffers << "\t\t" << average << "\t" << best << "\t" << singleThreadMilliseconds / average << "x" << std::endl;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        JobSystem::Shutdown();
+        SDL_Quit();
+        return EXIT_FAILURE;
+    }
+
+    JobSystem::Shutdown();
+    SDL_Quit();
+    return EXIT_SUCCESS;
+}
\ No newline at end of file
@@ -0,0 +1,370 @@
+#include <SDL2/SDL.h>
+#include <vulkan/vulkan.h>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <stdexcept>
+#include <algorithm>
+#include <functional>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "renderer.h"
+#include "jobsystem.h"
+
+// Drives a headless renderer through fixed scenarios and writes the results as JSON, one object per scenario.
+// Usage: ./renderbench [--frames N] [--output renderbench.json]
+// Run from the build directory so ./assets resolves. Configure with -DCMAKE_BUILD_TYPE=Release, the build type
+// ends up in the results so Debug numbers aren't compared against Release ones by accident.
+
+#ifndef ROGUE_BUILD_TYPE
+#define ROGUE_BUILD_TYPE "unknown"
+#endif
+#ifndef ROGUE_VERSION
+#define ROGUE_VERSION "unknown"
+#endif
+
+const uint32_t BENCH_WIDTH = 1280, BENCH_HEIGHT = 720;
+const int WARMUP_FRAMES = 30;
+const int PIPELINE_RUNS = 10;
+
+// Every heap allocation in the process goes through here, so steady state frames can be checked for allocating.
+static std::atomic<uint64_t> heapAllocations{0};
+
+void *operator new(std::size_t size)
+{
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    void *memory = std::malloc(size > 0 ? size : 1);
+    if (memory == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void operator delete(void *memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void *memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+struct Percentiles
+{
+    double p50 = 0.0, p90 = 0.0, p99 = 0.0, max = 0.0, mean = 0.0;
+};
+
+struct ScenarioResult
+{
+    std::string name;
+    int frames = 0;
+    Percentiles frameMilliseconds;
+    Percentiles recordMilliseconds;
+    double gpuMilliseconds = 0.0; // Mean of the "frame" GPU scope, 0 without timestamp support
+    uint32_t drawCalls = 0;
+    uint32_t instances = 0;
+    double heapAllocationsPerFrame = 0.0;
+    uint32_t deviceMemoryAllocations = 0;
+    uint32_t deviceSubAllocations = 0;
+    VkDeviceSize peakDeviceBytes = 0;
+    long peakResidentKilobytes = 0;
+    // Scenarios that don't time frames (pipeline creation) put their numbers here.
+    std::vector<std::pair<std::string, double>> extra;
+};
+
+static Percentiles percentiles(std::vector<double> samples)
+{
+    Percentiles result;
+    if (samples.empty())
+    {
+        return result;
+    }
+    std::sort(samples.begin(), samples.end());
+    double total = 0.0;
+    for (double sample : samples)
+    {
+        total += sample;
+    }
+    // Nearest rank
+    auto rank = [&samples](double percentile) { return samples[std::min(samples.size() - 1, static_cast<size_t>(percentile * samples.size()))]; };
+    result.p50 = rank(0.50);
+    result.p90 = rank(0.90);
+    result.p99 = rank(0.99);
+    result.max = samples.back();
+    result.mean = total / samples.size();
+    return result;
+}
+
+static long peakResidentKilobytes()
+{
+#ifdef _WIN32
+    // The peak working set is the closest Windows has to max RSS. K32GetProcessMemoryInfo lives in kernel32, so
+    // there is no psapi.lib to link.
+    PROCESS_MEMORY_COUNTERS counters = {};
+    K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+    return static_cast<long>(counters.PeakWorkingSetSize / 1024);
+#else
+    rusage usage = {};
+    getrusage(RUSAGE_SELF, &usage);
+    // Kilobytes on Linux, bytes on macOS.
+#if __APPLE__
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+#endif
+}
+
+static void pumpEvents()
+{
+    SDL_Event e;
+    while (SDL_PollEvent(&e))
+    {
+    }
+}
+
+// Runs WARMUP_FRAMES and then frameCount measured frames of `frame`, which queues draws for frame i.
+// Frame time is wall clock around queueing and DrawFrame, the same span the game loop spends per frame minus pacing.
+static ScenarioResult runScenario(Renderer &renderer, const std::string &name, int frameCount, const std::function<void(Renderer &, int)> &frame)
+{
+    std::cout << "Running scenario " << name << "..." << std::endl;
+    for (int i = 0; i < WARMUP_FRAMES; i++)
+    {
+        frame(renderer, i);
+        renderer.DrawFrame();
+        pumpEvents();
+    }
+
+    std::vector<double> frameTimes;
+    std::vector<double> recordTimes;
+    frameTimes.reserve(frameCount);
+    recordTimes.reserve(frameCount);
+    double gpuTotal = 0.0;
+    ScenarioResult result;
+    result.name = name;
+    result.frames = frameCount;
+
+    uint64_t allocationsBefore = heapAllocations.load(std::memory_order_relaxed);
+    for (int i = 0; i < frameCount; i++)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        frame(renderer, WARMUP_FRAMES + i);
+        renderer.DrawFrame();
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        // Reserved up front, so these don't count towards the frame's allocations.
+        frameTimes.push_back(elapsed.count());
+        recordTimes.push_back(renderer.GetLastFrameStats().recordMilliseconds);
+        gpuTotal += renderer.GetLastFrameStats().gpuMilliseconds;
+        result.peakDeviceBytes = std::max(result.peakDeviceBytes, renderer.GetAllocator().GetStats().bytesReserved);
+        pumpEvents();
+    }
+    uint64_t allocations = heapAllocations.load(std::memory_order_relaxed) - allocationsBefore;
+
+    const FrameStats &stats = renderer.GetLastFrameStats();
+    Memory::AllocatorStats allocatorStats = renderer.GetAllocator().GetStats();
+    result.frameMilliseconds = percentiles(frameTimes);
+    result.recordMilliseconds = percentiles(recordTimes);
+    result.gpuMilliseconds = frameCount > 0 ? gpuTotal / frameCount : 0.0;
+    result.drawCalls = stats.drawCalls;
+    result.instances = stats.instances;
+    result.heapAllocationsPerFrame = frameCount > 0 ? static_cast<double>(allocations) / frameCount : 0.0;
+    result.deviceMemoryAllocations = allocatorStats.deviceMemoryCount;
+    result.deviceSubAllocations = allocatorStats.allocationCount;
+    result.peakResidentKilobytes = peakResidentKilobytes();
+    return result;
+}
+
+static void drawTriangle(Renderer &renderer, int)
+{
+    renderer.Draw(renderer.CreateMeshDraw(renderer.GetDemoMesh()));
+}
+
+// Quads spread over the visible area with a fixed seed, so every run draws the same thing.
+static std::vector<Vertex::SpriteInstance> makeQuads(uint32_t count, const Camera2D &camera)
+{
+    std::vector<Vertex::SpriteInstance> quads(count);
+    float halfWidth = BENCH_WIDTH / camera.pixelsPerUnit / 2.0f;
+    float halfHeight = BENCH_HEIGHT / camera.pixelsPerUnit / 2.0f;
+    uint32_t seed = 12345;
+    auto next = [&seed]() {
+        seed = seed * 1664525u + 1013904223u;
+        return static_cast<float>(seed >> 8) / static_cast<float>(1u << 24);
+    };
+    for (Vertex::SpriteInstance &quad : quads)
+    {
+        quad.position = camera.position + glm::vec2((next() * 2.0f - 1.0f) * halfWidth, (next() * 2.0f - 1.0f) * halfHeight);
+        quad.size = glm::vec2(0.5f, 0.5f);
+        quad.uvRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+        quad.tint = Vertex::PackTint(static_cast<uint8_t>(next() * 255), static_cast<uint8_t>(next() * 255), static_cast<uint8_t>(next() * 255), 255);
+        quad.layer = static_cast<float>(static_cast<int>(next() * 4));
+    }
+    return quads;
+}
+
+static ScenarioResult runPipelineCreation(Renderer &renderer)
+{
+    std::cout << "Running scenario pipeline_creation..." << std::endl;
+    std::vector<double> cold, warm;
+    for (int i = 0; i < PIPELINE_RUNS; i++)
+    {
+        Renderer::PipelineCreationTimings timings = renderer.BenchmarkPipelineCreation();
+        cold.push_back(timings.coldMilliseconds);
+        warm.push_back(timings.warmMilliseconds);
+    }
+    ScenarioResult result;
+    result.name = "pipeline_creation";
+    Percentiles coldPercentiles = percentiles(cold);
+    Percentiles warmPercentiles = percentiles(warm);
+    result.extra = {
+        {"runs", PIPELINE_RUNS},
+        {"cold_ms_p50", coldPercentiles.p50},
+        {"cold_ms_max", coldPercentiles.max},
+        {"warm_ms_p50", warmPercentiles.p50},
+        {"warm_ms_max", warmPercentiles.max}};
+    result.peakResidentKilobytes = peakResidentKilobytes();
+    return result;
+}
+
+static void writePercentiles(std::ostream &out, const char *name, const Percentiles &value)
+{
+    out << "\"" << name << "\":{\"mean\":" << value.mean << ",\"p50\":" << value.p50 << ",\"p90\":" << value.p90 << ",\"p99\":" << value.p99 << ",\"max\":" << value.max << "}";
+}
+
+static std::string toJson(const std::vector<ScenarioResult> &results)
+{
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(4);
+    out << "{\n\"version\":\"" << ROGUE_VERSION << "\",\"build_type\":\"" << ROGUE_BUILD_TYPE << "\""
+        << ",\"width\":" << BENCH_WIDTH << ",\"height\":" << BENCH_HEIGHT
+        << ",\"job_workers\":" << JobSystem::GetWorkerCount() << ",\n\"scenarios\":[";
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const ScenarioResult &result = results[i];
+        out << (i == 0 ? "\n" : ",\n") << "{\"name\":\"" << result.name << "\"";
+        if (result.frames > 0)
+        {
+            out << ",\"frames\":" << result.frames << ",";
+            writePercentiles(out, "frame_ms", result.frameMilliseconds);
+            out << ",";
+            writePercentiles(out, "record_ms", result.recordMilliseconds);
+            out << ",\"gpu_ms_mean\":" << result.gpuMilliseconds
+                << ",\"draw_calls\":" << result.drawCalls
+                << ",\"instances\":" << result.instances
+                << ",\"heap_allocations_per_frame\":" << result.heapAllocationsPerFrame
+                << ",\"device_memory_allocations\":" << result.deviceMemoryAllocations
+                << ",\"device_sub_allocations\":" << result.deviceSubAllocations
+                << ",\"peak_device_bytes\":" << result.peakDeviceBytes;
+        }
+        for (const std::pair<std::string, double> &value : result.extra)
+        {
+            out << ",\"" << value.first << "\":" << value.second;
+        }
+        out << ",\"peak_resident_kb\":" << result.peakResidentKilobytes << "}";
+    }
+    out << "\n]}\n";
+    return out.str();
+}
+
+int main(int argc, const char *argv[])
+{
+    int frameCount = 300;
+    std::string outputPath = "renderbench.json";
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+        {
+            frameCount = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+        {
+            outputPath = argv[++i];
+        }
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--frames N] [--output renderbench.json]" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    // No video subsystem, the renderer is headless.
+    if (SDL_Init(SDL_INIT_EVENTS | SDL_INIT_TIMER) < 0)
+    {
+        std::cerr << "Failed to initialize SDL2: " << SDL_GetError() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    JobSystem::Init();
+    try
+    {
+        std::vector<ScenarioResult> results;
+        {
+            RendererOptions options;
+            options.headless = true;
+            options.width = BENCH_WIDTH;
+            options.height = BENCH_HEIGHT;
+            Renderer renderer(options);
+
+            results.push_back(runScenario(renderer, "triangle", frameCount, drawTriangle));
+
+            const uint32_t quadCounts[] = {10000, 100000};
+            for (uint32_t quadCount : quadCounts)
+            {
+                std::vector<Vertex::SpriteInstance> quads = makeQuads(quadCount, renderer.GetCamera());
+                results.push_back(runScenario(renderer, "quads_" + std::to_string(quadCount / 1000) + "k", frameCount, [&quads](Renderer &target, int) {
+                    for (const Vertex::SpriteInstance &quad : quads)
+                    {
+                        target.DrawSprite(quad);
+                    }
+                }));
+            }
+
+            // Every frame rebuilds the render targets at a different size, like dragging a window corner around.
+            results.push_back(runScenario(renderer, "swapchain_recreate", frameCount, [](Renderer &target, int frame) {
+                target.ResizeOffscreen(frame % 2 == 0 ? BENCH_WIDTH : BENCH_WIDTH / 2, frame % 2 == 0 ? BENCH_HEIGHT : BENCH_HEIGHT / 2);
+                drawTriangle(target, frame);
+            }));
+            renderer.ResizeOffscreen(BENCH_WIDTH, BENCH_HEIGHT);
+
+            results.push_back(runPipelineCreation(renderer));
+        }
+
+        std::string json = toJson(results);
+        std::ofstream file(outputPath, std::ios::out | std::ios::trunc);
+        if (!file.is_open())
+        {
+            throw std::runtime_error("Failed to open benchmark output: " + outputPath);
+        }
+        file << json;
+        std::cout << json;
+        std::cout << "Wrote results to " << outputPath << std::endl;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        JobSystem::Shutdown();
+        SDL_Quit();
+        return EXIT_FAILURE;
+    }
+
+    JobSystem::Shutdown();
+    SDL_Quit();
+    return EXIT_SUCCESS;
+}
\ No newline at end of file
@@ -12,5 +12,15 @@ const std::vector<Vertex::Vertex> TRIANGLE_VERTICES = {
     {{-0.5f, 0.5f}, {0.0f, 0.0f, 1.0f}}
 };
 
+// Two triangles covering [0, 1] x [0, 1]. Every sprite instance stretches this over its own rect.
+const std::vector<Vertex::Vertex> UNIT_QUAD_VERTICES = {
+    {{0.0f, 0.0f}, {1.0f, 1.0f, 1.0f}},
+    {{1.0f, 0.0f}, {1.0f, 1.0f, 1.0f}},
+    {{1.0f, 1.0f}, {1.0f, 1.0f, 1.0f}},
+    {{1.0f, 1.0f}, {1.0f, 1.0f, 1.0f}},
+    {{0.0f, 1.0f}, {1.0f, 1.0f, 1.0f}},
+    {{0.0f, 0.0f}, {1.0f, 1.0f, 1.0f}}
+};
+
 
 #endif
\ No newline at end of file
@@ -8,36 +8,140 @@
 #include <cstdlib>
 #include <string>
 #include <vector>
+#include <chrono>
+#include <thread>
+#include <algorithm>
 
 #include "game.h"
 #include "renderer/renderer.h"
+#include "systems/jobsystem.h"
+#include "systems/profiler.h"
 
-Game::Game()
+Game::Game(const RendererOptions &rendererOptions) : _renderer(rendererOptions)
 {
+    std::cout << "Generating demo map..." << std::endl;
+    generateDemoMap();
+
+    // Ten pixels per tile, 80x60 tiles on screen in the default window
+    Camera2D camera;
+    camera.position = glm::vec2(DEMO_MAP_WIDTH / 2.0f, DEMO_MAP_HEIGHT / 2.0f);
+    camera.pixelsPerUnit = 10.0f;
+    _renderer.SetCamera(camera);
+    _cameraPosition = camera.position;
+    _previousCameraPosition = camera.position;
+
+    SetTickRate(DEFAULT_TICK_RATE);
+    const char *frameLimit = std::getenv("ROGUE_FRAME_LIMIT");
+    SetFrameLimit(frameLimit != nullptr ? std::atof(frameLimit) : DEFAULT_FRAME_LIMIT);
 }
 
 Game::~Game()
 {
+    // Chunk buffers may still be read by frames in flight.
+    _renderer.WaitIdle();
+    _tilemap.Cleanup(_renderer.GetAllocator());
+}
+
+void Game::SetTickRate(double tickRate)
+{
+    if (tickRate <= 0.0)
+    {
+        throw std::runtime_error("Tick rate has to be positive.");
+    }
+    _timing.tickSeconds = 1.0 / tickRate;
+}
+
+void Game::SetFrameLimit(double framesPerSecond)
+{
+    _frameLimit = framesPerSecond > 0.0 ? framesPerSecond : 0.0;
 }
 
+// Fixed timestep: the wall clock time of every frame goes into an accumulator, and update() runs once for every full
+// tick in it. Simulation speed no longer depends on the frame rate, and render() gets the leftover fraction of a
+// tick to interpolate with.
+// https://gafferongames.com/post/fix_your_timestep/
 void Game::Run()
 {
     std::cout << "Running Game" << std::endl;
     bool quit = false;
     SDL_Event e;
+    double accumulator = 0.0;
+    std::chrono::steady_clock::time_point previousFrameStart = std::chrono::steady_clock::now();
     while (true)
     {
-        while (SDL_PollEvent(&e))
+        PROFILE_ZONE("Game::Run frame");
+        std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
+        std::chrono::duration<double> frameTime = frameStart - previousFrameStart;
+        previousFrameStart = frameStart;
+        _timing.frameSeconds = frameTime.count();
+        accumulator += _lockstep ? _timing.tickSeconds : std::min(_timing.frameSeconds, MAX_FRAME_SECONDS);
+
         {
-            bool shouldQuit = !handleEvent(e);
-            quit = quit ? quit : shouldQuit;
+            PROFILE_ZONE("poll events");
+            while (SDL_PollEvent(&e))
+            {
+                bool shouldQuit = !handleEvent(e);
+                quit = quit ? quit : shouldQuit;
+            }
         }
         if (quit)
         {
             break;
         }
-        update();
-        render();
+        // SDL and other thread affine work queued by jobs since last frame
+        {
+            PROFILE_ZONE("pump main thread jobs");
+            JobSystem::PumpMainThread();
+        }
+        // Background loads that finished, their uploads go out with this frame
+        {
+            PROFILE_ZONE("asset loads");
+            _renderer.GetAssetLoader().Update();
+        }
+
+        std::chrono::steady_clock::time_point updateStart = std::chrono::steady_clock::now();
+        _timing.ticksThisFrame = 0;
+        while (accumulator >= _timing.tickSeconds)
+        {
+            update(_timing.tickSeconds);
+            accumulator -= _timing.tickSeconds;
+            _timing.tickCount += 1;
+            _timing.ticksThisFrame += 1;
+        }
+        std::chrono::steady_clock::time_point renderStart = std::chrono::steady_clock::now();
+        _timing.updateSeconds = std::chrono::duration<double>(renderStart - updateStart).count();
+
+        _timing.alpha = accumulator / _timing.tickSeconds;
+        render(_timing.alpha);
+        _timing.renderSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - renderStart).count();
+        _timing.frameCount += 1;
+        if (_maxFrames > 0 && _timing.frameCount >= _maxFrames)
+        {
+            break;
+        }
+
+        paceFrame(frameStart);
+    }
+}
+
+// Sleeps until the frame limit's deadline. Most of the wait is a real sleep, only the last PACING_SPIN_SECONDS
+// are yielded away so oversleeping doesn't cost a whole scheduler quantum.
+void Game::paceFrame(std::chrono::steady_clock::time_point frameStart)
+{
+    if (_frameLimit <= 0.0)
+    {
+        return;
+    }
+    PROFILE_ZONE("Game::paceFrame");
+    std::chrono::steady_clock::time_point deadline = frameStart + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / _frameLimit));
+    std::chrono::steady_clock::time_point sleepUntil = deadline - std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(PACING_SPIN_SECONDS));
+    if (std::chrono::steady_clock::now() < sleepUntil)
+    {
+        std::this_thread::sleep_until(sleepUntil);
+    }
+    while (std::chrono::steady_clock::now() < deadline)
+    {
+        std::this_thread::yield();
     }
 }
 
@@ -59,13 +163,84 @@ bool Game::handleEvent(SDL_Event e)
     return true;
 }
 
-void Game::update()
+void Game::update(double deltaSeconds)
 {
+    PROFILE_ZONE("Game::update");
     // Update Logic Here
+    // The camera drifts across the map so chunks stream in and out, and wraps around at the right edge.
+    _previousCameraPosition = _cameraPosition;
+    _cameraPosition.x += CAMERA_SPEED * static_cast<float>(deltaSeconds);
+    if (_cameraPosition.x > DEMO_MAP_WIDTH)
+    {
+        _cameraPosition.x -= DEMO_MAP_WIDTH;
+        _previousCameraPosition = _cameraPosition;
+    }
 }
 
-void Game::render()
+void Game::render(double alpha)
 {
+    PROFILE_ZONE("Game::render");
     // Render Logic Here
+    // Draw between the last two ticks, otherwise motion stutters whenever the frame and tick rates don't line up.
+    Camera2D camera = _renderer.GetCamera();
+    camera.position = glm::mix(_previousCameraPosition, _cameraPosition, static_cast<float>(alpha));
+    _renderer.SetCamera(camera);
+
+    // Only the chunks under the camera are drawn, one instanced draw each
+    _tilemap.Render(_renderer);
+
+    // The player, in the sprite batch on top of the map
+    Vertex::SpriteInstance player = {};
+    player.position = _renderer.GetCamera().position;
+    player.size = glm::vec2(1.0f, 1.0f);
+    player.uvRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+    player.tint = Vertex::PackTint(255, 220, 64, 255);
+    player.layer = 1.0f;
+    _renderer.DrawSprite(player);
+
+    _renderer.Draw(_renderer.CreateMeshDraw(_renderer.GetDemoMesh()));
+
     _renderer.DrawFrame();
+    reportFrameStats();
+}
+
+// Checkerboard floor with scattered walls. A cheap integer hash keeps it deterministic without a random engine.
+void Game::generateDemoMap()
+{
+    _tilemap.Init(DEMO_MAP_WIDTH, DEMO_MAP_HEIGHT, 16, 16);
+    for (uint32_t y = 0; y < DEMO_MAP_HEIGHT; y++)
+    {
+        for (uint32_t x = 0; x < DEMO_MAP_WIDTH; x++)
+        {
+            uint32_t hash = (x * 73856093u) ^ (y * 19349663u);
+            if (hash % 11 == 0)
+            {
+                _tilemap.SetTile(x, y, WALL_TILE, Vertex::PackTint(110, 96, 80, 255));
+                continue;
+            }
+            uint8_t shade = (x + y) % 2 == 0 ? 48 : 40;
+            _tilemap.SetTile(x, y, FLOOR_TILE, Vertex::PackTint(shade, shade, static_cast<uint8_t>(shade + 8), 255));
+        }
+    }
+}
+
+// Shows the last frame's numbers in the window title, once a second so the title isn't redrawn every frame.
+void Game::reportFrameStats()
+{
+    uint32_t ticks = SDL_GetTicks();
+    if (ticks - _lastStatsTicks < STATS_INTERVAL_MS)
+    {
+        return;
+    }
+    _lastStatsTicks = ticks;
+
+    const FrameStats &stats = _renderer.GetLastFrameStats();
+    std::string title = std::string(_renderer.IsHeadless() ? "Headless" : "SDL Vulkan Triangle Meme") + " - " + std::to_string(stats.drawCalls) + " draw calls, " + std::to_string(stats.instances) + " instances, " + std::to_string(_tilemap.GetVisibleChunkCount()) + " chunks visible, " + std::to_string(static_cast<int>(_timing.frameSeconds * 1000.0 + 0.5)) + "ms/frame, " + std::to_string(static_cast<int>(stats.gpuMilliseconds * 1000.0 + 0.5)) + "us GPU";
+    // No window to put it on when headless, the log will do.
+    if (_renderer.IsHeadless())
+    {
+        std::cout << title << std::endl;
+        return;
+    }
+    SDL_SetWindowTitle(_renderer.GetWindow(), title.c_str());
 }
@@ -3,22 +3,77 @@
 
 #include <SDL2/SDL.h>
 #include <vulkan/vulkan.h>
+#include <chrono>
+#include <cstdint>
+#include <string>
 
 #include "renderer/renderer.h"
+#include "tilemap.h"
+
+// Timing of the game loop, updated every frame. Durations are in seconds.
+struct GameTiming {
+  double tickSeconds = 0.0;   // Fixed simulation step, 1 / tick rate
+  double frameSeconds = 0.0;  // Wall clock time of the last frame, pacing included
+  double updateSeconds = 0.0; // Time spent in update() during the last frame, all ticks together
+  double renderSeconds = 0.0; // Time spent in render() during the last frame
+  double alpha = 0.0;         // How far render() is between the previous and the current tick, [0, 1)
+  uint32_t ticksThisFrame = 0;
+  uint64_t tickCount = 0;
+  uint64_t frameCount = 0;
+};
 
 class Game
 {
   public:
-    Game();
+    Game(const RendererOptions &rendererOptions = RendererOptions());
     ~Game();
     void Run();
+    // Run() returns after this many frames, 0 runs until the window is closed. Headless runs have no window to close.
+    void SetMaxFrames(uint64_t maxFrames) { _maxFrames = maxFrames; }
+    // Every frame advances exactly one tick no matter how long it took, so frame N always shows the same thing.
+    // For image-diff tests and reproducible benchmarks, gameplay should leave this off.
+    void SetLockstep(bool lockstep) { _lockstep = lockstep; }
+    // Saves the last rendered frame, see Renderer::SaveFrame. Headless only.
+    void SaveFrame(const std::string &path) { _renderer.SaveFrame(path); }
+    // Simulation ticks per second. update() always sees exactly 1 / tickRate seconds.
+    void SetTickRate(double tickRate);
+    // Frames per second the loop sleeps down to, 0 renders as fast as presenting allows.
+    void SetFrameLimit(double framesPerSecond);
+    const GameTiming &GetTiming() { return _timing; }
 
   private:
+    // Demo dungeon, big enough that only a small part of it is ever on screen
+    const uint32_t DEMO_MAP_WIDTH = 1024, DEMO_MAP_HEIGHT = 1024;
+    const uint16_t FLOOR_TILE = 0, WALL_TILE = 1;
+    const uint32_t STATS_INTERVAL_MS = 1000;
+    const double DEFAULT_TICK_RATE = 60.0;
+    // MAILBOX/IMMEDIATE present modes never block, so without a cap the loop spins a core at hundreds of fps.
+    // ROGUE_FRAME_LIMIT overrides it, 0 turns it off.
+    const double DEFAULT_FRAME_LIMIT = 240.0;
+    // Frames longer than this (breakpoints, window drags) are clamped so the simulation doesn't try to catch up all at once.
+    const double MAX_FRAME_SECONDS = 0.25;
+    // sleep_until overshoots by up to a scheduler quantum, the last bit before the deadline is yielded away instead.
+    const double PACING_SPIN_SECONDS = 0.002;
+    const float CAMERA_SPEED = 8.0f; // Tiles per second
+
     Renderer _renderer;
+    Tilemap _tilemap;
+    uint32_t _lastStatsTicks = 0;
+
+    GameTiming _timing;
+    double _frameLimit = 0.0;
+    uint64_t _maxFrames = 0;
+    bool _lockstep = false;
+    // Simulation state from the last two ticks, render() draws in between them
+    glm::vec2 _previousCameraPosition;
+    glm::vec2 _cameraPosition;
 
     bool handleEvent(SDL_Event e);
-    void update();
-    void render();
+    void update(double deltaSeconds);
+    void render(double alpha);
+    void paceFrame(std::chrono::steady_clock::time_point frameStart);
+    void generateDemoMap();
+    void reportFrameStats();
 };
 
 #endif
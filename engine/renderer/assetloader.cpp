@@ -0,0 +1,209 @@
+#include <vulkan/vulkan.h>
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+
+#include "assetloader.h"
+#include "../systems/profiler.h"
+
+void AssetLoader::Init(Memory::Allocator &allocator, Upload::Uploader &uploader)
+{
+    _allocator = &allocator;
+    _uploader = &uploader;
+}
+
+void AssetLoader::Cleanup()
+{
+    JobSystem::Wait(_jobs);
+    takeCompleted();
+    for (std::unique_ptr<Request> &request : _waitingForUpload)
+    {
+        destroy(*request);
+    }
+    for (std::unique_ptr<Request> &request : _uploading)
+    {
+        destroy(*request);
+    }
+    _waitingForUpload.clear();
+    _uploading.clear();
+    _pendingCount = 0;
+}
+
+AssetLoader::Handle AssetLoader::LoadFile(const std::string &path, Callback callback)
+{
+    std::unique_ptr<Request> request = std::make_unique<Request>();
+    request->type = RequestType::File;
+    request->callback = std::move(callback);
+    request->result.path = path;
+    return submit(std::move(request));
+}
+
+AssetLoader::Handle AssetLoader::LoadBuffer(const std::string &path, VkBufferUsageFlags usage, Callback callback, DecodeFunction decode)
+{
+    std::unique_ptr<Request> request = std::make_unique<Request>();
+    request->type = RequestType::Buffer;
+    request->usage = usage;
+    request->decode = std::move(decode);
+    request->callback = std::move(callback);
+    request->result.path = path;
+    return submit(std::move(request));
+}
+
+AssetLoader::Handle AssetLoader::BuildBuffer(BuildFunction build, VkBufferUsageFlags usage, Callback callback)
+{
+    std::unique_ptr<Request> request = std::make_unique<Request>();
+    request->type = RequestType::Buffer;
+    request->usage = usage;
+    request->build = std::move(build);
+    request->callback = std::move(callback);
+    return submit(std::move(request));
+}
+
+void AssetLoader::Update()
+{
+    PROFILE_ZONE("AssetLoader::Update");
+    takeCompleted();
+
+    // Oldest first, until the budget is spent. Failed loads and plain files have nothing to upload.
+    VkDeviceSize queuedBytes = 0;
+    size_t queued = 0;
+    for (; queued < _waitingForUpload.size(); queued++)
+    {
+        Request &request = *_waitingForUpload[queued];
+        if (!request.result.failed && request.type == RequestType::Buffer)
+        {
+            VkDeviceSize size = request.result.buffer.size;
+            if (queuedBytes > 0 && queuedBytes + size > UPLOAD_BUDGET_PER_UPDATE)
+            {
+                break;
+            }
+            const char *data = request.contents.empty() && request.result.file != nullptr ? request.result.file->Data() : request.contents.data();
+            // Loaded buffers are new, nothing has used them yet, so they can take the transfer queue when there is one.
+            request.ticket = _uploader->EnqueueAsync(request.result.buffer.buffer, 0, data, size);
+            queuedBytes += size;
+        }
+        _uploading.push_back(std::move(_waitingForUpload[queued]));
+    }
+    _waitingForUpload.erase(_waitingForUpload.begin(), _waitingForUpload.begin() + queued);
+
+    // Tickets complete in order, but requests that uploaded nothing have ticket 0 and are done right away.
+    // Callbacks may start new loads, which only ever touch _waitingForUpload through the completion queue.
+    size_t done = 0;
+    while (done < _uploading.size() && _uploader->IsComplete(_uploading[done]->ticket))
+    {
+        Request &request = *_uploading[done];
+        // Nothing reads the staged copy past here, so the decoded bytes and the file can go.
+        request.contents = std::vector<char>();
+        if (request.type == RequestType::Buffer)
+        {
+            request.result.file.reset();
+        }
+        _pendingCount -= 1;
+        if (request.callback)
+        {
+            request.callback(request.result);
+        }
+        done++;
+    }
+    _uploading.erase(_uploading.begin(), _uploading.begin() + done);
+}
+
+void AssetLoader::WaitAll()
+{
+    PROFILE_ZONE("AssetLoader::WaitAll");
+    while (_pendingCount > 0)
+    {
+        JobSystem::Wait(_jobs);
+        Update();
+        // Update may have held some back for the budget, keep going until everything is on the GPU.
+        _uploader->Wait(_uploader->Flush());
+        Update();
+    }
+}
+
+AssetLoader::Handle AssetLoader::submit(std::unique_ptr<Request> request)
+{
+    Handle handle = _nextHandle++;
+    request->result.handle = handle;
+    _pendingCount += 1;
+
+    // The job owns the request until it is pushed onto the completion queue.
+    Request *pointer = request.release();
+    AssetLoader *loader = this;
+    JobSystem::Run([loader, pointer]() {
+        load(*pointer, *loader->_allocator);
+        loader->pushCompleted(pointer);
+    }, &_jobs);
+    return handle;
+}
+
+// Worker thread. Jobs must not throw, so errors end up in the result instead.
+void AssetLoader::load(Request &request, Memory::Allocator &allocator)
+{
+    PROFILE_ZONE("AssetLoader::load");
+    try
+    {
+        if (!request.result.path.empty())
+        {
+            request.result.file = FileIOSystem::OpenFile(request.result.path);
+        }
+        if (request.type == RequestType::File)
+        {
+            return;
+        }
+
+        if (request.build)
+        {
+            request.contents = request.build();
+        }
+        else if (request.decode)
+        {
+            request.contents = request.decode(request.result.file->GetSpan());
+        }
+        VkDeviceSize size = request.contents.empty() && request.result.file != nullptr ? request.result.file->Size() : request.contents.size();
+        if (size == 0)
+        {
+            throw std::runtime_error("Nothing to upload.");
+        }
+        // The allocator is thread safe, so creating the buffer doesn't have to wait for the main thread either.
+        request.result.buffer = allocator.CreateBuffer(size, request.usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    }
+    catch (const std::exception &e)
+    {
+        request.result.failed = true;
+        request.result.error = e.what();
+        request.result.file.reset();
+        request.contents.clear();
+        std::cout << "Failed to load " << (request.result.path.empty() ? "built buffer" : request.result.path) << ": " << e.what() << std::endl;
+    }
+}
+
+void AssetLoader::pushCompleted(Request *request)
+{
+    // Release so the main thread sees everything the job wrote into the request once it sees the request.
+    Request *head = _completed.load(std::memory_order_relaxed);
+    do
+    {
+        request->next = head;
+    } while (!_completed.compare_exchange_weak(head, request, std::memory_order_release, std::memory_order_relaxed));
+}
+
+void AssetLoader::takeCompleted()
+{
+    Request *head = _completed.exchange(nullptr, std::memory_order_acquire);
+    // The stack is newest first, flip it so uploads go out in the order loads finished.
+    size_t first = _waitingForUpload.size();
+    for (; head != nullptr; head = head->next)
+    {
+        _waitingForUpload.emplace_back(head);
+    }
+    std::reverse(_waitingForUpload.begin() + first, _waitingForUpload.end());
+}
+
+void AssetLoader::destroy(Request &request)
+{
+    if (request.result.buffer.buffer != VK_NULL_HANDLE)
+    {
+        _allocator->DestroyBuffer(request.result.buffer);
+    }
+}
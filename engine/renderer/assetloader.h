@@ -0,0 +1,115 @@
+#ifndef ASSET_LOADER_H
+#define ASSET_LOADER_H
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <functional>
+#include <cstdint>
+
+#include "memory.h"
+#include "upload.h"
+#include "../systems/fileio.h"
+#include "../systems/jobsystem.h"
+
+// Loads assets without the main thread ever waiting on the disk or on decoding.
+//
+//     worker job          read the file (mapped, or decompressed out of the archive), decode, create the buffer
+//     completion queue    lock-free, workers push finished requests, Update() takes all of them at once
+//     Update()            main thread: queues the bytes on the uploader, they go out with the frame's Flush(),
+//                         on the dedicated transfer queue when the device has one
+//     callback            main thread, from Update() once the upload batch has completed on the GPU
+//
+// The uploader isn't thread safe and callbacks touch game state, so both stay on the main thread. Every
+// Load/Build call, Update and Cleanup have to come from there too.
+class AssetLoader
+{
+  public:
+    using Handle = uint32_t;
+
+    struct Result
+    {
+        Handle handle = 0;
+        std::string path; // Empty for BuildBuffer
+        bool failed = false;
+        std::string error;
+        // LoadFile only, the file's bytes.
+        std::shared_ptr<const FileIOSystem::FileView> file;
+        // LoadBuffer and BuildBuffer only. Ready to use, and the callback's to destroy from here on.
+        Memory::Buffer buffer;
+    };
+
+    using Callback = std::function<void(const Result &result)>;
+    // Turns a file into the bytes to upload. Runs on a worker, must not touch anything the main thread does.
+    using DecodeFunction = std::function<std::vector<char>(const FileIOSystem::Span &file)>;
+    // Produces the bytes to upload out of thin air, like a generated mesh. Runs on a worker.
+    using BuildFunction = std::function<std::vector<char>()>;
+
+    // Bytes queued on the uploader per Update, so a level's worth of assets arriving at once spreads over a few
+    // frames instead of stalling one on a full staging ring. One request always goes through, however big.
+    static constexpr VkDeviceSize UPLOAD_BUDGET_PER_UPDATE = 4 * 1024 * 1024;
+
+    void Init(Memory::Allocator &allocator, Upload::Uploader &uploader);
+    // Waits for loads still running on workers and throws away everything not handed out yet, callbacks don't run.
+    // Frames in flight may still read finished buffers, call it once the device is idle.
+    void Cleanup();
+
+    // Reads a file. The callback gets the view, nothing goes to the GPU.
+    Handle LoadFile(const std::string &path, Callback callback);
+    // Reads a file into a DEVICE_LOCAL buffer with `usage` (TRANSFER_DST is added). Without a decode function
+    // the file's bytes are uploaded as they are.
+    Handle LoadBuffer(const std::string &path, VkBufferUsageFlags usage, Callback callback, DecodeFunction decode = nullptr);
+    Handle BuildBuffer(BuildFunction build, VkBufferUsageFlags usage, Callback callback);
+
+    // Call once per frame before rendering. Queues finished loads on the uploader and runs the callbacks of
+    // loads whose upload has landed.
+    void Update();
+    // Blocks until every load so far has called back, for loading screens and shutdown. Runs jobs while it waits.
+    void WaitAll();
+    // Loads that haven't called back yet.
+    uint32_t GetPendingCount() { return _pendingCount; }
+
+  private:
+    enum class RequestType
+    {
+        File,
+        Buffer,
+    };
+
+    struct Request
+    {
+        RequestType type;
+        VkBufferUsageFlags usage = 0;
+        DecodeFunction decode;
+        BuildFunction build;
+        Callback callback;
+        Result result;
+        // Set when a decode or build produced new bytes, otherwise the file's own bytes are uploaded.
+        std::vector<char> contents;
+        Upload::Ticket ticket = 0;
+        // Link in the completion queue.
+        Request *next = nullptr;
+    };
+
+    Memory::Allocator *_allocator = nullptr;
+    Upload::Uploader *_uploader = nullptr;
+    JobSystem::Counter _jobs;
+    // Intrusive stack of finished requests. Any worker pushes with a CAS, the main thread takes the whole stack
+    // with a single exchange, so there is no ABA problem and no lock.
+    std::atomic<Request *> _completed{nullptr};
+    // Main thread only, in the order they finished loading.
+    std::vector<std::unique_ptr<Request>> _waitingForUpload;
+    std::vector<std::unique_ptr<Request>> _uploading;
+    Handle _nextHandle = 1;
+    uint32_t _pendingCount = 0;
+
+    Handle submit(std::unique_ptr<Request> request);
+    static void load(Request &request, Memory::Allocator &allocator);
+    void pushCompleted(Request *request);
+    void takeCompleted();
+    void destroy(Request &request);
+};
+
+#endif
@@ -0,0 +1,249 @@
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+
+#include "atlas.h"
+
+const AtlasSprite *Atlas::Find(const std::string &name) const
+{
+    auto found = _names.find(name);
+    return found != _names.end() ? &_sprites[found->second] : nullptr;
+}
+
+void Atlas::Destroy(TextureCache &textures)
+{
+    for (TextureCache::Handle page : _pages)
+    {
+        textures.Destroy(page);
+    }
+    _pages.clear();
+    _sprites.clear();
+    _names.clear();
+}
+
+AtlasBuilder::AtlasBuilder(uint32_t pageSize, uint32_t padding) : _pageSize(pageSize), _padding(padding)
+{
+}
+
+void AtlasBuilder::Add(const std::string &name, ImageFile::Pixels pixels)
+{
+    if (pixels.width == 0 || pixels.height == 0 || pixels.rgba.size() != static_cast<size_t>(pixels.width) * pixels.height * 4)
+    {
+        throw std::runtime_error("Sprite " + name + " has no pixels or pixels that don't match its size.");
+    }
+    auto found = _entryLookup.find(name);
+    if (found != _entryLookup.end())
+    {
+        _entries[found->second].pixels = std::move(pixels);
+        return;
+    }
+    _entryLookup.emplace(name, _entries.size());
+    _entries.push_back({name, std::move(pixels)});
+}
+
+void AtlasBuilder::AddFile(const std::string &path)
+{
+    Add(path, ImageFile::Load(path));
+}
+
+Atlas AtlasBuilder::Build(TextureCache &textures, const TextureOptions &options)
+{
+    // Placing the tallest first keeps the skyline flat, short sprites fill in the steps the tall ones leave.
+    std::vector<size_t> order(_entries.size());
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+        const ImageFile::Pixels &first = _entries[a].pixels;
+        const ImageFile::Pixels &second = _entries[b].pixels;
+        return first.height != second.height ? first.height > second.height : first.width > second.width;
+    });
+
+    std::vector<Page> pages;
+    for (size_t index : order)
+    {
+        Entry &entry = _entries[index];
+        uint32_t cellWidth = entry.pixels.width + 2 * _padding;
+        uint32_t cellHeight = entry.pixels.height + 2 * _padding;
+        if (cellWidth > _pageSize || cellHeight > _pageSize)
+        {
+            throw std::runtime_error("Sprite " + entry.name + " is too large for a " + std::to_string(_pageSize) + " texel atlas page.");
+        }
+
+        // Earlier pages first, so they fill up before a new one is started.
+        bool placed = false;
+        for (uint32_t page = 0; page < pages.size() && !placed; page++)
+        {
+            placed = place(pages[page], cellWidth, cellHeight, &entry.x, &entry.y);
+            entry.page = page;
+        }
+        if (!placed)
+        {
+            Page page;
+            page.skyline.push_back({0, 0, _pageSize});
+            pages.push_back(page);
+            entry.page = static_cast<uint32_t>(pages.size() - 1);
+            place(pages.back(), cellWidth, cellHeight, &entry.x, &entry.y);
+        }
+    }
+
+    // Pages are only as tall as what was placed on them, a half empty last page doesn't cost a whole page of memory.
+    std::vector<ImageFile::Pixels> pagePixels(pages.size());
+    for (size_t page = 0; page < pages.size(); page++)
+    {
+        pagePixels[page].width = _pageSize;
+        pagePixels[page].height = pages[page].usedHeight;
+        pagePixels[page].rgba.assign(static_cast<size_t>(_pageSize) * pages[page].usedHeight * 4, 0);
+    }
+    for (const Entry &entry : _entries)
+    {
+        blit(pagePixels[entry.page], entry);
+    }
+
+    // Each level halves the padding, past the level where it is down to one texel neighbours blend into each other.
+    TextureOptions pageOptions = options;
+    uint32_t paddedLevels = 1;
+    for (uint32_t padding = _padding; padding > 1; padding /= 2)
+    {
+        paddedLevels++;
+    }
+    pageOptions.maxMipLevels = options.maxMipLevels > 0 ? std::min(options.maxMipLevels, paddedLevels) : paddedLevels;
+
+    Atlas atlas;
+    for (const ImageFile::Pixels &pixels : pagePixels)
+    {
+        atlas._pages.push_back(textures.Create(pixels, pageOptions));
+    }
+    atlas._sprites.reserve(_entries.size());
+    for (const Entry &entry : _entries)
+    {
+        const ImageFile::Pixels &page = pagePixels[entry.page];
+        float left = static_cast<float>(entry.x + _padding);
+        float top = static_cast<float>(entry.y + _padding);
+        AtlasSprite sprite;
+        sprite.texture = atlas._pages[entry.page];
+        sprite.uvRect = glm::vec4(left / page.width, top / page.height, (left + entry.pixels.width) / page.width, (top + entry.pixels.height) / page.height);
+        sprite.width = entry.pixels.width;
+        sprite.height = entry.pixels.height;
+        atlas._names.emplace(entry.name, static_cast<uint32_t>(atlas._sprites.size()));
+        atlas._sprites.push_back(sprite);
+    }
+    std::cout << "Packed " << _entries.size() << " sprites into " << pages.size() << " atlas pages" << std::endl;
+
+    _entries.clear();
+    _entryLookup.clear();
+    return atlas;
+}
+
+// Bottom-left rule: of every position along the skyline the rect fits at, take the one where its bottom edge
+// ends up highest on the page (lowest y + height), ties go to the narrower segment.
+bool AtlasBuilder::place(Page &page, uint32_t width, uint32_t height, uint32_t *x, uint32_t *y)
+{
+    size_t bestNode = SIZE_MAX;
+    uint32_t bestBottom = UINT32_MAX;
+    uint32_t bestWidth = UINT32_MAX;
+    uint32_t bestY = 0;
+    for (size_t node = 0; node < page.skyline.size(); node++)
+    {
+        uint32_t top;
+        if (!fits(page, node, width, height, &top))
+        {
+            continue;
+        }
+        if (top + height < bestBottom || (top + height == bestBottom && page.skyline[node].width < bestWidth))
+        {
+            bestNode = node;
+            bestBottom = top + height;
+            bestWidth = page.skyline[node].width;
+            bestY = top;
+        }
+    }
+    if (bestNode == SIZE_MAX)
+    {
+        return false;
+    }
+
+    *x = page.skyline[bestNode].x;
+    *y = bestY;
+    page.usedHeight = std::max(page.usedHeight, bestY + height);
+
+    // The rect becomes a new segment, the segments it covers shrink or go away.
+    std::vector<SkylineNode> &skyline = page.skyline;
+    skyline.insert(skyline.begin() + bestNode, {*x, bestY + height, width});
+    size_t next = bestNode + 1;
+    while (next < skyline.size())
+    {
+        uint32_t coveredEnd = skyline[next - 1].x + skyline[next - 1].width;
+        if (skyline[next].x >= coveredEnd)
+        {
+            break;
+        }
+        uint32_t overlap = coveredEnd - skyline[next].x;
+        if (overlap >= skyline[next].width)
+        {
+            skyline.erase(skyline.begin() + next);
+            continue;
+        }
+        skyline[next].x += overlap;
+        skyline[next].width -= overlap;
+        break;
+    }
+    // Neighbours at the same height are one segment.
+    for (size_t node = 0; node + 1 < skyline.size();)
+    {
+        if (skyline[node].y == skyline[node + 1].y)
+        {
+            skyline[node].width += skyline[node + 1].width;
+            skyline.erase(skyline.begin() + node + 1);
+        }
+        else
+        {
+            node++;
+        }
+    }
+    return true;
+}
+
+// A rect starting at segment `node` rests on the highest segment it spans.
+bool AtlasBuilder::fits(const Page &page, size_t node, uint32_t width, uint32_t height, uint32_t *y)
+{
+    const std::vector<SkylineNode> &skyline = page.skyline;
+    if (skyline[node].x + width > _pageSize)
+    {
+        return false;
+    }
+    uint32_t top = 0;
+    uint32_t widthLeft = width;
+    for (size_t spanned = node; widthLeft > 0; spanned++)
+    {
+        top = std::max(top, skyline[spanned].y);
+        if (top + height > _pageSize)
+        {
+            return false;
+        }
+        widthLeft -= std::min(widthLeft, skyline[spanned].width);
+    }
+    *y = top;
+    return true;
+}
+
+// Copies the sprite into its cell and repeats its outermost texels into the padding around it.
+void AtlasBuilder::blit(ImageFile::Pixels &page, const Entry &entry)
+{
+    const ImageFile::Pixels &sprite = entry.pixels;
+    uint32_t cellHeight = sprite.height + 2 * _padding;
+    for (uint32_t cellY = 0; cellY < cellHeight; cellY++)
+    {
+        uint32_t spriteY = std::min(cellY > _padding ? cellY - _padding : 0, sprite.height - 1);
+        uint8_t *destinationRow = &page.rgba[(static_cast<size_t>(entry.y + cellY) * page.width + entry.x) * 4];
+        const uint8_t *sourceRow = &sprite.rgba[static_cast<size_t>(spriteY) * sprite.width * 4];
+        for (uint32_t cellX = 0; cellX < _padding; cellX++)
+        {
+            memcpy(destinationRow + cellX * 4, sourceRow, 4);
+            memcpy(destinationRow + (_padding + sprite.width + cellX) * 4, sourceRow + (sprite.width - 1) * 4, 4);
+        }
+        memcpy(destinationRow + _padding * 4, sourceRow, static_cast<size_t>(sprite.width) * 4);
+    }
+}
@@ -0,0 +1,99 @@
+#ifndef ATLAS_H
+#define ATLAS_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <cstdint>
+
+#include "texture.h"
+#include "../systems/imagefile.h"
+
+// Where a sprite ended up: the page texture to bind and the rect to put in Vertex::SpriteInstance::uvRect.
+struct AtlasSprite {
+  TextureCache::Handle texture = TextureCache::WHITE;
+  glm::vec4 uvRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+  uint32_t width = 0;
+  uint32_t height = 0;
+};
+
+// The result of AtlasBuilder::Build. Sprites are looked up by the name they were added with.
+class Atlas
+{
+  public:
+    // nullptr if no sprite was added under that name.
+    const AtlasSprite *Find(const std::string &name) const;
+    const std::vector<TextureCache::Handle> &GetPages() const { return _pages; }
+    size_t GetSpriteCount() const { return _sprites.size(); }
+    // Destroys the page textures, with the same rules as TextureCache::Destroy.
+    void Destroy(TextureCache &textures);
+
+  private:
+    friend class AtlasBuilder;
+
+    std::vector<TextureCache::Handle> _pages;
+    std::vector<AtlasSprite> _sprites;
+    std::unordered_map<std::string, uint32_t> _names;
+};
+
+// Packs lots of small images into a few large pages when the game starts, so the sprite batch only has to switch
+// textures between pages instead of between sprites. Tallest images go first, each one where it ends up lowest on the
+// page's skyline (the outline of what has been placed so far), which wastes little space for sprite sized rects.
+// Every sprite gets `padding` texels of its own edge color around it, so linear filtering doesn't bleed neighbouring
+// sprites into it. Each mip level halves the padding, so pages only get the log2(padding) + 1 levels it still covers,
+// 2 with the default padding. More padding buys more levels for sprites drawn far zoomed out.
+// https://github.com/juj/RectangleBinPack/blob/master/RectangleBinPack.pdf
+class AtlasBuilder
+{
+  public:
+    // 4096 is the largest 2D image every Vulkan device has to support, 2048 leaves room for the mips.
+    static constexpr uint32_t DEFAULT_PAGE_SIZE = 2048;
+    static constexpr uint32_t DEFAULT_PADDING = 2;
+
+    explicit AtlasBuilder(uint32_t pageSize = DEFAULT_PAGE_SIZE, uint32_t padding = DEFAULT_PADDING);
+
+    // Adding a name twice replaces the earlier image.
+    void Add(const std::string &name, ImageFile::Pixels pixels);
+    // Adds ImageFile::Load(path) under its path.
+    void AddFile(const std::string &path);
+
+    // Packs every image added so far into pages and creates a texture for each, then empties the builder.
+    // Throws if an image doesn't fit on a page even on its own.
+    Atlas Build(TextureCache &textures, const TextureOptions &options = TextureOptions());
+
+  private:
+    struct Entry
+    {
+        std::string name;
+        ImageFile::Pixels pixels;
+        uint32_t page = 0;
+        uint32_t x = 0; // Top left of the padded cell
+        uint32_t y = 0;
+    };
+
+    // A horizontal segment of a page's skyline, everything below y is taken.
+    struct SkylineNode
+    {
+        uint32_t x;
+        uint32_t y;
+        uint32_t width;
+    };
+
+    struct Page
+    {
+        std::vector<SkylineNode> skyline;
+        uint32_t usedHeight = 0;
+    };
+
+    uint32_t _pageSize;
+    uint32_t _padding;
+    std::vector<Entry> _entries;
+    std::unordered_map<std::string, size_t> _entryLookup;
+
+    bool place(Page &page, uint32_t width, uint32_t height, uint32_t *x, uint32_t *y);
+    bool fits(const Page &page, size_t node, uint32_t width, uint32_t height, uint32_t *y);
+    void blit(ImageFile::Pixels &page, const Entry &entry);
+};
+
+#endif
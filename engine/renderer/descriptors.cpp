@@ -0,0 +1,250 @@
+#include <vulkan/vulkan.h>
+#include <stdexcept>
+#include <algorithm>
+
+#include "descriptors.h"
+
+namespace
+{
+    // FNV-1a over the fields that make two layouts different.
+    uint64_t hashBindings(const VkDescriptorSetLayoutBinding *bindings, uint32_t count)
+    {
+        uint64_t hash = 14695981039346656037ull;
+        auto mix = [&hash](uint32_t value) {
+            for (int i = 0; i < 4; i++)
+            {
+                hash ^= (value >> (i * 8)) & 0xFF;
+                hash *= 1099511628211ull;
+            }
+        };
+        for (uint32_t i = 0; i < count; i++)
+        {
+            mix(bindings[i].binding);
+            mix(static_cast<uint32_t>(bindings[i].descriptorType));
+            mix(bindings[i].descriptorCount);
+            mix(bindings[i].stageFlags);
+        }
+        return hash;
+    }
+
+    bool sameBindings(const VkDescriptorSetLayoutBinding &a, const VkDescriptorSetLayoutBinding &b)
+    {
+        return a.binding == b.binding && a.descriptorType == b.descriptorType && a.descriptorCount == b.descriptorCount && a.stageFlags == b.stageFlags;
+    }
+}
+
+void DescriptorLayoutCache::Init(VkDevice logicalDevice)
+{
+    _logicalDevice = logicalDevice;
+}
+
+void DescriptorLayoutCache::Cleanup()
+{
+    for (auto &entry : _layouts)
+    {
+        vkDestroyDescriptorSetLayout(_logicalDevice, entry.second.layout, nullptr);
+    }
+    _layouts.clear();
+}
+
+VkDescriptorSetLayout DescriptorLayoutCache::Get(const VkDescriptorSetLayoutBinding *bindings, uint32_t bindingCount)
+{
+    if (bindingCount > MAX_BINDINGS)
+    {
+        throw std::runtime_error("Descriptor set has more bindings than the layout cache supports.");
+    }
+
+    // Sorted by binding number, so the same bindings declared in a different order still hit the same entry.
+    Entry entry;
+    entry.bindingCount = bindingCount;
+    std::copy(bindings, bindings + bindingCount, entry.bindings.begin());
+    std::sort(entry.bindings.begin(), entry.bindings.begin() + bindingCount, [](const VkDescriptorSetLayoutBinding &a, const VkDescriptorSetLayoutBinding &b) { return a.binding < b.binding; });
+
+    uint64_t hash = hashBindings(entry.bindings.data(), bindingCount);
+    auto range = _layouts.equal_range(hash);
+    for (auto found = range.first; found != range.second; ++found)
+    {
+        const Entry &cached = found->second;
+        if (cached.bindingCount == bindingCount && std::equal(cached.bindings.begin(), cached.bindings.begin() + bindingCount, entry.bindings.begin(), sameBindings))
+        {
+            return cached.layout;
+        }
+    }
+
+    for (uint32_t i = 0; i < bindingCount; i++)
+    {
+        if (entry.bindings[i].pImmutableSamplers != nullptr)
+        {
+            throw std::runtime_error("Immutable samplers aren't supported by the descriptor layout cache.");
+        }
+    }
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = bindingCount;
+    layoutInfo.pBindings = entry.bindings.data();
+    if (vkCreateDescriptorSetLayout(_logicalDevice, &layoutInfo, nullptr, &entry.layout) != VkResult::VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create descriptor set layout.");
+    }
+    _layouts.emplace(hash, entry);
+    return entry.layout;
+}
+
+void DescriptorAllocator::Init(VkDevice logicalDevice, uint32_t setsPerPool)
+{
+    _logicalDevice = logicalDevice;
+    _nextPoolSize = std::max(setsPerPool, 1u);
+}
+
+void DescriptorAllocator::Cleanup()
+{
+    for (VkDescriptorPool pool : _usedPools)
+    {
+        vkDestroyDescriptorPool(_logicalDevice, pool, nullptr);
+    }
+    for (VkDescriptorPool pool : _freePools)
+    {
+        vkDestroyDescriptorPool(_logicalDevice, pool, nullptr);
+    }
+    _usedPools.clear();
+    _freePools.clear();
+    _currentPool = VK_NULL_HANDLE;
+}
+
+VkDescriptorSet DescriptorAllocator::Allocate(VkDescriptorSetLayout layout)
+{
+    if (_currentPool == VK_NULL_HANDLE)
+    {
+        _currentPool = grabPool();
+        _usedPools.push_back(_currentPool);
+    }
+
+    VkDescriptorSetAllocateInfo allocateInfo = {};
+    allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocateInfo.descriptorPool = _currentPool;
+    allocateInfo.descriptorSetCount = 1;
+    allocateInfo.pSetLayouts = &layout;
+    VkDescriptorSet set = VK_NULL_HANDLE;
+    VkResult result = vkAllocateDescriptorSets(_logicalDevice, &allocateInfo, &set);
+    if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL)
+    {
+        // The pool is full (or, for a 1.0 driver, says it is fragmented), move on to a fresh one and try once more.
+        _currentPool = grabPool();
+        _usedPools.push_back(_currentPool);
+        allocateInfo.descriptorPool = _currentPool;
+        result = vkAllocateDescriptorSets(_logicalDevice, &allocateInfo, &set);
+    }
+    if (result != VkResult::VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to allocate descriptor set.");
+    }
+    return set;
+}
+
+void DescriptorAllocator::Reset()
+{
+    for (VkDescriptorPool pool : _usedPools)
+    {
+        vkResetDescriptorPool(_logicalDevice, pool, 0);
+        _freePools.push_back(pool);
+    }
+    _usedPools.clear();
+    _currentPool = VK_NULL_HANDLE;
+}
+
+// Pools that were reset come back before a new one is created. They were all created large enough at some point,
+// so a frame that needed a few pools at startup settles into reusing them.
+VkDescriptorPool DescriptorAllocator::grabPool()
+{
+    if (!_freePools.empty())
+    {
+        VkDescriptorPool pool = _freePools.back();
+        _freePools.pop_back();
+        return pool;
+    }
+
+    uint32_t sets = _nextPoolSize;
+    _nextPoolSize = std::min(_nextPoolSize * 2, MAX_SETS_PER_POOL);
+    std::array<VkDescriptorPoolSize, POOL_RATIOS.size()> sizes;
+    for (size_t i = 0; i < POOL_RATIOS.size(); i++)
+    {
+        sizes[i].type = POOL_RATIOS[i].type;
+        sizes[i].descriptorCount = std::max(static_cast<uint32_t>(POOL_RATIOS[i].descriptorsPerSet * sets), 1u);
+    }
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.maxSets = sets;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(sizes.size());
+    poolInfo.pPoolSizes = sizes.data();
+    VkDescriptorPool pool;
+    if (vkCreateDescriptorPool(_logicalDevice, &poolInfo, nullptr, &pool) != VkResult::VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create descriptor pool.");
+    }
+    return pool;
+}
+
+DescriptorBuilder &DescriptorBuilder::BindBuffer(uint32_t binding, const VkDescriptorBufferInfo &bufferInfo, VkDescriptorType type, VkShaderStageFlags stages)
+{
+    uint32_t index = _count;
+    addBinding(binding, type, stages);
+    _bufferInfos[index] = bufferInfo;
+    return *this;
+}
+
+DescriptorBuilder &DescriptorBuilder::BindImage(uint32_t binding, const VkDescriptorImageInfo &imageInfo, VkDescriptorType type, VkShaderStageFlags stages)
+{
+    uint32_t index = _count;
+    addBinding(binding, type, stages);
+    _imageInfos[index] = imageInfo;
+    return *this;
+}
+
+VkDescriptorSet DescriptorBuilder::Build(VkDescriptorSetLayout *layout)
+{
+    VkDescriptorSetLayout setLayout = BuildLayout();
+    if (layout != nullptr)
+    {
+        *layout = setLayout;
+    }
+    VkDescriptorSet set = _allocator.Allocate(setLayout);
+    // Pointers are filled in here rather than when binding, so they are into this builder even if it was copied.
+    for (uint32_t i = 0; i < _count; i++)
+    {
+        VkWriteDescriptorSet &write = _writes[i];
+        write.dstSet = set;
+        bool isImage = write.descriptorType == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER || write.descriptorType == VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE || write.descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE || write.descriptorType == VK_DESCRIPTOR_TYPE_SAMPLER || write.descriptorType == VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+        write.pImageInfo = isImage ? &_imageInfos[i] : nullptr;
+        write.pBufferInfo = isImage ? nullptr : &_bufferInfos[i];
+    }
+    vkUpdateDescriptorSets(_allocator.GetDevice(), _count, _writes.data(), 0, nullptr);
+    return set;
+}
+
+VkDescriptorSetLayout DescriptorBuilder::BuildLayout()
+{
+    return _layoutCache.Get(_bindings.data(), _count);
+}
+
+void DescriptorBuilder::addBinding(uint32_t binding, VkDescriptorType type, VkShaderStageFlags stages)
+{
+    if (_count == DescriptorLayoutCache::MAX_BINDINGS)
+    {
+        throw std::runtime_error("Descriptor set has more bindings than the builder supports.");
+    }
+    VkDescriptorSetLayoutBinding &layoutBinding = _bindings[_count];
+    layoutBinding = {};
+    layoutBinding.binding = binding;
+    layoutBinding.descriptorType = type;
+    layoutBinding.descriptorCount = 1;
+    layoutBinding.stageFlags = stages;
+
+    VkWriteDescriptorSet &write = _writes[_count];
+    write = {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstBinding = binding;
+    write.dstArrayElement = 0;
+    write.descriptorType = type;
+    write.descriptorCount = 1;
+    _count++;
+}
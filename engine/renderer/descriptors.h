@@ -0,0 +1,123 @@
+#ifndef DESCRIPTORS_H
+#define DESCRIPTORS_H
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <array>
+#include <unordered_map>
+#include <cstdint>
+
+// Descriptor set layouts, pools and writes. Modelled on vkguide's abstraction:
+// https://vkguide.dev/docs/extra-chapter/abstracting_descriptors/
+//
+// None of these are thread safe. Sets are built on the thread that calls DrawFrame, before recording starts.
+
+// One VkDescriptorSetLayout per distinct set of bindings. Pipelines and sets asking for the same bindings get the
+// same layout, so sets are compatible across every pipeline that declares them and layouts are never duplicated.
+// Lookups hash the bindings in place and don't allocate.
+class DescriptorLayoutCache
+{
+  public:
+    // More bindings than this in one set isn't supported, the engine's sets have one or two.
+    static constexpr uint32_t MAX_BINDINGS = 16;
+
+    void Init(VkDevice logicalDevice);
+    void Cleanup();
+
+    // Bindings may come in any order. Immutable samplers aren't supported, pImmutableSamplers has to be nullptr.
+    // The layout is owned by the cache and lives until Cleanup.
+    VkDescriptorSetLayout Get(const VkDescriptorSetLayoutBinding *bindings, uint32_t bindingCount);
+    uint32_t GetLayoutCount() { return static_cast<uint32_t>(_layouts.size()); }
+
+  private:
+    struct Entry
+    {
+        std::array<VkDescriptorSetLayoutBinding, MAX_BINDINGS> bindings;
+        uint32_t bindingCount;
+        VkDescriptorSetLayout layout;
+    };
+
+    VkDevice _logicalDevice = VK_NULL_HANDLE;
+    // Keyed by the hash of the sorted bindings. Entries that happen to share a hash sit side by side.
+    std::unordered_multimap<uint64_t, Entry> _layouts;
+};
+
+// Hands out descriptor sets from a list of pools that grows when the current one runs dry. Sets are never freed
+// one by one, Reset() returns every pool to a single vkResetDescriptorPool each, which is how per-frame sets are
+// meant to be recycled: one allocator per frame in flight, reset once that frame's fence has signaled.
+// After the first few frames the pools are big enough and allocating is just vkAllocateDescriptorSets.
+class DescriptorAllocator
+{
+  public:
+    // setsPerPool is the size of the first pool, every pool after that is twice as big as the one before, up to
+    // MAX_SETS_PER_POOL. The pool's descriptor counts are setsPerPool times the ratios in POOL_RATIOS.
+    void Init(VkDevice logicalDevice, uint32_t setsPerPool);
+    void Cleanup();
+
+    VkDescriptorSet Allocate(VkDescriptorSetLayout layout);
+    // Every set allocated since the last Reset becomes invalid. Only once the GPU is done with all of them.
+    void Reset();
+    uint32_t GetPoolCount() { return static_cast<uint32_t>(_usedPools.size() + _freePools.size()); }
+    VkDevice GetDevice() { return _logicalDevice; }
+
+  private:
+    static constexpr uint32_t MAX_SETS_PER_POOL = 4096;
+
+    struct PoolRatio
+    {
+        VkDescriptorType type;
+        float descriptorsPerSet;
+    };
+
+    // What an average set holds, the engine's sets are mostly a texture or a uniform buffer.
+    static constexpr std::array<PoolRatio, 6> POOL_RATIOS = {{
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2.0f},
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.0f},
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1.0f},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 0.5f},
+        {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 0.5f},
+    }};
+
+    VkDevice _logicalDevice = VK_NULL_HANDLE;
+    uint32_t _nextPoolSize = 0;
+    VkDescriptorPool _currentPool = VK_NULL_HANDLE;
+    std::vector<VkDescriptorPool> _usedPools;
+    std::vector<VkDescriptorPool> _freePools;
+
+    VkDescriptorPool grabPool();
+};
+
+// Describes a set binding by binding, then gets its layout from a DescriptorLayoutCache, allocates it from a
+// DescriptorAllocator and writes it in one vkUpdateDescriptorSets. Everything is kept in fixed size arrays, so
+// building a set every frame doesn't touch the heap.
+//
+//     VkDescriptorSet set = DescriptorBuilder(layouts, frameDescriptors)
+//         .BindBuffer(0, cameraBuffer, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT)
+//         .BindImage(1, texture, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
+//         .Build();
+class DescriptorBuilder
+{
+  public:
+    DescriptorBuilder(DescriptorLayoutCache &layoutCache, DescriptorAllocator &allocator) : _layoutCache(layoutCache), _allocator(allocator) {}
+
+    DescriptorBuilder &BindBuffer(uint32_t binding, const VkDescriptorBufferInfo &bufferInfo, VkDescriptorType type, VkShaderStageFlags stages);
+    DescriptorBuilder &BindImage(uint32_t binding, const VkDescriptorImageInfo &imageInfo, VkDescriptorType type, VkShaderStageFlags stages);
+    // Throws if the set can't be allocated. layout, if given, receives the set's layout for building a pipeline with.
+    VkDescriptorSet Build(VkDescriptorSetLayout *layout = nullptr);
+    // Just the layout, nothing is allocated or written.
+    VkDescriptorSetLayout BuildLayout();
+
+  private:
+    DescriptorLayoutCache &_layoutCache;
+    DescriptorAllocator &_allocator;
+    uint32_t _count = 0;
+    std::array<VkDescriptorSetLayoutBinding, DescriptorLayoutCache::MAX_BINDINGS> _bindings;
+    std::array<VkWriteDescriptorSet, DescriptorLayoutCache::MAX_BINDINGS> _writes;
+    std::array<VkDescriptorBufferInfo, DescriptorLayoutCache::MAX_BINDINGS> _bufferInfos;
+    std::array<VkDescriptorImageInfo, DescriptorLayoutCache::MAX_BINDINGS> _imageInfos;
+
+    void addBinding(uint32_t binding, VkDescriptorType type, VkShaderStageFlags stages);
+};
+
+#endif
@@ -0,0 +1,90 @@
+#include <vulkan/vulkan.h>
+#include <iostream>
+#include <algorithm>
+
+#include "framering.h"
+
+void FrameRing::Init(Memory::Allocator &allocator, VkPhysicalDevice physicalDevice, uint32_t framesInFlight, VkDeviceSize bytesPerFrame)
+{
+    _allocator = &allocator;
+    _framesInFlight = framesInFlight;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    // Both are powers of two, at most 256 bytes.
+    _uniformAlignment = std::max<VkDeviceSize>(properties.limits.minUniformBufferOffsetAlignment, 4);
+    _storageAlignment = std::max<VkDeviceSize>(properties.limits.minStorageBufferOffsetAlignment, 4);
+
+    // Regions start on a uniform offset boundary, so the first allocation of a frame never needs padding.
+    _regionSize = (bytesPerFrame + _uniformAlignment - 1) & ~(_uniformAlignment - 1);
+    _buffer = _allocator->CreateBuffer(_regionSize * framesInFlight, RING_USAGE, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    _frame = 0;
+    _regionStart = 0;
+    _head = 0;
+}
+
+void FrameRing::Cleanup()
+{
+    for (RetiredBuffer &retired : _retired)
+    {
+        _allocator->DestroyBuffer(retired.buffer);
+    }
+    _retired.clear();
+    _allocator->DestroyBuffer(_buffer);
+}
+
+void FrameRing::BeginFrame(uint32_t frame)
+{
+    _frame = frame;
+    _regionStart = _regionSize * frame;
+    _head = _regionStart;
+
+    for (size_t i = 0; i < _retired.size();)
+    {
+        if (--_retired[i].framesLeft == 0)
+        {
+            _allocator->DestroyBuffer(_retired[i].buffer);
+            _retired[i] = _retired.back();
+            _retired.pop_back();
+        }
+        else
+        {
+            i++;
+        }
+    }
+}
+
+FrameRing::Slice FrameRing::Allocate(VkDeviceSize size, VkDeviceSize alignment)
+{
+    VkDeviceSize offset = (_head + alignment - 1) & ~(alignment - 1);
+    if (offset + size > _regionStart + _regionSize)
+    {
+        grow(size + alignment);
+        offset = (_head + alignment - 1) & ~(alignment - 1);
+    }
+    _head = offset + size;
+
+    Slice slice;
+    slice.buffer = _buffer.buffer;
+    slice.offset = offset;
+    slice.size = size;
+    slice.data = static_cast<char *>(_buffer.allocation.mapped) + offset;
+    return slice;
+}
+
+// Slices already handed out this frame point into the old buffer and stay valid, the frame just continues in the new one.
+void FrameRing::grow(VkDeviceSize needed)
+{
+    VkDeviceSize regionSize = _regionSize * 2;
+    while (regionSize < needed)
+    {
+        regionSize *= 2;
+    }
+    std::cout << "Growing frame data ring to " << regionSize / 1024 << "KB per frame" << std::endl;
+
+    _retired.push_back({_buffer, _framesInFlight});
+    _buffer = _allocator->CreateBuffer(regionSize * _framesInFlight, RING_USAGE, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    _regionSize = regionSize;
+    _regionStart = _regionSize * _frame;
+    _head = _regionStart;
+}
@@ -0,0 +1,95 @@
+#ifndef FRAME_RING_H
+#define FRAME_RING_H
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <cstdint>
+
+#include "memory.h"
+
+// Per-frame data the GPU reads once and the CPU rewrites every frame: instance data, camera and material uniforms.
+// One persistently mapped, host coherent buffer is split into one region per frame in flight. BeginFrame(frame)
+// is called once the frame's fence has signaled, so everything in that region is free again, and allocating is
+// a bump of the region's head: no mapping, no flushing, no per-allocation Vulkan calls.
+// https://developer.nvidia.com/vulkan-shader-resource-binding
+//
+// Not thread safe. Allocate on the thread that calls DrawFrame, then hand the slices to recording threads.
+class FrameRing
+{
+  public:
+    // Where an allocation landed. data is already mapped and stays valid until the frame's region is reused.
+    struct Slice
+    {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceSize offset = 0;
+        VkDeviceSize size = 0;
+        void *data = nullptr;
+    };
+
+    // bytesPerFrame is the starting size of each region. A frame that needs more grows every region to twice the
+    // size, the old buffer is kept alive until every frame that may read it has passed its fence again.
+    void Init(Memory::Allocator &allocator, VkPhysicalDevice physicalDevice, uint32_t framesInFlight, VkDeviceSize bytesPerFrame);
+    void Cleanup();
+
+    // Only once frame's fence has signaled. Every slice handed out the last time frame was used becomes invalid.
+    void BeginFrame(uint32_t frame);
+
+    // alignment has to be a power of two.
+    Slice Allocate(VkDeviceSize size, VkDeviceSize alignment);
+    // Aligned to minUniformBufferOffsetAlignment, so offset can be passed as the dynamic offset of a
+    // VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC binding to GetBuffer().
+    Slice AllocateUniform(VkDeviceSize size) { return Allocate(size, _uniformAlignment); }
+    Slice AllocateStorage(VkDeviceSize size) { return Allocate(size, _storageAlignment); }
+
+    // Copies count values into the ring, aligned for T. Usable as instance data or index data as is.
+    template <typename T>
+    Slice Push(const T *values, size_t count)
+    {
+        Slice slice = Allocate(sizeof(T) * count, alignof(T) < 4 ? 4 : alignof(T));
+        T *destination = static_cast<T *>(slice.data);
+        for (size_t i = 0; i < count; i++)
+        {
+            destination[i] = values[i];
+        }
+        return slice;
+    }
+    template <typename T>
+    Slice PushUniform(const T &value)
+    {
+        Slice slice = AllocateUniform(sizeof(T));
+        *static_cast<T *>(slice.data) = value;
+        return slice;
+    }
+
+    // Changes when the ring grows, so descriptor sets pointing at it should be built per frame (see
+    // Renderer::GetFrameDescriptors) rather than once at startup.
+    VkBuffer GetBuffer() { return _buffer.buffer; }
+    VkDeviceSize GetFrameCapacity() { return _regionSize; }
+    // Bytes handed out since the current frame's BeginFrame, including alignment padding.
+    VkDeviceSize GetUsedBytes() { return _head - _regionStart; }
+
+  private:
+    const VkBufferUsageFlags RING_USAGE = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+
+    // A buffer the ring grew out of, destroyed once framesLeft frames have begun since.
+    struct RetiredBuffer
+    {
+        Memory::Buffer buffer;
+        uint32_t framesLeft;
+    };
+
+    Memory::Allocator *_allocator = nullptr;
+    uint32_t _framesInFlight = 0;
+    VkDeviceSize _uniformAlignment = 1;
+    VkDeviceSize _storageAlignment = 1;
+    Memory::Buffer _buffer;
+    VkDeviceSize _regionSize = 0;
+    uint32_t _frame = 0;
+    VkDeviceSize _regionStart = 0;
+    VkDeviceSize _head = 0;
+    std::vector<RetiredBuffer> _retired;
+
+    void grow(VkDeviceSize needed);
+};
+
+#endif
@@ -0,0 +1,179 @@
+#include <vulkan/vulkan.h>
+#include <iostream>
+#include <iomanip>
+#include <stdexcept>
+#include <algorithm>
+
+#include "gpuprofiler.h"
+
+void GpuProfiler::Init(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, uint32_t queueFamily, uint32_t framesInFlight, uint32_t maxScopesPerFrame)
+{
+    _logicalDevice = logicalDevice;
+    _maxScopes = maxScopesPerFrame;
+
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+    uint32_t validBits = queueFamily < queueFamilyCount ? queueFamilies[queueFamily].timestampValidBits : 0;
+    if (validBits == 0)
+    {
+        std::cout << "Queue family has no timestamp support, GPU profiling is disabled" << std::endl;
+        return;
+    }
+    _timestampMask = validBits >= 64 ? UINT64_MAX : (uint64_t(1) << validBits) - 1;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    _timestampPeriod = properties.limits.timestampPeriod;
+
+    _pools.resize(framesInFlight);
+    for (FrameQueries &queries : _pools)
+    {
+        // Two timestamps per scope, begin and end.
+        VkQueryPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        poolInfo.queryCount = _maxScopes * 2;
+        if (vkCreateQueryPool(logicalDevice, &poolInfo, nullptr, &queries.pool) != VkResult::VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create timestamp query pool.");
+        }
+        queries.scopeNames.resize(_maxScopes);
+    }
+    _results.resize(_maxScopes * 2);
+}
+
+void GpuProfiler::Cleanup()
+{
+    for (FrameQueries &queries : _pools)
+    {
+        vkDestroyQueryPool(_logicalDevice, queries.pool, nullptr);
+    }
+    _pools.clear();
+}
+
+void GpuProfiler::BeginFrame(VkCommandBuffer commandBuffer, uint32_t frame)
+{
+    if (_pools.empty())
+    {
+        return;
+    }
+    _currentFrame = frame;
+    FrameQueries &queries = _pools[frame];
+    collect(queries);
+    // Queries have to be reset before they are written again, and the reset can't happen inside a render pass.
+    vkCmdResetQueryPool(commandBuffer, queries.pool, 0, _maxScopes * 2);
+    queries.scopeCount = 0;
+}
+
+uint32_t GpuProfiler::BeginScope(VkCommandBuffer commandBuffer, const char *name)
+{
+    if (_pools.empty())
+    {
+        return INVALID_SCOPE;
+    }
+    FrameQueries &queries = _pools[_currentFrame];
+    if (queries.scopeCount == _maxScopes)
+    {
+        return INVALID_SCOPE;
+    }
+    uint32_t scope = queries.scopeCount;
+    queries.scopeNames[scope] = name;
+    queries.scopeCount += 1;
+    // TOP_OF_PIPE for the start and BOTTOM_OF_PIPE for the end brackets all work recorded in between,
+    // the timestamp is written once every earlier command has reached that stage.
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queries.pool, scope * 2);
+    return scope;
+}
+
+void GpuProfiler::EndScope(VkCommandBuffer commandBuffer, uint32_t scope)
+{
+    if (scope == INVALID_SCOPE)
+    {
+        return;
+    }
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, _pools[_currentFrame].pool, scope * 2 + 1);
+}
+
+double GpuProfiler::GetLastMilliseconds(const char *name)
+{
+    for (const PassTimings &pass : _passes)
+    {
+        if (pass.name == name)
+        {
+            return pass.lastMilliseconds;
+        }
+    }
+    return 0.0;
+}
+
+void GpuProfiler::PrintReport()
+{
+    if (_pools.empty())
+    {
+        return;
+    }
+    std::cout << "GPU pass timings (ms, last " << ROLLING_WINDOW << " frames):" << std::endl;
+    std::cout << std::fixed << std::setprecision(3);
+    for (const PassTimings &pass : _passes)
+    {
+        std::cout << "\t" << pass.name << ": min " << pass.minMilliseconds << " avg " << pass.avgMilliseconds << " max " << pass.maxMilliseconds << std::endl;
+    }
+    std::cout << std::defaultfloat;
+}
+
+// The frame's fence has signaled by the time this runs, so every query written last time is available.
+// No WAIT_BIT: if a driver still says NOT_READY the frame is skipped instead of blocking.
+void GpuProfiler::collect(FrameQueries &queries)
+{
+    if (queries.scopeCount == 0)
+    {
+        return;
+    }
+    uint32_t queryCount = queries.scopeCount * 2;
+    VkResult result = vkGetQueryPoolResults(_logicalDevice, queries.pool, 0, queryCount, queryCount * sizeof(uint64_t), _results.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    if (result != VkResult::VK_SUCCESS)
+    {
+        return;
+    }
+    for (uint32_t scope = 0; scope < queries.scopeCount; scope++)
+    {
+        uint64_t ticks = (_results[scope * 2 + 1] - _results[scope * 2]) & _timestampMask;
+        addSample(queries.scopeNames[scope], static_cast<double>(ticks) * _timestampPeriod / 1000000.0);
+    }
+}
+
+void GpuProfiler::addSample(const char *name, double milliseconds)
+{
+    size_t index = 0;
+    while (index < _passes.size() && _passes[index].name != name)
+    {
+        index++;
+    }
+    if (index == _passes.size())
+    {
+        // Only the first frame a scope shows up in allocates.
+        _passes.emplace_back();
+        _passes.back().name = name;
+        _histories.emplace_back();
+    }
+
+    PassTimings &pass = _passes[index];
+    PassHistory &history = _histories[index];
+    history.samples[history.next] = milliseconds;
+    history.next = (history.next + 1) % ROLLING_WINDOW;
+    pass.samples = std::min(pass.samples + 1, ROLLING_WINDOW);
+    pass.lastMilliseconds = milliseconds;
+
+    double total = 0.0;
+    pass.minMilliseconds = milliseconds;
+    pass.maxMilliseconds = milliseconds;
+    for (uint32_t i = 0; i < pass.samples; i++)
+    {
+        total += history.samples[i];
+        pass.minMilliseconds = std::min(pass.minMilliseconds, history.samples[i]);
+        pass.maxMilliseconds = std::max(pass.maxMilliseconds, history.samples[i]);
+    }
+    pass.avgMilliseconds = total / pass.samples;
+}
\ No newline at end of file
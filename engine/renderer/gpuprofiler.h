@@ -0,0 +1,80 @@
+#ifndef GPU_PROFILER_H
+#define GPU_PROFILER_H
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <string>
+#include <cstdint>
+
+// Measures how long the GPU spends on parts of a frame with timestamp queries.
+// Every frame in flight gets its own query pool. The results of a pool are read back right before it is reused,
+// once that frame's fence has signaled, so reading never stalls: the numbers are always MAX_FRAMES_IN_FLIGHT frames old.
+// Software ICDs like lavapipe support timestamps too, devices without them (timestampValidBits == 0) just report nothing.
+// https://docs.vulkan.org/samples/latest/samples/api/timestamp_queries/README.html
+class GpuProfiler
+{
+  public:
+    // Rolling timings of one named scope over the last ROLLING_WINDOW frames it was recorded in.
+    struct PassTimings
+    {
+        std::string name;
+        double lastMilliseconds = 0.0;
+        double minMilliseconds = 0.0;
+        double avgMilliseconds = 0.0;
+        double maxMilliseconds = 0.0;
+        uint32_t samples = 0;
+    };
+
+    // Handed back by BeginScope when the profiler is off or the frame ran out of queries, EndScope ignores it.
+    static constexpr uint32_t INVALID_SCOPE = UINT32_MAX;
+    static constexpr uint32_t ROLLING_WINDOW = 120;
+
+    void Init(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, uint32_t queueFamily, uint32_t framesInFlight, uint32_t maxScopesPerFrame);
+    void Cleanup();
+    bool IsSupported() { return !_pools.empty(); }
+
+    // Reads back what `frame` measured last time around and resets its queries. Has to be recorded outside of a
+    // render pass, first thing in the frame's command buffer, and only once the frame's fence has signaled.
+    void BeginFrame(VkCommandBuffer commandBuffer, uint32_t frame);
+    // Scopes nest and may span a whole render pass. name has to outlive the frame, string literals are the usual case.
+    uint32_t BeginScope(VkCommandBuffer commandBuffer, const char *name);
+    void EndScope(VkCommandBuffer commandBuffer, uint32_t scope);
+
+    const std::vector<PassTimings> &GetPassTimings() { return _passes; }
+    // Last measured time of a scope, 0 if it was never measured.
+    double GetLastMilliseconds(const char *name);
+    void PrintReport();
+
+  private:
+    struct FrameQueries
+    {
+        VkQueryPool pool = VK_NULL_HANDLE;
+        std::vector<const char *> scopeNames;
+        // Scopes recorded into the pool since it was reset. Nothing is read back before the first frame.
+        uint32_t scopeCount = 0;
+    };
+
+    struct PassHistory
+    {
+        double samples[ROLLING_WINDOW] = {};
+        uint32_t next = 0;
+    };
+
+    VkDevice _logicalDevice = VK_NULL_HANDLE;
+    std::vector<FrameQueries> _pools;
+    uint32_t _maxScopes = 0;
+    uint32_t _currentFrame = 0;
+    // Nanoseconds per timestamp tick.
+    double _timestampPeriod = 1.0;
+    // Only the low timestampValidBits of a timestamp are meaningful, differences wrap around at that width.
+    uint64_t _timestampMask = 0;
+
+    std::vector<PassTimings> _passes;
+    std::vector<PassHistory> _histories;
+    std::vector<uint64_t> _results;
+
+    void collect(FrameQueries &queries);
+    void addSample(const char *name, double milliseconds);
+};
+
+#endif
\ No newline at end of file
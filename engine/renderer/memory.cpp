@@ -0,0 +1,371 @@
+#include <vulkan/vulkan.h>
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+
+#include "memory.h"
+#include "renderdevice.h"
+
+void Memory::Allocator::Init(VkPhysicalDevice physicalDevice, VkDevice logicalDevice)
+{
+    _physicalDevice = physicalDevice;
+    _logicalDevice = logicalDevice;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &_memoryProperties);
+}
+
+void Memory::Allocator::Cleanup()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (Block &block : _blocks)
+    {
+        if (block.memory == VK_NULL_HANDLE)
+        {
+            continue;
+        }
+        if (block.allocationCount > 0)
+        {
+            std::cout << "Warning: freeing memory block with " << block.allocationCount << " live allocations." << std::endl;
+        }
+        // Freeing mapped memory implicitly unmaps it.
+        vkFreeMemory(_logicalDevice, block.memory, nullptr);
+    }
+    _blocks.clear();
+    if (_dedicatedCount > 0)
+    {
+        std::cout << "Warning: " << _dedicatedCount << " dedicated allocations were never freed." << std::endl;
+    }
+}
+
+Memory::Allocation Memory::Allocator::Allocate(const VkMemoryRequirements &requirements, VkMemoryPropertyFlags properties, bool linear)
+{
+    uint32_t memoryType = RenderDevice::FindMemoryType(_physicalDevice, requirements.memoryTypeBits, properties);
+    VkDeviceSize blockSize = blockSizeForType(memoryType);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    Allocation allocation = {};
+    allocation.memoryType = memoryType;
+    allocation.size = requirements.size;
+
+    // Big resources (render targets, large textures) get their own VkDeviceMemory instead of eating half a block.
+    if (requirements.size > blockSize / 2)
+    {
+        allocation.memory = allocateDeviceMemory(requirements.size, memoryType, &allocation.mapped);
+        allocation.dedicated = true;
+        _dedicatedCount += 1;
+        _dedicatedBytes += requirements.size;
+        return allocation;
+    }
+
+    uint32_t blockIndex = static_cast<uint32_t>(_blocks.size());
+    VkDeviceSize offset = 0;
+    for (uint32_t i = 0; i < _blocks.size(); i++)
+    {
+        Block &block = _blocks[i];
+        if (block.memory != VK_NULL_HANDLE && block.memoryType == memoryType && block.linear == linear && allocateFromBlock(block, requirements, &offset))
+        {
+            blockIndex = i;
+            break;
+        }
+    }
+
+    if (blockIndex == _blocks.size())
+    {
+        blockIndex = createBlock(memoryType, linear);
+        if (!allocateFromBlock(_blocks[blockIndex], requirements, &offset))
+        {
+            throw std::runtime_error("Failed to sub-allocate from a fresh memory block.");
+        }
+    }
+
+    Block &block = _blocks[blockIndex];
+    block.allocationCount += 1;
+    allocation.memory = block.memory;
+    allocation.offset = offset;
+    allocation.blockIndex = blockIndex;
+    if (block.mapped != nullptr)
+    {
+        allocation.mapped = static_cast<char *>(block.mapped) + offset;
+    }
+    return allocation;
+}
+
+void Memory::Allocator::Free(Allocation &allocation)
+{
+    if (allocation.memory == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (allocation.dedicated)
+    {
+        vkFreeMemory(_logicalDevice, allocation.memory, nullptr);
+        _dedicatedCount -= 1;
+        _dedicatedBytes -= allocation.size;
+        allocation = {};
+        return;
+    }
+
+    Block &block = _blocks[allocation.blockIndex];
+    // Insert the range back in offset order, then merge it with its neighbours if they touch.
+    FreeRange range = {allocation.offset, allocation.size};
+    std::vector<FreeRange>::iterator it = std::lower_bound(block.freeRanges.begin(), block.freeRanges.end(), range, [](const FreeRange &a, const FreeRange &b) { return a.offset < b.offset; });
+    it = block.freeRanges.insert(it, range);
+    std::vector<FreeRange>::iterator next = it + 1;
+    if (next != block.freeRanges.end() && it->offset + it->size == next->offset)
+    {
+        it->size += next->size;
+        block.freeRanges.erase(next);
+    }
+    if (it != block.freeRanges.begin())
+    {
+        std::vector<FreeRange>::iterator previous = it - 1;
+        if (previous->offset + previous->size == it->offset)
+        {
+            previous->size += it->size;
+            block.freeRanges.erase(it);
+        }
+    }
+
+    block.allocationCount -= 1;
+    bool linear = block.linear;
+    uint32_t memoryType = block.memoryType;
+    allocation = {};
+    if (block.allocationCount == 0)
+    {
+        releaseEmptyBlocks(memoryType, linear);
+    }
+}
+
+Memory::Buffer Memory::Allocator::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, const std::vector<uint32_t> &sharedQueueFamilies)
+{
+    Buffer buffer = {};
+    buffer.size = size;
+
+    VkBufferCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    createInfo.size = size;
+    createInfo.usage = usage;
+    createInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (sharedQueueFamilies.size() > 1)
+    {
+        createInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        createInfo.queueFamilyIndexCount = static_cast<uint32_t>(sharedQueueFamilies.size());
+        createInfo.pQueueFamilyIndices = sharedQueueFamilies.data();
+    }
+
+    if (vkCreateBuffer(_logicalDevice, &createInfo, nullptr, &buffer.buffer) != VkResult::VK_SUCCESS)
+    {
+        throw std::runtime_error("Unable to create buffer.");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(_logicalDevice, buffer.buffer, &memRequirements);
+    buffer.allocation = Allocate(memRequirements, properties, true);
+
+    if (vkBindBufferMemory(_logicalDevice, buffer.buffer, buffer.allocation.memory, buffer.allocation.offset) != VkResult::VK_SUCCESS)
+    {
+        throw std::runtime_error("Unable to bind buffer memory.");
+    }
+    return buffer;
+}
+
+void Memory::Allocator::DestroyBuffer(Buffer &buffer)
+{
+    vkDestroyBuffer(_logicalDevice, buffer.buffer, nullptr);
+    Free(buffer.allocation);
+    buffer = {};
+}
+
+Memory::Image Memory::Allocator::CreateImage(const VkImageCreateInfo &createInfo, VkMemoryPropertyFlags properties)
+{
+    Image image = {};
+    if (vkCreateImage(_logicalDevice, &createInfo, nullptr, &image.image) != VkResult::VK_SUCCESS)
+    {
+        throw std::runtime_error("Unable to create image.");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(_logicalDevice, image.image, &memRequirements);
+    image.allocation = Allocate(memRequirements, properties, createInfo.tiling == VK_IMAGE_TILING_LINEAR);
+
+    if (vkBindImageMemory(_logicalDevice, image.image, image.allocation.memory, image.allocation.offset) != VkResult::VK_SUCCESS)
+    {
+        throw std::runtime_error("Unable to bind image memory.");
+    }
+    return image;
+}
+
+void Memory::Allocator::DestroyImage(Image &image)
+{
+    vkDestroyImage(_logicalDevice, image.image, nullptr);
+    Free(image.allocation);
+    image = {};
+}
+
+Memory::AllocatorStats Memory::Allocator::GetStats()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    AllocatorStats stats = {};
+    VkDeviceSize totalFree = 0;
+    for (const Block &block : _blocks)
+    {
+        if (block.memory == VK_NULL_HANDLE)
+        {
+            continue;
+        }
+        stats.deviceMemoryCount += 1;
+        stats.allocationCount += block.allocationCount;
+        stats.bytesReserved += block.size;
+        VkDeviceSize blockFree = 0;
+        for (const FreeRange &range : block.freeRanges)
+        {
+            blockFree += range.size;
+            stats.largestFreeRange = std::max(stats.largestFreeRange, range.size);
+        }
+        stats.bytesUsed += block.size - blockFree;
+        totalFree += blockFree;
+    }
+    stats.deviceMemoryCount += _dedicatedCount;
+    stats.allocationCount += _dedicatedCount;
+    stats.bytesReserved += _dedicatedBytes;
+    stats.bytesUsed += _dedicatedBytes;
+    stats.fragmentation = totalFree > 0 ? 1.0f - static_cast<float>(stats.largestFreeRange) / static_cast<float>(totalFree) : 0.0f;
+    return stats;
+}
+
+void Memory::Allocator::PrintStats()
+{
+    AllocatorStats stats = GetStats();
+    std::cout << "Device memory: " << stats.deviceMemoryCount << " vkDeviceMemory objects, "
+              << stats.allocationCount << " allocations, "
+              << stats.bytesUsed << "/" << stats.bytesReserved << " bytes used, "
+              << "fragmentation " << stats.fragmentation << std::endl;
+}
+
+VkDeviceSize Memory::Allocator::blockSizeForType(uint32_t memoryType)
+{
+    VkDeviceSize heapSize = _memoryProperties.memoryHeaps[_memoryProperties.memoryTypes[memoryType].heapIndex].size;
+    // Small heaps (e.g. the 256MB host visible + device local window) shouldn't be eaten by a couple of blocks.
+    if (heapSize <= 1024ull * 1024 * 1024)
+    {
+        return std::min(DEFAULT_BLOCK_SIZE, heapSize / 8);
+    }
+    return DEFAULT_BLOCK_SIZE;
+}
+
+VkDeviceMemory Memory::Allocator::allocateDeviceMemory(VkDeviceSize size, uint32_t memoryType, void **mapped)
+{
+    VkMemoryAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = size;
+    allocInfo.memoryTypeIndex = memoryType;
+
+    VkDeviceMemory memory;
+    if (vkAllocateMemory(_logicalDevice, &allocInfo, nullptr, &memory) != VkResult::VK_SUCCESS)
+    {
+        throw std::runtime_error("Unable to allocate device memory.");
+    }
+
+    // Persistently map host visible memory, mapping is not free and the spec allows it to stay mapped while the GPU uses it.
+    *mapped = nullptr;
+    if (_memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+    {
+        if (vkMapMemory(_logicalDevice, memory, 0, size, 0, mapped) != VkResult::VK_SUCCESS)
+        {
+            throw std::runtime_error("Unable to map device memory.");
+        }
+    }
+    return memory;
+}
+
+bool Memory::Allocator::allocateFromBlock(Block &block, const VkMemoryRequirements &requirements, VkDeviceSize *offset)
+{
+    // Best fit: the free range with the least left over after the padding and the resource keeps large ranges intact.
+    // Of equally good ranges the least padded one wins, its padding would only become a tiny free range.
+    std::vector<FreeRange>::iterator best = block.freeRanges.end();
+    VkDeviceSize bestWaste = 0;
+    VkDeviceSize bestPadding = 0;
+    for (std::vector<FreeRange>::iterator it = block.freeRanges.begin(); it != block.freeRanges.end(); it++)
+    {
+        VkDeviceSize alignedOffset = (it->offset + requirements.alignment - 1) / requirements.alignment * requirements.alignment;
+        VkDeviceSize padding = alignedOffset - it->offset;
+        if (padding + requirements.size > it->size)
+        {
+            continue;
+        }
+        VkDeviceSize waste = it->size - (padding + requirements.size);
+        if (best == block.freeRanges.end() || waste < bestWaste || (waste == bestWaste && padding < bestPadding))
+        {
+            best = it;
+            bestWaste = waste;
+            bestPadding = padding;
+        }
+    }
+
+    if (best == block.freeRanges.end())
+    {
+        return false;
+    }
+
+    VkDeviceSize alignedOffset = (best->offset + requirements.alignment - 1) / requirements.alignment * requirements.alignment;
+    VkDeviceSize padding = alignedOffset - best->offset;
+    *offset = alignedOffset;
+    if (padding > 0)
+    {
+        // Keep the padding as its own free range, it can still fit a smaller, less aligned resource.
+        FreeRange paddingRange = {best->offset, padding};
+        best->offset = alignedOffset;
+        best->size -= padding;
+        best = block.freeRanges.insert(best, paddingRange) + 1;
+    }
+    best->offset += requirements.size;
+    best->size -= requirements.size;
+    if (best->size == 0)
+    {
+        block.freeRanges.erase(best);
+    }
+    return true;
+}
+
+uint32_t Memory::Allocator::createBlock(uint32_t memoryType, bool linear)
+{
+    Block block = {};
+    block.size = blockSizeForType(memoryType);
+    block.memoryType = memoryType;
+    block.linear = linear;
+    block.memory = allocateDeviceMemory(block.size, memoryType, &block.mapped);
+    block.freeRanges.push_back({0, block.size});
+
+    // Reuse the slot of a released block so blockIndex values stay stable for live allocations.
+    for (uint32_t i = 0; i < _blocks.size(); i++)
+    {
+        if (_blocks[i].memory == VK_NULL_HANDLE)
+        {
+            _blocks[i] = block;
+            return i;
+        }
+    }
+    _blocks.push_back(block);
+    return static_cast<uint32_t>(_blocks.size() - 1);
+}
+
+void Memory::Allocator::releaseEmptyBlocks(uint32_t memoryType, bool linear)
+{
+    // Keep one empty block per pool around so a free/allocate pattern at a block boundary doesn't thrash vkAllocateMemory.
+    bool keptOne = false;
+    for (Block &block : _blocks)
+    {
+        if (block.memory == VK_NULL_HANDLE || block.memoryType != memoryType || block.linear != linear || block.allocationCount > 0)
+        {
+            continue;
+        }
+        if (!keptOne)
+        {
+            keptOne = true;
+            continue;
+        }
+        vkFreeMemory(_logicalDevice, block.memory, nullptr);
+        block = {};
+    }
+}
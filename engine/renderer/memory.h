@@ -0,0 +1,110 @@
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <mutex>
+#include <cstdint>
+
+namespace Memory
+{
+// A sub-range of a larger VkDeviceMemory block. Resources are bound at `offset` instead of 0,
+// so many buffers/images share one driver allocation (drivers only guarantee maxMemoryAllocationCount >= 4096).
+struct Allocation
+{
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    // Host visible blocks stay mapped for their whole lifetime, this already points at `offset`.
+    void *mapped = nullptr;
+    uint32_t memoryType = 0;
+    uint32_t blockIndex = 0;
+    bool dedicated = false;
+};
+
+struct Buffer
+{
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceSize size = 0;
+    Allocation allocation;
+};
+
+struct Image
+{
+    VkImage image = VK_NULL_HANDLE;
+    Allocation allocation;
+};
+
+struct AllocatorStats
+{
+    uint32_t deviceMemoryCount = 0; // Live vkAllocateMemory calls (blocks + dedicated)
+    uint32_t allocationCount = 0;   // Live sub-allocations handed out
+    VkDeviceSize bytesReserved = 0; // Total device memory owned by the allocator
+    VkDeviceSize bytesUsed = 0;     // Bytes handed out to resources, alignment padding stays free and isn't counted
+    VkDeviceSize largestFreeRange = 0;
+    // 0 means all free space is one contiguous range, close to 1 means free space is scattered into small holes.
+    float fragmentation = 0.0f;
+};
+
+// Block based sub-allocator. One set of large blocks per (memory type, linear/optimal) pair,
+// each block keeps a free list sorted by offset that is coalesced on free.
+// Linear (buffers, linear images) and optimal (tiled images) resources never share a block, which sidesteps bufferImageGranularity.
+// https://developer.nvidia.com/vulkan-memory-management
+class Allocator
+{
+  public:
+    void Init(VkPhysicalDevice physicalDevice, VkDevice logicalDevice);
+    void Cleanup();
+
+    Allocation Allocate(const VkMemoryRequirements &requirements, VkMemoryPropertyFlags properties, bool linear);
+    void Free(Allocation &allocation);
+
+    // Buffers belong to one queue family at a time unless sharedQueueFamilies lists two or more, then every listed family
+    // may use them without ownership transfers (VK_SHARING_MODE_CONCURRENT), at some cost to access speed on some GPUs.
+    Buffer CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, const std::vector<uint32_t> &sharedQueueFamilies = {});
+    void DestroyBuffer(Buffer &buffer);
+    Image CreateImage(const VkImageCreateInfo &createInfo, VkMemoryPropertyFlags properties);
+    void DestroyImage(Image &image);
+
+    AllocatorStats GetStats();
+    void PrintStats();
+
+  private:
+    // Default size of a block, smaller heaps (integrated GPUs / BAR memory) get heapSize / 8.
+    const VkDeviceSize DEFAULT_BLOCK_SIZE = 64 * 1024 * 1024;
+
+    struct FreeRange
+    {
+        VkDeviceSize offset;
+        VkDeviceSize size;
+    };
+
+    struct Block
+    {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize size = 0;
+        void *mapped = nullptr;
+        uint32_t memoryType = 0;
+        bool linear = true;
+        uint32_t allocationCount = 0;
+        std::vector<FreeRange> freeRanges;
+    };
+
+    VkPhysicalDevice _physicalDevice = VK_NULL_HANDLE;
+    VkDevice _logicalDevice = VK_NULL_HANDLE;
+    VkPhysicalDeviceMemoryProperties _memoryProperties = {};
+    std::vector<Block> _blocks;
+    uint32_t _dedicatedCount = 0;
+    VkDeviceSize _dedicatedBytes = 0;
+    std::mutex _mutex;
+
+    VkDeviceSize blockSizeForType(uint32_t memoryType);
+    VkDeviceMemory allocateDeviceMemory(VkDeviceSize size, uint32_t memoryType, void **mapped);
+    bool allocateFromBlock(Block &block, const VkMemoryRequirements &requirements, VkDeviceSize *offset);
+    uint32_t createBlock(uint32_t memoryType, bool linear);
+    void releaseEmptyBlocks(uint32_t memoryType, bool linear);
+};
+
+} // namespace Memory
+
+#endif
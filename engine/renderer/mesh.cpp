@@ -0,0 +1,252 @@
+#include <vulkan/vulkan.h>
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+
+#include "mesh.h"
+
+namespace
+{
+    // The layout files have to be written with, known at compile time.
+    constexpr uint32_t VERTEX_LAYOUT = VertexFormat::LayoutHash<Vertex::Vertex>();
+
+    uint64_t alignUp(uint64_t value, uint64_t alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    template <typename Index>
+    bool indicesInRange(const void *indices, uint32_t indexCount, uint32_t vertexCount)
+    {
+        const Index *typed = static_cast<const Index *>(indices);
+        return std::all_of(typed, typed + indexCount, [vertexCount](Index index) { return index < vertexCount; });
+    }
+}
+
+MeshFile::View MeshFile::Parse(const FileIOSystem::Span &file)
+{
+    if (file.size < sizeof(MeshFormat::MeshHeader))
+    {
+        throw std::runtime_error("Mesh file is too small for its header.");
+    }
+    MeshFormat::MeshHeader header;
+    std::memcpy(&header, file.data, sizeof(header));
+    if (std::memcmp(header.magic, MeshFormat::MAGIC, sizeof(header.magic)) != 0 || header.version != MeshFormat::VERSION)
+    {
+        throw std::runtime_error("Not a mesh file, or one from a different version.");
+    }
+    if (header.vertexStride != sizeof(Vertex::Vertex) || header.vertexLayout != VERTEX_LAYOUT)
+    {
+        throw std::runtime_error("Mesh file was written with a different vertex layout, bake it again.");
+    }
+    if (header.indexSize != 2 && header.indexSize != 4)
+    {
+        throw std::runtime_error("Mesh file has an index size other than 2 or 4.");
+    }
+    if (header.indexCount % 3 != 0)
+    {
+        throw std::runtime_error("Mesh file doesn't have three indices per triangle.");
+    }
+    uint64_t vertexBytes = static_cast<uint64_t>(header.vertexCount) * header.vertexStride;
+    uint64_t indexBytes = static_cast<uint64_t>(header.indexCount) * header.indexSize;
+    if (header.vertexOffset % MeshFormat::DATA_ALIGNMENT != 0 || header.vertexOffset > file.size || vertexBytes > file.size - header.vertexOffset ||
+        header.indexOffset % MeshFormat::DATA_ALIGNMENT != 0 || header.indexOffset > file.size || indexBytes > file.size - header.indexOffset)
+    {
+        throw std::runtime_error("Mesh file data runs past the end of the file.");
+    }
+    // Mappings are page aligned and archive blobs 16 byte aligned, so this only fails for views that were copied oddly.
+    if (reinterpret_cast<uintptr_t>(file.data) % MeshFormat::DATA_ALIGNMENT != 0)
+    {
+        throw std::runtime_error("Mesh file bytes aren't aligned well enough to be read in place.");
+    }
+
+    View view;
+    view.vertexCount = header.vertexCount;
+    view.indexCount = header.indexCount;
+    view.indexSize = header.indexSize;
+    view.vertices = reinterpret_cast<const Vertex::Vertex *>(file.data + header.vertexOffset);
+    view.indices = file.data + header.indexOffset;
+    // An index past the vertices reads whatever follows in the shared buffer, or worse without robust buffer access.
+    bool inRange = view.indexSize == 2 ? indicesInRange<uint16_t>(view.indices, view.indexCount, view.vertexCount) : indicesInRange<uint32_t>(view.indices, view.indexCount, view.vertexCount);
+    if (!inRange)
+    {
+        throw std::runtime_error("Mesh file has an index past its last vertex.");
+    }
+    return view;
+}
+
+void MeshFile::Write(const std::string &path, const MeshOptimizer::IndexedMesh &mesh)
+{
+    MeshFormat::MeshHeader header = {};
+    std::memcpy(header.magic, MeshFormat::MAGIC, sizeof(header.magic));
+    header.version = MeshFormat::VERSION;
+    header.vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+    header.indexCount = static_cast<uint32_t>(mesh.indices.size());
+    header.vertexStride = sizeof(Vertex::Vertex);
+    header.vertexLayout = VERTEX_LAYOUT;
+    header.indexSize = MeshOptimizer::IndexSize(mesh.vertices.size());
+    header.vertexOffset = alignUp(sizeof(header), MeshFormat::DATA_ALIGNMENT);
+    header.indexOffset = alignUp(header.vertexOffset + mesh.vertices.size() * sizeof(Vertex::Vertex), MeshFormat::DATA_ALIGNMENT);
+
+    std::vector<uint16_t> shortIndices;
+    const void *indices = mesh.indices.data();
+    if (header.indexSize == 2)
+    {
+        shortIndices.assign(mesh.indices.begin(), mesh.indices.end());
+        indices = shortIndices.data();
+    }
+
+    // Written next to the target and renamed over it, so a failed write never leaves a truncated mesh behind.
+    FileIOSystem::WriteFile(path, [&](std::ostream &file) {
+        const char padding[MeshFormat::DATA_ALIGNMENT] = {};
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(padding, header.vertexOffset - sizeof(header));
+        file.write(reinterpret_cast<const char *>(mesh.vertices.data()), mesh.vertices.size() * sizeof(Vertex::Vertex));
+        file.write(padding, header.indexOffset - (header.vertexOffset + mesh.vertices.size() * sizeof(Vertex::Vertex)));
+        file.write(static_cast<const char *>(indices), static_cast<std::streamsize>(header.indexCount) * header.indexSize);
+    });
+}
+
+void MeshCache::Init(Memory::Allocator &allocator, Upload::Uploader &uploader, uint32_t blockVertices, VkDeviceSize blockIndexBytes)
+{
+    _allocator = &allocator;
+    _uploader = &uploader;
+    _blockVertices = blockVertices;
+    _blockIndexBytes = blockIndexBytes;
+}
+
+void MeshCache::Cleanup()
+{
+    for (Block &block : _blocks)
+    {
+        _allocator->DestroyBuffer(block.vertices);
+        _allocator->DestroyBuffer(block.indices);
+    }
+    _blocks.clear();
+    _meshes.clear();
+    _loaded.clear();
+}
+
+MeshCache::Handle MeshCache::Create(const MeshOptimizer::IndexedMesh &mesh)
+{
+    uint32_t indexSize = MeshOptimizer::IndexSize(mesh.vertices.size());
+    if (indexSize == 4)
+    {
+        return add(static_cast<uint32_t>(mesh.vertices.size()), mesh.vertices.data(), static_cast<uint32_t>(mesh.indices.size()), 4, mesh.indices.data());
+    }
+    std::vector<uint16_t> shortIndices(mesh.indices.begin(), mesh.indices.end());
+    return add(static_cast<uint32_t>(mesh.vertices.size()), mesh.vertices.data(), static_cast<uint32_t>(shortIndices.size()), 2, shortIndices.data());
+}
+
+MeshCache::Handle MeshCache::Create(const MeshFile::View &mesh)
+{
+    return add(mesh.vertexCount, mesh.vertices, mesh.indexCount, mesh.indexSize, mesh.indices);
+}
+
+MeshCache::Handle MeshCache::Load(const std::string &path)
+{
+    auto loaded = _loaded.find(path);
+    if (loaded != _loaded.end())
+    {
+        return loaded->second;
+    }
+    // The uploader copies into its ring right away, so the mapping only has to outlive this call.
+    return createFromFile(path, *FileIOSystem::OpenFile(path));
+}
+
+void MeshCache::LoadAsync(AssetLoader &loader, const std::string &path, std::function<void(Handle mesh)> loaded)
+{
+    auto found = _loaded.find(path);
+    if (found != _loaded.end())
+    {
+        loaded(found->second);
+        return;
+    }
+    MeshCache *cache = this;
+    loader.LoadFile(path, [cache, loaded](const AssetLoader::Result &result) {
+        // The loader has already said why.
+        if (result.failed)
+        {
+            return;
+        }
+        // Two loads of the same path can be in flight at once, the second one gets the first one's mesh.
+        auto found = cache->_loaded.find(result.path);
+        Handle handle;
+        if (found != cache->_loaded.end())
+        {
+            handle = found->second;
+        }
+        else
+        {
+            try
+            {
+                handle = cache->createFromFile(result.path, *result.file);
+            }
+            catch (const std::exception &e)
+            {
+                std::cout << "Failed to load " << result.path << ": " << e.what() << std::endl;
+                return;
+            }
+        }
+        loaded(handle);
+    });
+}
+
+MeshCache::Handle MeshCache::createFromFile(const std::string &path, const FileIOSystem::FileView &file)
+{
+    Handle handle = Create(MeshFile::Parse(file.GetSpan()));
+    _loaded.emplace(path, handle);
+    return handle;
+}
+
+MeshCache::Handle MeshCache::add(uint32_t vertexCount, const Vertex::Vertex *vertices, uint32_t indexCount, uint32_t indexSize, const void *indices)
+{
+    if (vertexCount == 0 || indexCount == 0)
+    {
+        throw std::runtime_error("Meshes need at least one triangle.");
+    }
+    VkDeviceSize indexBytes = static_cast<VkDeviceSize>(indexCount) * indexSize;
+    uint32_t blockIndex = findBlock(vertexCount, indexBytes, indexSize);
+    Block &block = _blocks[blockIndex];
+
+    // The index buffer is bound at offset 0 with the mesh's index type, so its indices have to start on a multiple of it.
+    VkDeviceSize indexOffset = alignUp(block.indexBytesUsed, indexSize);
+    Mesh mesh;
+    mesh.block = blockIndex;
+    mesh.baseVertex = static_cast<int32_t>(block.verticesUsed);
+    mesh.vertexCount = vertexCount;
+    mesh.firstIndex = static_cast<uint32_t>(indexOffset / indexSize);
+    mesh.indexCount = indexCount;
+    mesh.indexType = indexSize == 2 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+
+    _uploader->Enqueue(block.vertices.buffer, static_cast<VkDeviceSize>(block.verticesUsed) * sizeof(Vertex::Vertex), vertices, static_cast<VkDeviceSize>(vertexCount) * sizeof(Vertex::Vertex));
+    _uploader->Enqueue(block.indices.buffer, indexOffset, indices, indexBytes);
+    block.verticesUsed += vertexCount;
+    block.indexBytesUsed = indexOffset + indexBytes;
+
+    _meshes.push_back(mesh);
+    return static_cast<Handle>(_meshes.size() - 1);
+}
+
+// First fit, there are only ever a few blocks.
+uint32_t MeshCache::findBlock(uint32_t vertexCount, VkDeviceSize indexBytes, uint32_t indexSize)
+{
+    for (uint32_t i = 0; i < _blocks.size(); i++)
+    {
+        const Block &block = _blocks[i];
+        if (block.vertexCapacity - block.verticesUsed >= vertexCount && block.indices.size >= alignUp(block.indexBytesUsed, indexSize) + indexBytes)
+        {
+            return i;
+        }
+    }
+
+    Block block;
+    block.vertexCapacity = std::max(vertexCount, _blockVertices);
+    VkDeviceSize indexCapacity = std::max(indexBytes, _blockIndexBytes);
+    std::cout << "Creating mesh block " << _blocks.size() << " for " << block.vertexCapacity << " vertices and " << indexCapacity / 1024 << "KB of indices" << std::endl;
+    block.vertices = _allocator->CreateBuffer(static_cast<VkDeviceSize>(block.vertexCapacity) * sizeof(Vertex::Vertex), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    block.indices = _allocator->CreateBuffer(indexCapacity, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    _blocks.push_back(block);
+    return static_cast<uint32_t>(_blocks.size() - 1);
+}
@@ -0,0 +1,141 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <functional>
+#include <cstdint>
+
+#include "memory.h"
+#include "upload.h"
+#include "vertex.h"
+#include "meshoptimizer.h"
+#include "assetloader.h"
+#include "../systems/fileio.h"
+
+// A baked mesh, ready to be copied to the GPU straight out of its mapping (or the archive's). Written by MeshFile::Write.
+//
+//     MeshHeader
+//     vertices      vertexCount Vertex::Vertex, starting on a DATA_ALIGNMENT boundary
+//     indices       indexCount indices of indexSize bytes, starting on a DATA_ALIGNMENT boundary
+//
+// Vertices and indices are stored exactly as the GPU reads them, already deduplicated and optimized, so loading is
+// a bounds check and a copy into the staging ring. Everything is little endian.
+namespace MeshFormat
+{
+    const char MAGIC[4] = {'R', 'M', 'S', 'H'};
+    const uint32_t VERSION = 1;
+    // The same as the archive's blob alignment, so data inside a stored archive entry is still aligned.
+    const uint64_t DATA_ALIGNMENT = 16;
+
+    struct MeshHeader
+    {
+        char magic[4];
+        uint32_t version;
+        uint32_t vertexCount;
+        uint32_t indexCount;
+        uint32_t vertexStride;
+        // VertexFormat::LayoutHash of the layout the file was written with. Files from before a vertex layout
+        // change are rejected instead of drawn as garbage.
+        uint32_t vertexLayout;
+        uint32_t indexSize; // 2 or 4, see MeshOptimizer::IndexSize
+        uint32_t reserved;
+        uint64_t vertexOffset;
+        uint64_t indexOffset;
+    };
+
+    static_assert(sizeof(MeshHeader) == 48, "MeshHeader is read straight from the file");
+}
+
+namespace MeshFile
+{
+    // Points into the file's bytes, only valid while its view is alive.
+    struct View
+    {
+        uint32_t vertexCount = 0;
+        uint32_t indexCount = 0;
+        uint32_t indexSize = 0;
+        const Vertex::Vertex *vertices = nullptr;
+        const void *indices = nullptr;
+    };
+
+    // Checks the header, the vertex layout, that the data is inside the file and that every index is in range.
+    // Throws if any of that fails.
+    View Parse(const FileIOSystem::Span &file);
+    // Writes the mesh as it is, with 16 bit indices when it has few enough vertices. Run MeshOptimizer::Build first.
+    void Write(const std::string &path, const MeshOptimizer::IndexedMesh &mesh);
+}
+
+// Vertices and indices of every mesh, packed into a few big DEVICE_LOCAL buffers instead of a pair per mesh.
+// Meshes in the same block share their buffers, so drawing many of them binds those once and each draw only moves
+// firstIndex and baseVertex. Indices stay relative to their mesh's first vertex, which keeps most meshes at 16 bits
+// per index no matter how full the block's vertex buffer gets.
+// Meshes live as long as the cache, there is no removing one.
+// https://docs.vulkan.org/spec/latest/chapters/drawing.html#vkCmdDrawIndexed
+class MeshCache
+{
+  public:
+    using Handle = uint32_t;
+
+    struct Mesh
+    {
+        uint32_t block;       // See GetVertexBuffer and GetIndexBuffer
+        int32_t baseVertex;   // Added to every index before fetching the vertex
+        uint32_t vertexCount;
+        uint32_t firstIndex;  // In indexType units from the start of the block's index buffer
+        uint32_t indexCount;
+        VkIndexType indexType;
+    };
+
+    // Blocks hold this many vertices and index bytes, meshes too big for that get a block of their own.
+    static constexpr uint32_t DEFAULT_BLOCK_VERTICES = 64 * 1024;
+    static constexpr VkDeviceSize DEFAULT_BLOCK_INDEX_BYTES = 1024 * 1024;
+
+    void Init(Memory::Allocator &allocator, Upload::Uploader &uploader, uint32_t blockVertices = DEFAULT_BLOCK_VERTICES, VkDeviceSize blockIndexBytes = DEFAULT_BLOCK_INDEX_BYTES);
+    // Frames in flight may still draw the meshes, call it once the device is idle.
+    void Cleanup();
+
+    // Queues the mesh on the uploader, it can be drawn once its next Flush() has executed. DrawFrame flushes ahead
+    // of the frame's draws, so a mesh can be drawn in the frame it was created in.
+    Handle Create(const MeshOptimizer::IndexedMesh &mesh);
+    Handle Create(const MeshFile::View &mesh);
+    // Maps the file through FileIOSystem::OpenFile, so a mesh in a mounted archive loads the same way, and copies it
+    // from the mapping straight into the staging ring. Loading a path again returns the mesh it was first loaded into.
+    Handle Load(const std::string &path);
+    // Load without the main thread waiting on the file: it is read on a worker through the loader, then parsed and
+    // queued on the uploader from the loader's Update. `loaded` runs there with the handle, or not at all if the file
+    // can't be read or isn't a valid mesh.
+    void LoadAsync(AssetLoader &loader, const std::string &path, std::function<void(Handle mesh)> loaded);
+
+    const Mesh &GetMesh(Handle mesh) const { return _meshes[mesh]; }
+    VkBuffer GetVertexBuffer(uint32_t block) const { return _blocks[block].vertices.buffer; }
+    VkBuffer GetIndexBuffer(uint32_t block) const { return _blocks[block].indices.buffer; }
+    uint32_t GetMeshCount() const { return static_cast<uint32_t>(_meshes.size()); }
+    uint32_t GetBlockCount() const { return static_cast<uint32_t>(_blocks.size()); }
+
+  private:
+    struct Block
+    {
+        Memory::Buffer vertices;
+        Memory::Buffer indices;
+        uint32_t vertexCapacity = 0;
+        uint32_t verticesUsed = 0;
+        VkDeviceSize indexBytesUsed = 0;
+    };
+
+    Memory::Allocator *_allocator = nullptr;
+    Upload::Uploader *_uploader = nullptr;
+    uint32_t _blockVertices = 0;
+    VkDeviceSize _blockIndexBytes = 0;
+    std::vector<Block> _blocks;
+    std::vector<Mesh> _meshes;
+    std::unordered_map<std::string, Handle> _loaded;
+
+    Handle createFromFile(const std::string &path, const FileIOSystem::FileView &file);
+    Handle add(uint32_t vertexCount, const Vertex::Vertex *vertices, uint32_t indexCount, uint32_t indexSize, const void *indices);
+    uint32_t findBlock(uint32_t vertexCount, VkDeviceSize indexBytes, uint32_t indexSize);
+};
+
+#endif
@@ -0,0 +1,402 @@
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "meshoptimizer.h"
+
+namespace
+{
+    // Tom Forsyth's tuned constants, see the paper linked in the header.
+    const float CACHE_DECAY_POWER = 1.5f;
+    const float LAST_TRIANGLE_SCORE = 0.75f;
+    const float VALENCE_BOOST_SCALE = 2.0f;
+    const float VALENCE_BOOST_POWER = 0.5f;
+
+    // Vertices in the cache score by how recently they were used, the three of the last triangle a fixed amount less
+    // so the next triangle doesn't just reuse its edge forever. Vertices with few triangles left get a boost, so they
+    // are finished off instead of being left behind as a lone triangle that costs three misses later.
+    float vertexScore(int32_t cachePosition, uint32_t remainingTriangles, uint32_t cacheSize)
+    {
+        if (remainingTriangles == 0)
+        {
+            return -1.0f;
+        }
+        float score = 0.0f;
+        if (cachePosition >= 0)
+        {
+            if (cachePosition < 3)
+            {
+                score = LAST_TRIANGLE_SCORE;
+            }
+            else
+            {
+                score = std::pow(1.0f - static_cast<float>(cachePosition - 3) / static_cast<float>(cacheSize - 3), CACHE_DECAY_POWER);
+            }
+        }
+        return score + VALENCE_BOOST_SCALE * std::pow(static_cast<float>(remainingTriangles), -VALENCE_BOOST_POWER);
+    }
+
+    uint64_t hashVertex(const Vertex::Vertex &vertex)
+    {
+        const unsigned char *bytes = reinterpret_cast<const unsigned char *>(&vertex);
+        uint64_t hash = 14695981039346656037ull;
+        for (size_t i = 0; i < sizeof(Vertex::Vertex); i++)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    // A FIFO cache simulated with timestamps: a vertex is in the cache while fewer than cacheSize misses happened
+    // since it was last loaded. Advancing the clock by more than cacheSize empties it.
+    class FifoCache
+    {
+      public:
+        FifoCache(size_t vertexCount, uint32_t cacheSize) : _timestamps(vertexCount, 0), _cacheSize(cacheSize), _time(cacheSize + 1) {}
+
+        uint32_t Misses(const uint32_t *triangle)
+        {
+            uint32_t misses = 0;
+            for (uint32_t corner = 0; corner < 3; corner++)
+            {
+                if (_time - _timestamps[triangle[corner]] > _cacheSize)
+                {
+                    _timestamps[triangle[corner]] = _time++;
+                    misses++;
+                }
+            }
+            return misses;
+        }
+
+        void Clear() { _time += _cacheSize + 1; }
+
+      private:
+        std::vector<uint32_t> _timestamps;
+        uint32_t _cacheSize;
+        uint32_t _time;
+    };
+}
+
+MeshOptimizer::IndexedMesh MeshOptimizer::Deduplicate(const std::vector<Vertex::Vertex> &triangleList)
+{
+    if (triangleList.size() % 3 != 0)
+    {
+        throw std::runtime_error("A triangle list needs three vertices per triangle.");
+    }
+
+    // Open addressing with linear probing, kept at most half full. Slots hold an index into mesh.vertices.
+    size_t tableSize = 16;
+    while (tableSize < triangleList.size() * 2)
+    {
+        tableSize *= 2;
+    }
+    std::vector<uint32_t> table(tableSize, UINT32_MAX);
+
+    IndexedMesh mesh;
+    mesh.indices.reserve(triangleList.size());
+    for (const Vertex::Vertex &vertex : triangleList)
+    {
+        size_t slot = hashVertex(vertex) & (tableSize - 1);
+        while (table[slot] != UINT32_MAX && std::memcmp(&mesh.vertices[table[slot]], &vertex, sizeof(Vertex::Vertex)) != 0)
+        {
+            slot = (slot + 1) & (tableSize - 1);
+        }
+        if (table[slot] == UINT32_MAX)
+        {
+            table[slot] = static_cast<uint32_t>(mesh.vertices.size());
+            mesh.vertices.push_back(vertex);
+        }
+        mesh.indices.push_back(table[slot]);
+    }
+    return mesh;
+}
+
+void MeshOptimizer::OptimizeVertexCache(std::vector<uint32_t> &indices, size_t vertexCount, uint32_t cacheSize)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+    {
+        return;
+    }
+    cacheSize = std::max<uint32_t>(cacheSize, 4);
+
+    // Triangles of each vertex, vertex v's are adjacency[firstTriangle[v]] onwards. The ones not emitted yet are kept
+    // at the front, so remaining[v] of them are live.
+    std::vector<uint32_t> remaining(vertexCount, 0);
+    for (uint32_t index : indices)
+    {
+        remaining[index]++;
+    }
+    std::vector<uint32_t> firstTriangle(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++)
+    {
+        firstTriangle[v + 1] = firstTriangle[v] + remaining[v];
+    }
+    std::vector<uint32_t> adjacency(indices.size());
+    std::vector<uint32_t> filled(vertexCount, 0);
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        adjacency[firstTriangle[indices[i]] + filled[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+
+    std::vector<int32_t> cachePosition(vertexCount, -1);
+    std::vector<float> scores(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+    {
+        scores[v] = vertexScore(-1, remaining[v], cacheSize);
+    }
+    std::vector<float> triangleScores(triangleCount, 0.0f);
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        triangleScores[i / 3] += scores[indices[i]];
+    }
+
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> cache;
+    std::vector<uint32_t> nextCache;
+    cache.reserve(cacheSize + 3);
+    nextCache.reserve(cacheSize + 3);
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+    size_t scanCursor = 0;
+    int64_t best = 0;
+
+    while (result.size() < indices.size())
+    {
+        if (best < 0)
+        {
+            // Nothing in the cache touches a triangle that is left, so the next one starts from scratch anyway.
+            while (emitted[scanCursor])
+            {
+                scanCursor++;
+            }
+            best = static_cast<int64_t>(scanCursor);
+        }
+
+        const uint32_t *triangle = &indices[best * 3];
+        emitted[best] = true;
+        nextCache.clear();
+        for (uint32_t corner = 0; corner < 3; corner++)
+        {
+            uint32_t v = triangle[corner];
+            result.push_back(v);
+            uint32_t *live = &adjacency[firstTriangle[v]];
+            *std::find(live, live + remaining[v], static_cast<uint32_t>(best)) = live[remaining[v] - 1];
+            remaining[v]--;
+            if (std::find(nextCache.begin(), nextCache.end(), v) == nextCache.end())
+            {
+                nextCache.push_back(v);
+            }
+        }
+
+        // LRU: the triangle's vertices move to the front, the rest shift back and the last ones fall out.
+        for (uint32_t v : cache)
+        {
+            if (std::find(nextCache.begin(), nextCache.end(), v) == nextCache.end())
+            {
+                nextCache.push_back(v);
+            }
+        }
+        for (size_t i = 0; i < nextCache.size(); i++)
+        {
+            uint32_t v = nextCache[i];
+            cachePosition[v] = i < cacheSize ? static_cast<int32_t>(i) : -1;
+            float score = vertexScore(cachePosition[v], remaining[v], cacheSize);
+            float delta = score - scores[v];
+            scores[v] = score;
+            for (uint32_t t = 0; t < remaining[v]; t++)
+            {
+                triangleScores[adjacency[firstTriangle[v] + t]] += delta;
+            }
+        }
+        nextCache.resize(std::min<size_t>(nextCache.size(), cacheSize));
+        std::swap(cache, nextCache);
+
+        // Only triangles touching the cache changed score, the best one is among them or it doesn't matter.
+        best = -1;
+        float bestScore = -1.0f;
+        for (uint32_t v : cache)
+        {
+            for (uint32_t t = 0; t < remaining[v]; t++)
+            {
+                uint32_t candidate = adjacency[firstTriangle[v] + t];
+                if (triangleScores[candidate] > bestScore)
+                {
+                    bestScore = triangleScores[candidate];
+                    best = candidate;
+                }
+            }
+        }
+    }
+    indices.swap(result);
+}
+
+void MeshOptimizer::OptimizeOverdraw(std::vector<uint32_t> &indices, const std::vector<glm::vec3> &positions, float threshold, uint32_t cacheSize)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+    {
+        return;
+    }
+
+    // Hard boundaries, where all three vertices miss: nothing is reused across them, so cutting there costs nothing.
+    // The first cluster always starts at triangle 0, even when that one is degenerate and misses fewer than three.
+    FifoCache cache(positions.size(), cacheSize);
+    std::vector<size_t> hardBoundaries = {0};
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        if (cache.Misses(&indices[t * 3]) == 3 && t != 0)
+        {
+            hardBoundaries.push_back(t);
+        }
+    }
+    hardBoundaries.push_back(triangleCount);
+
+    // Soft boundaries inside those, wherever the part so far is already about as cache friendly as the whole cluster.
+    // Every part starts with an empty cache, which is what happens to it once the clusters are shuffled.
+    std::vector<size_t> clusters;
+    for (size_t h = 0; h + 1 < hardBoundaries.size(); h++)
+    {
+        size_t begin = hardBoundaries[h];
+        size_t end = hardBoundaries[h + 1];
+        cache.Clear();
+        uint32_t clusterMisses = 0;
+        for (size_t t = begin; t < end; t++)
+        {
+            clusterMisses += cache.Misses(&indices[t * 3]);
+        }
+        float limit = threshold * static_cast<float>(clusterMisses) / static_cast<float>(end - begin);
+
+        cache.Clear();
+        size_t start = begin;
+        uint32_t misses = 0;
+        for (size_t t = begin; t < end; t++)
+        {
+            misses += cache.Misses(&indices[t * 3]);
+            if (t + 1 < end && static_cast<float>(misses) <= limit * static_cast<float>(t - start + 1))
+            {
+                clusters.push_back(start);
+                start = t + 1;
+                misses = 0;
+                cache.Clear();
+            }
+        }
+        clusters.push_back(start);
+    }
+    clusters.push_back(triangleCount);
+
+    // Area weighted, so a few slivers don't pull the center around.
+    auto accumulate = [&](size_t begin, size_t end, glm::vec3 &centroid, glm::vec3 &normal) {
+        float area = 0.0f;
+        for (size_t t = begin; t < end; t++)
+        {
+            const glm::vec3 &a = positions[indices[t * 3]];
+            const glm::vec3 &b = positions[indices[t * 3 + 1]];
+            const glm::vec3 &c = positions[indices[t * 3 + 2]];
+            glm::vec3 cross = glm::cross(b - a, c - a);
+            float triangleArea = glm::length(cross);
+            centroid += (a + b + c) * (triangleArea / 3.0f);
+            normal += cross;
+            area += triangleArea;
+        }
+        if (area > 0.0f)
+        {
+            centroid /= area;
+        }
+    };
+    glm::vec3 meshCentroid(0.0f);
+    glm::vec3 meshNormal(0.0f);
+    accumulate(0, triangleCount, meshCentroid, meshNormal);
+
+    struct Cluster
+    {
+        size_t begin;
+        size_t end;
+        float key;
+    };
+    std::vector<Cluster> sorted;
+    for (size_t c = 0; c + 1 < clusters.size(); c++)
+    {
+        glm::vec3 centroid(0.0f);
+        glm::vec3 normal(0.0f);
+        accumulate(clusters[c], clusters[c + 1], centroid, normal);
+        float length = glm::length(normal);
+        float key = length > 0.0f ? glm::dot(centroid - meshCentroid, normal / length) : 0.0f;
+        sorted.push_back({clusters[c], clusters[c + 1], key});
+    }
+    // Stable, so equal keys (every cluster of a flat mesh) keep the cache optimized order.
+    std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster &a, const Cluster &b) { return a.key > b.key; });
+
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+    for (const Cluster &cluster : sorted)
+    {
+        result.insert(result.end(), indices.begin() + cluster.begin * 3, indices.begin() + cluster.end * 3);
+    }
+    // Clusters only reorder triangles, losing any would be a bug in the boundaries above.
+    if (result.size() != triangleCount * 3)
+    {
+        throw std::logic_error("OptimizeOverdraw clusters don't cover every triangle.");
+    }
+    indices.swap(result);
+}
+
+void MeshOptimizer::OptimizeVertexFetch(IndexedMesh &mesh)
+{
+    std::vector<uint32_t> remap(mesh.vertices.size(), UINT32_MAX);
+    std::vector<Vertex::Vertex> vertices;
+    vertices.reserve(mesh.vertices.size());
+    for (uint32_t &index : mesh.indices)
+    {
+        if (remap[index] == UINT32_MAX)
+        {
+            remap[index] = static_cast<uint32_t>(vertices.size());
+            vertices.push_back(mesh.vertices[index]);
+        }
+        index = remap[index];
+    }
+    mesh.vertices.swap(vertices);
+}
+
+MeshOptimizer::IndexedMesh MeshOptimizer::Build(const std::vector<Vertex::Vertex> &triangleList)
+{
+    IndexedMesh mesh = Deduplicate(triangleList);
+    float missRatio = AverageCacheMissRatio(mesh.indices, mesh.vertices.size());
+    OptimizeVertexCache(mesh.indices, mesh.vertices.size());
+    OptimizeOverdraw(mesh.indices, Positions(mesh.vertices));
+    OptimizeVertexFetch(mesh);
+    std::cout << "Built mesh of " << mesh.indices.size() / 3 << " triangles, " << triangleList.size() << " vertices deduplicated to "
+              << mesh.vertices.size() << ", cache miss ratio " << missRatio << " -> " << AverageCacheMissRatio(mesh.indices, mesh.vertices.size()) << std::endl;
+    return mesh;
+}
+
+float MeshOptimizer::AverageCacheMissRatio(const std::vector<uint32_t> &indices, size_t vertexCount, uint32_t cacheSize)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+    {
+        return 0.0f;
+    }
+    FifoCache cache(vertexCount, cacheSize);
+    uint32_t misses = 0;
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        misses += cache.Misses(&indices[t * 3]);
+    }
+    return static_cast<float>(misses) / static_cast<float>(triangleCount);
+}
+
+std::vector<glm::vec3> MeshOptimizer::Positions(const std::vector<Vertex::Vertex> &vertices)
+{
+    // The same mapping R16G16_SNORM vertex fetch does. The engine is 2D, so z is 0 throughout.
+    std::vector<glm::vec3> positions;
+    positions.reserve(vertices.size());
+    for (const Vertex::Vertex &vertex : vertices)
+    {
+        positions.emplace_back(std::max(vertex.pos.x / 32767.0f, -1.0f), std::max(vertex.pos.y / 32767.0f, -1.0f), 0.0f);
+    }
+    return positions;
+}
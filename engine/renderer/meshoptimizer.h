@@ -0,0 +1,59 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+
+#include "vertex.h"
+
+// Turns a plain triangle list into an indexed mesh that is cheap to draw. Everything here runs on the CPU and touches
+// no Vulkan object, so it can run on a worker or at bake time (see MeshFile::Write) just as well.
+//
+//     Deduplicate           every distinct vertex once, triangles as indices into them
+//     OptimizeVertexCache   triangles ordered so vertices are reused while still in the post-transform cache
+//     OptimizeOverdraw      clusters of that order sorted so outward facing ones are drawn first
+//     OptimizeVertexFetch   vertices ordered by first use, so fetching them walks memory front to back
+//
+// https://tomforsyth1000.github.io/papers/fast_vert_cache_opt.html
+// https://gfx.cs.princeton.edu/pubs/Sander_2007_%3ETR/tipsy.pdf
+namespace MeshOptimizer
+{
+    // Roughly what the post-transform cache holds on current GPUs. Orders built for it degrade gracefully on smaller ones.
+    const uint32_t VERTEX_CACHE_SIZE = 32;
+    // How much worse than the cache optimized order a cluster may get for overdraw's sake, 1.05 is 5%.
+    const float OVERDRAW_THRESHOLD = 1.05f;
+
+    struct IndexedMesh
+    {
+        std::vector<Vertex::Vertex> vertices;
+        std::vector<uint32_t> indices; // Three per triangle, each below vertices.size()
+    };
+
+    // Bytes per index the mesh needs: 2 while every index fits in 16 bits, which halves index fetch, 4 otherwise.
+    inline uint32_t IndexSize(size_t vertexCount) { return vertexCount <= 65536 ? 2 : 4; }
+
+    // Vertices are compared by their bytes, which VertexFormat::Layout guarantees are all attribute data, no padding.
+    // The first occurrence of a vertex keeps its place, so the result is deterministic.
+    IndexedMesh Deduplicate(const std::vector<Vertex::Vertex> &triangleList);
+    // Reorders triangles in place, with Tom Forsyth's linear-speed algorithm for an LRU cache of cacheSize entries.
+    void OptimizeVertexCache(std::vector<uint32_t> &indices, size_t vertexCount, uint32_t cacheSize = VERTEX_CACHE_SIZE);
+    // Splits the current order into clusters wherever the cache starts over (and further, as long as each part stays
+    // within threshold of its cluster's cache efficiency), then sorts the clusters by how far they face away from the
+    // mesh's center. With a depth test, the front most surfaces then tend to be drawn first and hide what's behind them.
+    // Flat meshes have nothing to sort and keep their order. Run it after OptimizeVertexCache.
+    void OptimizeOverdraw(std::vector<uint32_t> &indices, const std::vector<glm::vec3> &positions, float threshold = OVERDRAW_THRESHOLD, uint32_t cacheSize = VERTEX_CACHE_SIZE);
+    // Reorders the vertices in the order the indices first use them and rewrites the indices to match.
+    // Vertices no triangle uses are dropped.
+    void OptimizeVertexFetch(IndexedMesh &mesh);
+    // All of the above, in order. Logs the cache miss ratio before and after.
+    IndexedMesh Build(const std::vector<Vertex::Vertex> &triangleList);
+
+    // Average vertex shader invocations per triangle through a FIFO cache of cacheSize, between 0.5 (ideal) and 3.
+    // https://www.khronos.org/opengl/wiki/Post_Transform_Cache
+    float AverageCacheMissRatio(const std::vector<uint32_t> &indices, size_t vertexCount, uint32_t cacheSize = VERTEX_CACHE_SIZE);
+    // Where each vertex ends up, for OptimizeOverdraw.
+    std::vector<glm::vec3> Positions(const std::vector<Vertex::Vertex> &vertices);
+}
+
+#endif
@@ -1,12 +1,42 @@
 #include <vulkan/vulkan.h>
 #include <SDL2/SDL.h>
 #include <iostream>
+#include <stdexcept>
+#include <algorithm>
+#include <cstddef>
 
 #include "pipeline.h"
 #include "../systems/fileio.h"
 #include "vertex.h"
+#include "shaderreflection.h"
 
-Pipeline::ConstructedPipeline Pipeline::CreateGraphicsPipeline(const VkDevice &logicalDevice, const VkExtent2D &extent, const VkFormat &format)
+Pipeline::ConstructedPipeline Pipeline::CreateGraphicsPipeline(const VkDevice &logicalDevice, const VkFormat &format, const VkPipelineCache &pipelineCache, VkImageLayout finalLayout)
+{
+    PipelineDescription description;
+    description.vertexShaderPath = "./assets/shaders/vert.spv";
+    description.fragmentShaderPath = "./assets/shaders/frag.spv";
+
+    // The demo pipeline owns the render pass every other pipeline draws in.
+    VkRenderPass renderPass = Pipeline::CreateRenderPass(logicalDevice, format, finalLayout);
+    Pipeline::ConstructedPipeline constructedPipeline = Pipeline::CreatePipeline(logicalDevice, renderPass, pipelineCache, description);
+    constructedPipeline.renderPass = renderPass;
+    return constructedPipeline;
+}
+
+Pipeline::PipelineDescription Pipeline::SpritePipelineDescription()
+{
+    PipelineDescription description;
+    description.vertexShaderPath = "./assets/shaders/sprite.vert.spv";
+    description.fragmentShaderPath = "./assets/shaders/sprite.frag.spv";
+    description.instanced = true;
+    description.alphaBlend = true;
+    // Flat quads facing the camera, there is nothing to cull and no reason to care about winding.
+    description.cullMode = VK_CULL_MODE_NONE;
+    // The camera push constants and the texture set are reflected from the shaders when the description is registered.
+    return description;
+}
+
+Pipeline::ConstructedPipeline Pipeline::CreatePipeline(const VkDevice &logicalDevice, const VkRenderPass &renderPass, const VkPipelineCache &pipelineCache, const PipelineDescription &description)
 {
     // Pipeline Steps:
     // 1. Shader Modules -- Programmable Shaders
@@ -20,71 +50,106 @@ Pipeline::ConstructedPipeline Pipeline::CreateGraphicsPipeline(const VkDevice &l
     // 9. Color Blending -- Color blending.
     // 10. Dynamic State -- Handling dynamic structs in pipeline (like viewport)
     // 11. Pipeline Layout -- uniform values need to be specified during pipeline creation by creating a VkPipelineLayout object
-    // 12. Render Pass --  how many color and depth buffers there will be, how many samples to use for each of them and how their contents should be handled throughout the rendering operations.
+    // 12. Render Pass (created by the caller) --  how many color and depth buffers there will be, how many samples to use for each of them and how their contents should be handled throughout the rendering operations.
     // 13. Pipeline Construction -- putting it all together
-    Pipeline::ConstructedPipeline constructedPipeline;
+    Pipeline::ConstructedPipeline constructedPipeline = {};
 
     // 1 Shader Modules
-    std::vector<char> vertShaderData = FileIOSystem::ReadFileToVector("./assets/shaders/vert.spv");
-    std::vector<char> fragShaderData = FileIOSystem::ReadFileToVector("./assets/shaders/frag.spv");
+    // Mapped and cached, so rebuilding a pipeline doesn't read or copy its shaders again.
+    std::shared_ptr<const FileIOSystem::FileView> vertShaderData = FileIOSystem::OpenFile(description.vertexShaderPath);
+    std::shared_ptr<const FileIOSystem::FileView> fragShaderData = FileIOSystem::OpenFile(description.fragmentShaderPath);
+
+    // Checked before any Vulkan object exists, so a mismatch has nothing to clean up.
+    // Both bindings come from the compile time layouts in vertex.h, which also know the packed formats.
+    // Instanced pipelines read a second binding once per instance, its attributes follow the per-vertex ones.
+    std::vector<VkVertexInputBindingDescription> vertexBindings = {Vertex::VERTEX_BINDING_DESCRIPTION};
+    std::vector<VkVertexInputAttributeDescription> vertexAttributes(Vertex::VERTEX_ATTRIBUTES.begin(), Vertex::VERTEX_ATTRIBUTES.end());
+    if (description.instanced)
+    {
+        vertexBindings.push_back(Vertex::INSTANCE_BINDING_DESCRIPTION);
+        vertexAttributes.insert(vertexAttributes.end(), Vertex::INSTANCE_ATTRIBUTES.begin(), Vertex::INSTANCE_ATTRIBUTES.end());
+    }
+    // An input the shader reads but no attribute provides is undefined behaviour, reflection turns it into an error.
+    for (const ShaderReflection::VertexInput &input : ShaderReflection::Reflect(vertShaderData->GetSpan())->inputs)
+    {
+        bool provided = std::any_of(vertexAttributes.begin(), vertexAttributes.end(), [&input](const VkVertexInputAttributeDescription &attribute) { return attribute.location == input.location; });
+        if (!provided)
+        {
+            throw std::runtime_error(description.vertexShaderPath + " reads vertex input " + input.name + " at location " + std::to_string(input.location) + ", which no vertex layout provides.");
+        }
+    }
 
-    VkShaderModule vertShader = Pipeline::CreateShaderModule(logicalDevice, vertShaderData);
-    VkShaderModule fragShader = Pipeline::CreateShaderModule(logicalDevice, fragShaderData);
+    // The modules are only needed until the pipeline exists. Destroyed on the way out, whether that is a return or a throw.
+    struct ShaderModules
+    {
+        VkDevice device;
+        VkShaderModule vertex = VK_NULL_HANDLE;
+        VkShaderModule fragment = VK_NULL_HANDLE;
+        ~ShaderModules()
+        {
+            vkDestroyShaderModule(device, vertex, nullptr);
+            vkDestroyShaderModule(device, fragment, nullptr);
+        }
+    } shaderModules = {logicalDevice};
+    shaderModules.vertex = Pipeline::CreateShaderModule(logicalDevice, vertShaderData->GetSpan());
+    shaderModules.fragment = Pipeline::CreateShaderModule(logicalDevice, fragShaderData->GetSpan());
+
+    // Both stages get the same constants, an id a stage doesn't declare is ignored by it.
+    std::vector<VkSpecializationMapEntry> specializationEntries;
+    for (size_t i = 0; i < description.specializationConstants.size(); i++)
+    {
+        specializationEntries.push_back({description.specializationConstants[i].id, static_cast<uint32_t>(i * sizeof(SpecializationConstant) + offsetof(SpecializationConstant, value)), sizeof(uint32_t)});
+    }
+    VkSpecializationInfo specializationInfo = {};
+    specializationInfo.mapEntryCount = static_cast<uint32_t>(specializationEntries.size());
+    specializationInfo.pMapEntries = specializationEntries.data();
+    specializationInfo.dataSize = description.specializationConstants.size() * sizeof(SpecializationConstant);
+    specializationInfo.pData = description.specializationConstants.data();
+    const VkSpecializationInfo *specialization = specializationEntries.empty() ? nullptr : &specializationInfo;
 
     VkPipelineShaderStageCreateInfo vertCreateInfo = {};
     vertCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     vertCreateInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-    vertCreateInfo.module = vertShader;
+    vertCreateInfo.module = shaderModules.vertex;
     vertCreateInfo.pName = "main";
+    vertCreateInfo.pSpecializationInfo = specialization;
 
     VkPipelineShaderStageCreateInfo fragCreateInfo = {};
     fragCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     fragCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-    fragCreateInfo.module = fragShader;
+    fragCreateInfo.module = shaderModules.fragment;
     fragCreateInfo.pName = "main";
+    fragCreateInfo.pSpecializationInfo = specialization;
 
     // 2 Pipeline Shader Stage
     VkPipelineShaderStageCreateInfo pipelineShaderSteps[] = {vertCreateInfo, fragCreateInfo};
 
     // 3 Vertex Input
-    VkVertexInputBindingDescription vertexDescription = Vertex::CreateBindingDescription();
-    std::array<VkVertexInputAttributeDescription, Vertex::VERTEX_PROPERTIES_COUNT> vertexAttributes = Vertex::CreateAttributeDescriptions();
-
+    // The bindings and attributes were put together and checked against the shader above.
     VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
     vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertexInputInfo.vertexBindingDescriptionCount = 1;
-    vertexInputInfo.pVertexBindingDescriptions = &vertexDescription;
+    vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(vertexBindings.size());
+    vertexInputInfo.pVertexBindingDescriptions = vertexBindings.data();
     vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(vertexAttributes.size());
     vertexInputInfo.pVertexAttributeDescriptions = vertexAttributes.data();
 
     // 4 Input Assembly
     VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
     inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    inputAssembly.topology = description.topology;
     inputAssembly.primitiveRestartEnable = VK_FALSE;
 
     // 5 Viewport / Scissor
-    // Now this viewport and scissor rectangle need to be combined into a viewport state using the VkPipelineViewportStateCreateInfo struct.
     // It is possible to use multiple viewports and scissor rectangles on some graphics cards, so its members reference an array of them.
     // Using multiple requires enabling a GPU feature (see logical device creation).
-    VkViewport viewport = {};
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = (float)extent.width;
-    viewport.height = (float)extent.height;
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-
-    VkRect2D scissor = {};
-    scissor.offset = {0, 0};
-    scissor.extent = extent;
-
+    // Both are dynamic state (step 10), so only the counts go in here and the actual rectangles are set while recording.
+    // That way a window resize doesn't invalidate the pipeline.
     VkPipelineViewportStateCreateInfo viewportState = {};
     viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
     viewportState.viewportCount = 1;
-    viewportState.pViewports = &viewport;
+    viewportState.pViewports = nullptr;
     viewportState.scissorCount = 1;
-    viewportState.pScissors = &scissor;
+    viewportState.pScissors = nullptr;
 
     // 6 Rasterizer
     VkPipelineRasterizationStateCreateInfo rasterizer = {};
@@ -93,7 +158,7 @@ Pipeline::ConstructedPipeline Pipeline::CreateGraphicsPipeline(const VkDevice &l
     rasterizer.rasterizerDiscardEnable = VK_FALSE;
     rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
     rasterizer.lineWidth = 1.0f;
-    rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
+    rasterizer.cullMode = description.cullMode;
     rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
     rasterizer.depthBiasEnable = VK_FALSE;
 
@@ -109,6 +174,17 @@ Pipeline::ConstructedPipeline Pipeline::CreateGraphicsPipeline(const VkDevice &l
     VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
     colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
     colorBlendAttachment.blendEnable = VK_FALSE;
+    if (description.alphaBlend)
+    {
+        // finalColor = srcAlpha * newColor + (1 - srcAlpha) * oldColor, alpha itself is kept from the new color.
+        colorBlendAttachment.blendEnable = VK_TRUE;
+        colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+        colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+        colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+        colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+        colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+        colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+    }
 
     VkPipelineColorBlendStateCreateInfo colorBlending = {};
     colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
@@ -116,12 +192,24 @@ Pipeline::ConstructedPipeline Pipeline::CreateGraphicsPipeline(const VkDevice &l
     colorBlending.attachmentCount = 1;
     colorBlending.pAttachments = &colorBlendAttachment;
 
-    // 10 Dynamic State - skipped
+    // 10 Dynamic State
+    // A limited amount of the state can be changed without recreating the pipeline, it then has to be specified at drawing time.
+    VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineDynamicStateCreateInfo dynamicState = {};
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = 2;
+    dynamicState.pDynamicStates = dynamicStates;
 
     // 11 Pipeline Layout
     VkPipelineLayout pipelineLayout;
     VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    // Push constants are the cheapest way to get a handful of bytes (like a camera) to the shaders, no buffer or descriptor needed.
+    pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(description.pushConstantRanges.size());
+    pipelineLayoutInfo.pPushConstantRanges = description.pushConstantRanges.data();
+    // Descriptor sets are for everything too big for push constants, like textures. The layouts belong to whoever made them.
+    pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(description.setLayouts.size());
+    pipelineLayoutInfo.pSetLayouts = description.setLayouts.data();
 
     if (vkCreatePipelineLayout(logicalDevice, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
     {
@@ -129,8 +217,7 @@ Pipeline::ConstructedPipeline Pipeline::CreateGraphicsPipeline(const VkDevice &l
     }
     constructedPipeline.layout = pipelineLayout;
 
-    // 12 Render Pass
-    constructedPipeline.renderPass = Pipeline::CreateRenderPass(logicalDevice, format);
+    // 12 Render Pass - passed in, so several pipelines can draw in the same one
 
     // 13 Pipeline Construction
     VkGraphicsPipelineCreateInfo pipelineCreateInfo = {};
@@ -151,29 +238,114 @@ Pipeline::ConstructedPipeline Pipeline::CreateGraphicsPipeline(const VkDevice &l
     // Depth and Stencil -- Skipped
     // Color Blending
     pipelineCreateInfo.pColorBlendState = &colorBlending;
-    // Dynamic State -- skipped
+    // Dynamic State
+    pipelineCreateInfo.pDynamicState = &dynamicState;
     // Pipeline Layout
     pipelineCreateInfo.layout = pipelineLayout;
     // Render Pass
-    pipelineCreateInfo.renderPass = constructedPipeline.renderPass;
+    pipelineCreateInfo.renderPass = renderPass;
     pipelineCreateInfo.subpass = 0;
 
-    if (vkCreateGraphicsPipelines(logicalDevice, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &constructedPipeline.pipeline) != VkResult::VK_SUCCESS)
+    // The pipeline cache lets the driver skip compiling shaders it has already seen (this run or a previous one).
+    if (vkCreateGraphicsPipelines(logicalDevice, pipelineCache, 1, &pipelineCreateInfo, nullptr, &constructedPipeline.pipeline) != VkResult::VK_SUCCESS)
     {
-        std::runtime_error("Failed to create graphics pipeline.");
+        vkDestroyPipelineLayout(logicalDevice, pipelineLayout, nullptr);
+        throw std::runtime_error("Failed to create graphics pipeline.");
     }
-
-    vkDestroyShaderModule(logicalDevice, vertShader, nullptr);
-    vkDestroyShaderModule(logicalDevice, fragShader, nullptr);
     return constructedPipeline;
 }
 
+bool Pipeline::operator==(const PipelineDescription &a, const PipelineDescription &b)
+{
+    auto sameRange = [](const VkPushConstantRange &x, const VkPushConstantRange &y) { return x.stageFlags == y.stageFlags && x.offset == y.offset && x.size == y.size; };
+    auto sameConstant = [](const SpecializationConstant &x, const SpecializationConstant &y) { return x.id == y.id && x.value == y.value; };
+    return a.vertexShaderPath == b.vertexShaderPath && a.fragmentShaderPath == b.fragmentShaderPath && a.instanced == b.instanced && a.alphaBlend == b.alphaBlend &&
+           a.cullMode == b.cullMode && a.topology == b.topology && a.setLayouts == b.setLayouts &&
+           std::equal(a.pushConstantRanges.begin(), a.pushConstantRanges.end(), b.pushConstantRanges.begin(), b.pushConstantRanges.end(), sameRange) &&
+           std::equal(a.specializationConstants.begin(), a.specializationConstants.end(), b.specializationConstants.begin(), b.specializationConstants.end(), sameConstant);
+}
+
+uint64_t Pipeline::HashDescription(const PipelineDescription &description)
+{
+    // FNV-1a, byte by byte. Only runs when a variant is looked up by description, never per draw.
+    uint64_t hash = 14695981039346656037ull;
+    auto mix = [&hash](const void *data, size_t size) {
+        const unsigned char *bytes = static_cast<const unsigned char *>(data);
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+    };
+    auto mixValue = [&mix](uint64_t value) { mix(&value, sizeof(value)); };
+
+    mix(description.vertexShaderPath.data(), description.vertexShaderPath.size());
+    mixValue(description.vertexShaderPath.size());
+    mix(description.fragmentShaderPath.data(), description.fragmentShaderPath.size());
+    mixValue(description.fragmentShaderPath.size());
+    mixValue(description.instanced);
+    mixValue(description.alphaBlend);
+    mixValue(description.cullMode);
+    mixValue(static_cast<uint64_t>(description.topology));
+    for (const VkPushConstantRange &range : description.pushConstantRanges)
+    {
+        mixValue(range.stageFlags);
+        mixValue(range.offset);
+        mixValue(range.size);
+    }
+    for (VkDescriptorSetLayout setLayout : description.setLayouts)
+    {
+        mixValue(reinterpret_cast<uint64_t>(setLayout));
+    }
+    for (const SpecializationConstant &constant : description.specializationConstants)
+    {
+        mixValue(constant.id);
+        mixValue(constant.value);
+    }
+    return hash;
+}
+
+void Pipeline::DestroyGraphicsPipeline(const VkDevice &logicalDevice, ConstructedPipeline &pipeline)
+{
+    vkDestroyPipeline(logicalDevice, pipeline.pipeline, nullptr);
+    vkDestroyPipelineLayout(logicalDevice, pipeline.layout, nullptr);
+    // Destroying VK_NULL_HANDLE is a no-op, so pipelines that borrow a render pass leave it alone.
+    vkDestroyRenderPass(logicalDevice, pipeline.renderPass, nullptr);
+}
+
+void Pipeline::SetViewportAndScissor(const VkCommandBuffer &commandBuffer, const VkExtent2D &extent)
+{
+    VkViewport viewport = {};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = (float)extent.width;
+    viewport.height = (float)extent.height;
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+    VkRect2D scissor = {};
+    scissor.offset = {0, 0};
+    scissor.extent = extent;
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+}
+
 VkShaderModule Pipeline::CreateShaderModule(const VkDevice &logicalDevice, const std::vector<char> &source)
 {
+    return Pipeline::CreateShaderModule(logicalDevice, FileIOSystem::Span{source.data(), source.size()});
+}
+
+VkShaderModule Pipeline::CreateShaderModule(const VkDevice &logicalDevice, const FileIOSystem::Span &source)
+{
+    if (source.size == 0 || source.size % sizeof(uint32_t) != 0 || reinterpret_cast<uintptr_t>(source.data) % alignof(uint32_t) != 0)
+    {
+        throw std::runtime_error("Shader code has to be a non-empty, 4 byte aligned run of 32 bit words.");
+    }
+
     VkShaderModuleCreateInfo createShaderInfo = {};
     createShaderInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    createShaderInfo.codeSize = source.size();
-    createShaderInfo.pCode = reinterpret_cast<const uint32_t *>(source.data());
+    createShaderInfo.codeSize = source.size;
+    createShaderInfo.pCode = source.Words();
 
     VkShaderModule shader;
     if (vkCreateShaderModule(logicalDevice, &createShaderInfo, nullptr, &shader) != VkResult::VK_SUCCESS)
@@ -183,7 +355,7 @@ VkShaderModule Pipeline::CreateShaderModule(const VkDevice &logicalDevice, const
     return shader;
 }
 
-VkRenderPass Pipeline::CreateRenderPass(const VkDevice &logicalDevice, const VkFormat &format)
+VkRenderPass Pipeline::CreateRenderPass(const VkDevice &logicalDevice, const VkFormat &format, VkImageLayout finalLayout)
 {
     VkAttachmentDescription colorAttachment = {};
     colorAttachment.format = format;
@@ -192,6 +364,9 @@ VkRenderPass Pipeline::CreateRenderPass(const VkDevice &logicalDevice, const VkF
     colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
     colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    // The image is cleared anyway, so whatever layout it was left in doesn't matter.
+    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    colorAttachment.finalLayout = finalLayout;
 
     // Reference for the description above for subpasses to use in their creation.
     VkAttachmentReference colorAttachmentRef = {};
@@ -5,20 +5,78 @@
 #include <map>
 #include <string>
 #include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+#include <cstring>
+#include <cstdint>
 
 #include "vertex.h"
+#include "../systems/fileio.h"
 
 namespace Pipeline
 {
     struct ConstructedPipeline
     {
         VkPipelineLayout layout;
-        VkRenderPass renderPass;
+        VkRenderPass renderPass; // VK_NULL_HANDLE when the pipeline draws in a render pass it doesn't own
         VkPipeline pipeline;
-        Vertex::VertexBuffer vertexBuffer;
     };
 
-    ConstructedPipeline CreateGraphicsPipeline(const VkDevice &logicalDevice, const VkExtent2D &extent, const VkFormat &format);
+    // Push constants of the sprite pipeline, world position to clip space is position * scale + offset.
+    struct CameraConstants
+    {
+        glm::vec2 scale;
+        glm::vec2 offset;
+    };
+
+    // A `layout(constant_id = id)` constant in either shader stage, baked in when the pipeline is compiled so the
+    // driver can fold branches on it away. Every constant is 32 bits, floats go in bit for bit (see SpecializeFloat).
+    struct SpecializationConstant
+    {
+        uint32_t id;
+        uint32_t value;
+    };
+
+    inline SpecializationConstant SpecializeFloat(uint32_t id, float value)
+    {
+        SpecializationConstant constant = {id, 0};
+        std::memcpy(&constant.value, &value, sizeof(value));
+        return constant;
+    }
+
+    // The parts that differ between the engine's pipelines, the rest of the fixed function state is shared.
+    // Two equal descriptions always build the same pipeline, see PipelineRegistry.
+    struct PipelineDescription
+    {
+        std::string vertexShaderPath;
+        std::string fragmentShaderPath;
+        bool instanced = false; // Adds the Vertex::SpriteInstance binding next to the per-vertex one
+        bool alphaBlend = false;
+        VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+        VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+        // Both are reflected from the shaders by PipelineRegistry::Register when left empty.
+        std::vector<VkPushConstantRange> pushConstantRanges;
+        std::vector<VkDescriptorSetLayout> setLayouts; // Set i of the layout, not owned by the pipeline
+        std::vector<SpecializationConstant> specializationConstants;
+    };
+
+    bool operator==(const PipelineDescription &a, const PipelineDescription &b);
+    // Combines every field of the description, for hashed lookups of pipeline variants.
+    uint64_t HashDescription(const PipelineDescription &description);
+
+    // pipelineCache may be VK_NULL_HANDLE, in which case the driver compiles the pipeline from scratch.
+    // Viewport and scissor are dynamic state, so the result only depends on the swapchain format and survives resizes.
+    // finalLayout is what the render pass leaves the color attachment in: ready to present, or to copy out of when rendering offscreen.
+    ConstructedPipeline CreateGraphicsPipeline(const VkDevice &logicalDevice, const VkFormat &format, const VkPipelineCache &pipelineCache, VkImageLayout finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+    // Instanced, alpha blended quads with the camera in push constants, see PipelineRegistry to build it.
+    // Set 0 is the sprite's texture, the registry reflects the same layout as TextureCache::GetDescriptorSetLayout.
+    PipelineDescription SpritePipelineDescription();
+    // Builds the pipeline and its layout for subpass 0 of renderPass. The returned renderPass is left VK_NULL_HANDLE.
+    // The vertex input is Vertex::Vertex, plus Vertex::SpriteInstance when instanced. Throws if the vertex shader
+    // reads a location neither provides.
+    ConstructedPipeline CreatePipeline(const VkDevice &logicalDevice, const VkRenderPass &renderPass, const VkPipelineCache &pipelineCache, const PipelineDescription &description);
+    void DestroyGraphicsPipeline(const VkDevice &logicalDevice, ConstructedPipeline &pipeline);
+    // Sets the dynamic viewport and scissor to cover the whole extent, has to be recorded before drawing with a pipeline from CreateGraphicsPipeline.
+    void SetViewportAndScissor(const VkCommandBuffer &commandBuffer, const VkExtent2D &extent);
 
     // std::vector<char> can be gotten from FileIO::ReadFileToVector.
     // https://vulkan-tutorial.com/Drawing_a_triangle/Graphics_pipeline_basics/Shader_modules
@@ -27,7 +85,9 @@ namespace Pipeline
     // When you perform a cast like this, you also need to ensure that the data satisfies the alignment requirements of uint32_t. Lucky for us, 
     // the data is stored in an std::vector where the default allocator already ensures that the data satisfies the worst case alignment requirements.
     VkShaderModule CreateShaderModule(const VkDevice &logicalDevice, const std::vector<char> &source);
-    VkRenderPass CreateRenderPass(const VkDevice &logicalDevice, const VkFormat &format);
+    // Straight from a mapped file, see FileIOSystem::OpenFile. Throws if the span isn't whole, aligned words.
+    VkShaderModule CreateShaderModule(const VkDevice &logicalDevice, const FileIOSystem::Span &source);
+    VkRenderPass CreateRenderPass(const VkDevice &logicalDevice, const VkFormat &format, VkImageLayout finalLayout);
 }
 
 #endif
\ No newline at end of file
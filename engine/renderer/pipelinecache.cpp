@@ -0,0 +1,84 @@
+#include <vulkan/vulkan.h>
+#include <iostream>
+#include <vector>
+#include <stdexcept>
+#include <cstring>
+
+#include "pipelinecache.h"
+#include "../systems/fileio.h"
+
+VkPipelineCache PipelineCache::Load(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, const std::string &path)
+{
+    std::vector<char> cacheData;
+    if (FileIOSystem::FileExists(path))
+    {
+        cacheData = FileIOSystem::ReadFileToVector(path);
+        if (!PipelineCache::IsHeaderValid(physicalDevice, cacheData.data(), cacheData.size()))
+        {
+            std::cout << "Pipeline cache " << path << " was written by a different device or driver, starting cold." << std::endl;
+            cacheData.clear();
+        }
+    }
+    else
+    {
+        std::cout << "No pipeline cache at " << path << ", starting cold." << std::endl;
+    }
+
+    VkPipelineCacheCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    createInfo.initialDataSize = cacheData.size();
+    createInfo.pInitialData = cacheData.empty() ? nullptr : cacheData.data();
+
+    VkPipelineCache pipelineCache;
+    if (vkCreatePipelineCache(logicalDevice, &createInfo, nullptr, &pipelineCache) != VkResult::VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create pipeline cache.");
+    }
+
+    if (!cacheData.empty())
+    {
+        std::cout << "Loaded " << cacheData.size() << " bytes of pipeline cache from " << path << std::endl;
+    }
+    return pipelineCache;
+}
+
+bool PipelineCache::IsHeaderValid(VkPhysicalDevice physicalDevice, const char *data, size_t size)
+{
+    // Drivers are supposed to reject foreign data themselves, but some of them crash on it instead.
+    // The header layout is fixed by the spec: VkPipelineCacheHeaderVersionOne.
+    VkPipelineCacheHeaderVersionOne header;
+    if (size < sizeof(header))
+    {
+        return false;
+    }
+    memcpy(&header, data, sizeof(header));
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    return header.headerSize >= sizeof(header) &&
+           header.headerSize <= size &&
+           header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           header.vendorID == properties.vendorID &&
+           header.deviceID == properties.deviceID &&
+           memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+void PipelineCache::Save(VkDevice logicalDevice, VkPipelineCache pipelineCache, const std::string &path)
+{
+    // Have to call it twice, once for the size and once for the data.
+    size_t size = 0;
+    if (vkGetPipelineCacheData(logicalDevice, pipelineCache, &size, nullptr) != VkResult::VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to get pipeline cache size.");
+    }
+    std::vector<char> cacheData(size);
+    if (vkGetPipelineCacheData(logicalDevice, pipelineCache, &size, cacheData.data()) != VkResult::VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to get pipeline cache data.");
+    }
+    cacheData.resize(size);
+
+    FileIOSystem::WriteVectorToFile(path, cacheData);
+    std::cout << "Saved " << size << " bytes of pipeline cache to " << path << std::endl;
+}
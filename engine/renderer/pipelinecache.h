@@ -0,0 +1,20 @@
+#ifndef PIPELINE_CACHE_H
+#define PIPELINE_CACHE_H
+
+#include <vulkan/vulkan.h>
+#include <string>
+
+namespace PipelineCache
+{
+// Saved next to the executable, it only contains driver compiled pipeline blobs so it is safe to delete.
+const std::string PIPELINE_CACHE_PATH = "./pipeline.cache";
+
+// Creates a VkPipelineCache seeded from `path`. The file is only used when its header matches this exact
+// vendor, device and driver cache UUID, anything else (missing file, other GPU, driver update) starts empty.
+// https://zeux.io/2019/07/17/serializing-pipeline-cache/
+VkPipelineCache Load(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, const std::string &path);
+bool IsHeaderValid(VkPhysicalDevice physicalDevice, const char *data, size_t size);
+void Save(VkDevice logicalDevice, VkPipelineCache pipelineCache, const std::string &path);
+} // namespace PipelineCache
+
+#endif
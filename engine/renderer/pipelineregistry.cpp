@@ -0,0 +1,179 @@
+#include <vulkan/vulkan.h>
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+
+#include "pipelineregistry.h"
+#include "shaderreflection.h"
+#include "../systems/jobsystem.h"
+
+void PipelineRegistry::Init(VkDevice logicalDevice, VkPipelineCache pipelineCache, DescriptorLayoutCache &layoutCache)
+{
+    _logicalDevice = logicalDevice;
+    _pipelineCache = pipelineCache;
+    _layoutCache = &layoutCache;
+}
+
+void PipelineRegistry::Cleanup()
+{
+    for (Variant &variant : _variants)
+    {
+        destroy(variant);
+    }
+    _variants.clear();
+    _lookup.clear();
+    _pending.clear();
+}
+
+PipelineRegistry::Handle PipelineRegistry::Register(VkRenderPass renderPass, const Pipeline::PipelineDescription &unreflected)
+{
+    Pipeline::PipelineDescription description = reflect(unreflected);
+    uint64_t hash = hashKey(renderPass, description);
+    auto range = _lookup.equal_range(hash);
+    for (auto found = range.first; found != range.second; ++found)
+    {
+        const Variant &variant = _variants[found->second];
+        if (variant.renderPass == renderPass && variant.description == description)
+        {
+            return found->second;
+        }
+    }
+
+    Variant variant;
+    variant.renderPass = renderPass;
+    variant.description = description;
+    for (const VkPushConstantRange &range : description.pushConstantRanges)
+    {
+        variant.pushConstantStages |= range.stageFlags;
+    }
+    Handle handle = static_cast<Handle>(_variants.size());
+    _variants.push_back(variant);
+    _lookup.emplace(hash, handle);
+    _pending.push_back(handle);
+    return handle;
+}
+
+uint32_t PipelineRegistry::CompilePending()
+{
+    // Drivers compile each pipeline on the calling thread, so independent variants compile side by side.
+    // The pipeline cache is internally synchronized, all of them can share it.
+    JobSystem::ParallelFor(_pending.size(), 1, [this](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+        {
+            compile(_variants[_pending[i]]);
+        }
+    });
+
+    uint32_t compiled = 0;
+    std::string firstError;
+    for (Handle handle : _pending)
+    {
+        Variant &variant = _variants[handle];
+        if (variant.compiled)
+        {
+            compiled++;
+        }
+        else if (firstError.empty())
+        {
+            firstError = variant.error;
+        }
+    }
+    _pending.clear();
+    if (!firstError.empty())
+    {
+        throw std::runtime_error(firstError);
+    }
+    return compiled;
+}
+
+PipelineRegistry::Handle PipelineRegistry::Request(VkRenderPass renderPass, const Pipeline::PipelineDescription &description)
+{
+    Handle handle = Register(renderPass, description);
+    if (!_variants[handle].compiled)
+    {
+        // A variant that failed before isn't pending anymore. Queue it again so it throws here instead of being
+        // handed out without a pipeline.
+        if (std::find(_pending.begin(), _pending.end(), handle) == _pending.end())
+        {
+            _pending.push_back(handle);
+        }
+        std::cout << "Compiling pipeline variant " << description.vertexShaderPath << " + " << description.fragmentShaderPath << " at draw time, register it up front" << std::endl;
+        _runtimeCompiles++;
+        CompilePending();
+    }
+    return handle;
+}
+
+void PipelineRegistry::ChangeRenderPass(VkRenderPass oldRenderPass, VkRenderPass newRenderPass)
+{
+    // The render pass is part of the key, so every entry is rehashed.
+    _lookup.clear();
+    for (Handle handle = 0; handle < _variants.size(); handle++)
+    {
+        Variant &variant = _variants[handle];
+        if (variant.renderPass == oldRenderPass)
+        {
+            destroy(variant);
+            variant.renderPass = newRenderPass;
+            _pending.push_back(handle);
+        }
+        _lookup.emplace(hashKey(variant.renderPass, variant.description), handle);
+    }
+    CompilePending();
+}
+
+uint64_t PipelineRegistry::hashKey(VkRenderPass renderPass, const Pipeline::PipelineDescription &description)
+{
+    uint64_t hash = Pipeline::HashDescription(description);
+    hash ^= reinterpret_cast<uint64_t>(renderPass) + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+    return hash;
+}
+
+// The layouts come from the shared cache, so the same shader interface always gives the same VkDescriptorSetLayout
+// and descriptions with it compare and hash equal.
+Pipeline::PipelineDescription PipelineRegistry::reflect(const Pipeline::PipelineDescription &description)
+{
+    if (!description.pushConstantRanges.empty() && !description.setLayouts.empty())
+    {
+        return description;
+    }
+    std::shared_ptr<const ShaderReflection::Module> vertex = ShaderReflection::ReflectFile(description.vertexShaderPath);
+    std::shared_ptr<const ShaderReflection::Module> fragment = ShaderReflection::ReflectFile(description.fragmentShaderPath);
+
+    Pipeline::PipelineDescription reflected = description;
+    if (reflected.pushConstantRanges.empty())
+    {
+        reflected.pushConstantRanges = ShaderReflection::CreatePushConstantRanges(*vertex, *fragment);
+    }
+    if (reflected.setLayouts.empty())
+    {
+        reflected.setLayouts = ShaderReflection::CreateSetLayouts(ShaderReflection::MergeBindings(*vertex, *fragment), *_layoutCache);
+    }
+    return reflected;
+}
+
+// Runs on job system workers.
+void PipelineRegistry::compile(Variant &variant)
+{
+    try
+    {
+        variant.pipeline = Pipeline::CreatePipeline(_logicalDevice, variant.renderPass, _pipelineCache, variant.description);
+        variant.compiled = true;
+        variant.error.clear();
+    }
+    catch (const std::exception &e)
+    {
+        variant.error = e.what();
+    }
+}
+
+void PipelineRegistry::destroy(Variant &variant)
+{
+    if (variant.compiled)
+    {
+        // The render pass belongs to whoever registered the variant, CreatePipeline leaves it VK_NULL_HANDLE here.
+        Pipeline::DestroyGraphicsPipeline(_logicalDevice, variant.pipeline);
+        variant.pipeline = {};
+        variant.compiled = false;
+    }
+}
@@ -0,0 +1,86 @@
+#ifndef PIPELINE_REGISTRY_H
+#define PIPELINE_REGISTRY_H
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <cstdint>
+
+#include "pipeline.h"
+#include "descriptors.h"
+
+// Every pipeline variant the game draws with, keyed by its render pass and Pipeline::PipelineDescription.
+// Variants are registered up front (at load time, with every shader permutation a material may need) and compiled
+// together by CompilePending, spread over the job system's workers. Drawing then only ever looks a variant up by
+// handle, and small per-draw parameters go through push constants, so switching materials never compiles anything.
+// Request compiles on the spot as a fallback, and counts how often that happened so missing registrations show up.
+// https://docs.vulkan.org/guide/latest/pipeline_cache.html
+//
+// Register, Request and CompilePending have to be called from one thread at a time. Get is safe from any thread
+// while none of those run, which is how recording works.
+class PipelineRegistry
+{
+  public:
+    using Handle = uint32_t;
+
+    static constexpr Handle INVALID_HANDLE = UINT32_MAX;
+
+    // pipelineCache may be VK_NULL_HANDLE, it is only borrowed. Reflected set layouts come from layoutCache.
+    void Init(VkDevice logicalDevice, VkPipelineCache pipelineCache, DescriptorLayoutCache &layoutCache);
+    // Destroys every variant's pipeline and layout.
+    void Cleanup();
+
+    // Adds a variant without compiling it. Registering an equal description for the same render pass returns the
+    // existing handle, so callers don't need to track what was registered already.
+    // Empty push constant ranges and set layouts are filled in from the shaders' reflection first, see ShaderReflection.
+    Handle Register(VkRenderPass renderPass, const Pipeline::PipelineDescription &description);
+    // Compiles every pending variant, in parallel, and returns how many of them compiled successfully.
+    // Throws with the first variant's error if any of them failed, the others are kept. Failed variants aren't
+    // retried by later calls, only by Request.
+    uint32_t CompilePending();
+    // Register and, if the variant has no pipeline yet, compile it right away. Throws if it doesn't compile, so the
+    // handle returned is always safe to Get.
+    Handle Request(VkRenderPass renderPass, const Pipeline::PipelineDescription &description);
+
+    // Only valid once the variant has been compiled.
+    const Pipeline::ConstructedPipeline &Get(Handle variant) const { return _variants[variant].pipeline; }
+    // Every stage the variant's push constant ranges are visible to, which vkCmdPushConstants has to name.
+    VkShaderStageFlags GetPushConstantStages(Handle variant) const { return _variants[variant].pushConstantStages; }
+    const Pipeline::PipelineDescription &GetDescription(Handle variant) const { return _variants[variant].description; }
+
+    // Moves every variant drawn in oldRenderPass to newRenderPass, for a swapchain format change. Their pipelines
+    // are destroyed and recompiled, handles stay the same. The device must not be using them anymore.
+    void ChangeRenderPass(VkRenderPass oldRenderPass, VkRenderPass newRenderPass);
+
+    uint32_t GetVariantCount() const { return static_cast<uint32_t>(_variants.size()); }
+    // Variants compiled by Request instead of CompilePending.
+    uint32_t GetRuntimeCompileCount() const { return _runtimeCompiles; }
+
+  private:
+    struct Variant
+    {
+        VkRenderPass renderPass = VK_NULL_HANDLE;
+        Pipeline::PipelineDescription description;
+        VkShaderStageFlags pushConstantStages = 0;
+        Pipeline::ConstructedPipeline pipeline = {};
+        bool compiled = false;
+        std::string error; // Set by a failed compile on a worker, jobs can't throw
+    };
+
+    VkDevice _logicalDevice = VK_NULL_HANDLE;
+    VkPipelineCache _pipelineCache = VK_NULL_HANDLE;
+    DescriptorLayoutCache *_layoutCache = nullptr;
+    std::vector<Variant> _variants;
+    // Keyed by the hash of render pass and description, colliding variants sit side by side.
+    std::unordered_multimap<uint64_t, Handle> _lookup;
+    std::vector<Handle> _pending;
+    uint32_t _runtimeCompiles = 0;
+
+    static uint64_t hashKey(VkRenderPass renderPass, const Pipeline::PipelineDescription &description);
+    Pipeline::PipelineDescription reflect(const Pipeline::PipelineDescription &description);
+    void compile(Variant &variant);
+    void destroy(Variant &variant);
+};
+
+#endif
@@ -1,5 +1,6 @@
 #include <iostream>
 #include <vector>
+#include <cstdlib>
 #include <vulkan/vulkan.h>
 #include <SDL2/SDL.h>
 
@@ -15,29 +16,51 @@ QueueFamily::QueueFamilyIndices QueueFamily::findQueueFamilies(VkPhysicalDevice
     std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
     vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
 
+    // Every family is looked at, the dedicated transfer and compute families tend to come after the graphics one.
     int i = 0;
     for (const VkQueueFamilyProperties &queueFamily : queueFamilies)
     {
-        if (queueFamily.queueCount > 0 && (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT))
+        if (queueFamily.queueCount == 0)
+        {
+            i += 1;
+            continue;
+        }
+
+        bool graphics = (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
+        bool compute = (queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT) != 0;
+        bool transfer = (queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) != 0;
+        if (graphics && indices.graphicsFamily < 0)
         {
             indices.graphicsFamily = i;
         }
+        if (transfer && !graphics && !compute && indices.transferFamily < 0)
+        {
+            indices.transferFamily = i;
+        }
+        if (compute && !graphics && indices.computeFamily < 0)
+        {
+            indices.computeFamily = i;
+        }
 
         VkBool32 presentSupport = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
-
-        if (queueFamily.queueCount > 0 && presentSupport)
+        if (surface != VK_NULL_HANDLE)
         {
-            indices.presentFamily = i;
+            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
         }
 
-        if (indices.isComplete())
+        // Presenting from the graphics family, when it can, keeps the swapchain images in one family.
+        if (presentSupport && (indices.presentFamily < 0 || i == indices.graphicsFamily))
         {
-            break;
+            indices.presentFamily = i;
         }
 
         i += 1;
     }
 
+    if (std::getenv("ROGUE_NO_TRANSFER_QUEUE") != nullptr)
+    {
+        indices.transferFamily = -1;
+    }
+
     return indices;
 }
\ No newline at end of file
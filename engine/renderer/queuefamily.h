@@ -9,13 +9,26 @@ struct QueueFamilyIndices
 {
     int graphicsFamily = -1;
     int presentFamily = -1;
+    // Families without graphics, -1 when the device has none. A transfer-only family is the GPU's copy (DMA) engine,
+    // which moves data across PCIe while the graphics queue keeps rendering. Compute-only families run async compute.
+    // Integrated GPUs and software rasterizers usually have neither, everything then goes through the graphics queue.
+    int transferFamily = -1;
+    int computeFamily = -1;
 
     bool isComplete()
     {
         return graphicsFamily >= 0 && presentFamily >= 0;
     }
+
+    // Headless rendering has no surface, so only a graphics queue is needed.
+    bool isComplete(VkSurfaceKHR surface)
+    {
+        return surface == VK_NULL_HANDLE ? graphicsFamily >= 0 : isComplete();
+    }
 };
 
+// surface may be VK_NULL_HANDLE, presentFamily then stays -1.
+// Set ROGUE_NO_TRANSFER_QUEUE to leave transferFamily at -1, to compare against uploading on the graphics queue.
 QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR surface);
 } // namespace QueueFamily
 
@@ -0,0 +1,139 @@
+#include <vulkan/vulkan.h>
+#include <stdexcept>
+#include <algorithm>
+
+#include "recorder.h"
+#include "../systems/jobsystem.h"
+#include "../systems/profiler.h"
+
+void ParallelRecorder::Init(VkDevice logicalDevice, uint32_t queueFamily, uint32_t framesInFlight, uint32_t sliceCount)
+{
+    _logicalDevice = logicalDevice;
+    _slices = std::vector<std::vector<SliceFrame>>(sliceCount > 0 ? sliceCount : 1, std::vector<SliceFrame>(framesInFlight));
+
+    for (std::vector<SliceFrame> &slice : _slices)
+    {
+        for (SliceFrame &frame : slice)
+        {
+            VkCommandPoolCreateInfo commandPoolInfo = {};
+            commandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+            commandPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+            commandPoolInfo.queueFamilyIndex = queueFamily;
+            if (vkCreateCommandPool(logicalDevice, &commandPoolInfo, nullptr, &frame.commandPool) != VkResult::VK_SUCCESS)
+            {
+                throw std::runtime_error("Failed to create recording slice command pool.");
+            }
+
+            VkCommandBufferAllocateInfo bufferInfo = {};
+            bufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            bufferInfo.commandPool = frame.commandPool;
+            bufferInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+            bufferInfo.commandBufferCount = 1;
+            if (vkAllocateCommandBuffers(logicalDevice, &bufferInfo, &frame.commandBuffer) != VkResult::VK_SUCCESS)
+            {
+                throw std::runtime_error("Failed to allocate secondary command buffer.");
+            }
+        }
+    }
+}
+
+void ParallelRecorder::Cleanup()
+{
+    for (std::vector<SliceFrame> &slice : _slices)
+    {
+        for (SliceFrame &frame : slice)
+        {
+            vkDestroyCommandPool(_logicalDevice, frame.commandPool, nullptr);
+        }
+    }
+    _slices.clear();
+}
+
+void ParallelRecorder::ResetFrame(uint32_t frame)
+{
+    for (std::vector<SliceFrame> &slice : _slices)
+    {
+        vkResetCommandPool(_logicalDevice, slice[frame].commandPool, 0);
+    }
+}
+
+uint32_t ParallelRecorder::Record(uint32_t frame, const VkCommandBufferInheritanceInfo &inheritance, size_t itemCount, SliceRecorder recorder, void *userData, VkCommandBuffer *secondaryBuffers)
+{
+    uint32_t sliceCount = static_cast<uint32_t>(std::min<size_t>(_slices.size(), itemCount));
+    if (sliceCount == 0)
+    {
+        return 0;
+    }
+
+    _frame = frame;
+    _inheritance = &inheritance;
+    _itemCount = itemCount;
+    _sliceCount = sliceCount;
+    _recorder = recorder;
+    _userData = userData;
+    _error = nullptr;
+
+    JobSystem::Counter counter;
+    for (uint32_t slice = 1; slice < sliceCount; slice++)
+    {
+        JobSystem::Run([this, slice]() {
+            try
+            {
+                recordSlice(slice);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(_errorMutex);
+                _error = std::current_exception();
+            }
+        }, &counter);
+    }
+
+    // The calling thread takes the first slice and then helps with the rest while it waits.
+    try
+    {
+        recordSlice(0);
+    }
+    catch (...)
+    {
+        // The other slices still reference the inheritance info on the caller's stack, let them finish first.
+        JobSystem::Wait(counter);
+        throw;
+    }
+    JobSystem::Wait(counter);
+    if (_error)
+    {
+        std::rethrow_exception(_error);
+    }
+
+    for (uint32_t slice = 0; slice < sliceCount; slice++)
+    {
+        secondaryBuffers[slice] = _slices[slice][frame].commandBuffer;
+    }
+    return sliceCount;
+}
+
+void ParallelRecorder::recordSlice(uint32_t slice)
+{
+    PROFILE_ZONE("record slice");
+    size_t begin = _itemCount * slice / _sliceCount;
+    size_t end = _itemCount * (slice + 1) / _sliceCount;
+    VkCommandBuffer commandBuffer = _slices[slice][_frame].commandBuffer;
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    // RENDER_PASS_CONTINUE: the whole buffer executes inside the render pass described by the inheritance info.
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    beginInfo.pInheritanceInfo = _inheritance;
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VkResult::VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to begin secondary command buffer recording.");
+    }
+
+    _recorder(commandBuffer, begin, end, _userData);
+
+    if (vkEndCommandBuffer(commandBuffer) != VkResult::VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to end secondary command buffer recording.");
+    }
+}
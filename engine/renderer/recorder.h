@@ -0,0 +1,58 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <mutex>
+#include <exception>
+#include <cstdint>
+
+// Splits a list of items into slices recorded as job system jobs, each into its own secondary command buffer
+// that the primary buffer then runs with vkCmdExecuteCommands.
+// Command pools are externally synchronized, so every slice owns one pool per frame in flight. Whichever worker
+// picks up a slice is the only thread touching that slice's pool while it records.
+// https://developer.nvidia.com/blog/vulkan-dos-donts/ (Command buffers)
+class ParallelRecorder
+{
+  public:
+    // Records items [begin, end) into an already begun secondary command buffer.
+    using SliceRecorder = void (*)(VkCommandBuffer commandBuffer, size_t begin, size_t end, void *userData);
+
+    // sliceCount is the most threads that record at once. The calling thread records the first slice itself.
+    void Init(VkDevice logicalDevice, uint32_t queueFamily, uint32_t framesInFlight, uint32_t sliceCount);
+    void Cleanup();
+    uint32_t GetSliceCount() { return static_cast<uint32_t>(_slices.size()); }
+
+    // Resets every slice's pool for `frame`. Only valid once that frame's fence has signaled.
+    void ResetFrame(uint32_t frame);
+    // Waits (running other jobs) until all slices are recorded. Writes one secondary buffer per slice to
+    // secondaryBuffers (which must hold GetSliceCount() entries) and returns how many were used.
+    uint32_t Record(uint32_t frame, const VkCommandBufferInheritanceInfo &inheritance, size_t itemCount, SliceRecorder recorder, void *userData, VkCommandBuffer *secondaryBuffers);
+
+  private:
+    struct SliceFrame
+    {
+        VkCommandPool commandPool;
+        VkCommandBuffer commandBuffer;
+    };
+
+    VkDevice _logicalDevice = VK_NULL_HANDLE;
+    // _slices[slice][frame]
+    std::vector<std::vector<SliceFrame>> _slices;
+
+    // Jobs can't throw, the first failure is parked here and rethrown by Record().
+    std::mutex _errorMutex;
+    std::exception_ptr _error;
+
+    // The recording in progress, only written by Record() before any slice job is queued.
+    uint32_t _frame = 0;
+    const VkCommandBufferInheritanceInfo *_inheritance = nullptr;
+    size_t _itemCount = 0;
+    uint32_t _sliceCount = 0;
+    SliceRecorder _recorder = nullptr;
+    void *_userData = nullptr;
+
+    void recordSlice(uint32_t slice);
+};
+
+#endif
@@ -23,15 +23,20 @@ RenderDevice::DeviceContainer RenderDevice::GetDeviceSetup(VkInstance instance,
     std::cout << "Getting Queue Families..." << std::endl;
     QueueFamily::QueueFamilyIndices indices = QueueFamily::findQueueFamilies(physicalDevice, surface);
     VkQueue graphicsQueue = RenderDevice::GetQueue(indices.graphicsFamily, logicalDevice);
-    VkQueue presentQueue = RenderDevice::GetQueue(indices.presentFamily, logicalDevice);
+    VkQueue presentQueue = surface != VK_NULL_HANDLE ? RenderDevice::GetQueue(indices.presentFamily, logicalDevice) : VK_NULL_HANDLE;
     std::cout << "VK_QUEUE_GRAPHICS_BIT Index: " << indices.graphicsFamily << std::endl;
     std::cout << "Present Queue Family Index: " << indices.presentFamily << std::endl;
-
-    return {
-        physicalDevice,
-        logicalDevice,
-        graphicsQueue,
-        presentQueue};
+    std::cout << "Dedicated Transfer Queue Family Index: " << indices.transferFamily << std::endl;
+    std::cout << "Async Compute Queue Family Index: " << indices.computeFamily << std::endl;
+
+    DeviceContainer container;
+    container.physicalDevice = physicalDevice;
+    container.logicalDevice = logicalDevice;
+    container.graphicsQueue = graphicsQueue;
+    container.presentQueue = presentQueue;
+    container.transferQueue = indices.transferFamily >= 0 ? RenderDevice::GetQueue(indices.transferFamily, logicalDevice) : VK_NULL_HANDLE;
+    container.computeQueue = indices.computeFamily >= 0 ? RenderDevice::GetQueue(indices.computeFamily, logicalDevice) : VK_NULL_HANDLE;
+    return container;
 }
 
 VkPhysicalDevice RenderDevice::SelectDevice(VkInstance instance, VkSurfaceKHR surface)
@@ -77,14 +82,25 @@ bool RenderDevice::IsDeviceSuitable(VkPhysicalDevice device, VkSurfaceKHR surfac
     std::cout << "Checking suitability of device..." << std::endl;
     // https://vulkan-tutorial.com/Drawing_a_triangle/Setup/Physical_devices_and_queue_families
     QueueFamily::QueueFamilyIndices indices = QueueFamily::findQueueFamilies(device, surface);
+    if (!indices.isComplete(surface) || !RenderDevice::CheckDeviceExtensionSupport(device, RenderDevice::GetRequiredDeviceExtensions(surface)))
+    {
+        return false;
+    }
+    if (surface == VK_NULL_HANDLE)
+    {
+        return true;
+    }
     // https://vulkan-tutorial.com/Drawing_a_triangle/Presentation/Swap_chain
     Swapchain::SwapchainSupportDetails details = Swapchain::QuerySwapchainSupport(device, surface);
-    bool swapchainSupport = !details.presentModes.empty() && !details.formats.empty();
+    return !details.presentModes.empty() && !details.formats.empty();
+}
 
-    return indices.isComplete() && RenderDevice::CheckDeviceExtensionSupport(device) && swapchainSupport;
+const std::vector<const char *> &RenderDevice::GetRequiredDeviceExtensions(VkSurfaceKHR surface)
+{
+    return surface != VK_NULL_HANDLE ? RenderDevice::RequiredDeviceExtensions : RenderDevice::HeadlessDeviceExtensions;
 }
 
-bool RenderDevice::CheckDeviceExtensionSupport(VkPhysicalDevice device)
+bool RenderDevice::CheckDeviceExtensionSupport(VkPhysicalDevice device, const std::vector<const char *> &requiredExtensions)
 {
     uint32_t extensionCount = 0;
     if (vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr) != VkResult::VK_SUCCESS)
@@ -111,11 +127,11 @@ bool RenderDevice::CheckDeviceExtensionSupport(VkPhysicalDevice device)
 
     std::cout << "Checking device extensions for required support..." << std::endl;
     uint requiredMatches = 0;
-    for (int i = 0; i < static_cast<int>(RenderDevice::RequiredDeviceExtensions.size()); i++)
+    for (int i = 0; i < static_cast<int>(requiredExtensions.size()); i++)
     {
         for (const VkExtensionProperties &extension : availableExtensions)
         {
-            std::string requiredName(RenderDevice::RequiredDeviceExtensions[i]);
+            std::string requiredName(requiredExtensions[i]);
             std::string extensionName(extension.extensionName);
             std::cout << "\t\tComparing required extension " << requiredName << " with available extension " << extensionName;
             if (requiredName.compare(extensionName) == 0)
@@ -128,7 +144,7 @@ bool RenderDevice::CheckDeviceExtensionSupport(VkPhysicalDevice device)
         }
     }
 
-    return requiredMatches == RenderDevice::RequiredDeviceExtensions.size();
+    return requiredMatches == requiredExtensions.size();
 }
 
 VkDevice RenderDevice::CreateLogicalDevice(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface)
@@ -136,7 +152,19 @@ VkDevice RenderDevice::CreateLogicalDevice(VkPhysicalDevice physicalDevice, VkSu
     QueueFamily::QueueFamilyIndices indices = QueueFamily::findQueueFamilies(physicalDevice, surface);
 
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-    std::set<int> uniqueQueueFamilies = {indices.graphicsFamily, indices.presentFamily};
+    std::set<int> uniqueQueueFamilies = {indices.graphicsFamily};
+    if (indices.presentFamily >= 0)
+    {
+        uniqueQueueFamilies.insert(indices.presentFamily);
+    }
+    if (indices.transferFamily >= 0)
+    {
+        uniqueQueueFamilies.insert(indices.transferFamily);
+    }
+    if (indices.computeFamily >= 0)
+    {
+        uniqueQueueFamilies.insert(indices.computeFamily);
+    }
 
     float queuePriority = 1.0f;
     // For each unique queue family (recorded indices), create a VkDeviceQueueCreateInfo to be used with VkDeviceCreateInfo for device creation.
@@ -154,8 +182,9 @@ VkDevice RenderDevice::CreateLogicalDevice(VkPhysicalDevice physicalDevice, VkSu
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
     createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
-    createInfo.ppEnabledExtensionNames = RenderDevice::RequiredDeviceExtensions.data();
-    createInfo.enabledExtensionCount = static_cast<uint32_t>(RenderDevice::RequiredDeviceExtensions.size());
+    const std::vector<const char *> &extensions = RenderDevice::GetRequiredDeviceExtensions(surface);
+    createInfo.ppEnabledExtensionNames = extensions.data();
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
 
     VkDevice logicalDevice;
     if (vkCreateDevice(physicalDevice, &createInfo, nullptr, &logicalDevice) != VK_SUCCESS)
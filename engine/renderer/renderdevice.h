@@ -14,17 +14,29 @@ const std::vector<const char *> RequiredDeviceExtensions = {
 #endif
     VK_KHR_SWAPCHAIN_EXTENSION_NAME};
 
+// Offscreen rendering never presents, so it doesn't need the swapchain extension.
+const std::vector<const char *> HeadlessDeviceExtensions = {
+#if __APPLE__
+    "VK_MVK_moltenvk",
+#endif
+};
+
 struct DeviceContainer
 {
     VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
     VkDevice logicalDevice;
     VkQueue graphicsQueue;
-    VkQueue presentQueue;
+    VkQueue presentQueue; // VK_NULL_HANDLE when headless
+    VkQueue transferQueue = VK_NULL_HANDLE; // Dedicated transfer family, VK_NULL_HANDLE when the device has none
+    VkQueue computeQueue = VK_NULL_HANDLE;  // Compute family without graphics, VK_NULL_HANDLE when the device has none
 };
 
+// Every function taking a surface also accepts VK_NULL_HANDLE, for headless rendering into offscreen images.
+// No present support or swapchain extension is asked for then.
 VkPhysicalDevice SelectDevice(VkInstance instance, VkSurfaceKHR surface);
 bool IsDeviceSuitable(VkPhysicalDevice device, VkSurfaceKHR surface);
-bool CheckDeviceExtensionSupport(VkPhysicalDevice device);
+bool CheckDeviceExtensionSupport(VkPhysicalDevice device, const std::vector<const char *> &requiredExtensions);
+const std::vector<const char *> &GetRequiredDeviceExtensions(VkSurfaceKHR surface);
 VkDevice CreateLogicalDevice(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface);
 VkQueue GetQueue(int queueIndex, VkDevice logicalDevice);
 DeviceContainer GetDeviceSetup(VkInstance instance, VkSurfaceKHR surface);
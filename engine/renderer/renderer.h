@@ -6,10 +6,23 @@
 #include <vulkan/vulkan_macos.h>
 #include <vector>
 #include <string>
+#include <cstring>
+#include <cstdint>
 
 #include "swapchain.h"
 #include "renderdevice.h"
 #include "pipeline.h"
+#include "pipelineregistry.h"
+#include "memory.h"
+#include "upload.h"
+#include "assetloader.h"
+#include "descriptors.h"
+#include "framering.h"
+#include "texture.h"
+#include "mesh.h"
+#include "recorder.h"
+#include "spritebatch.h"
+#include "gpuprofiler.h"
 
 struct SynchronizationObjects {
   std::vector<VkSemaphore> imageAvailableSemaphores;
@@ -17,39 +30,236 @@ struct SynchronizationObjects {
   std::vector<VkFence> inFlightFences;
 };
 
+// One draw in the frame's draw list. Filled by the game every frame through Renderer::Draw, see
+// Renderer::CreateMeshDraw for drawing a mesh.
+struct DrawCommand {
+  VkBuffer vertexBuffer = VK_NULL_HANDLE;
+  VkDeviceSize vertexOffset = 0;
+  uint32_t vertexCount = 0;
+  uint32_t instanceCount = 1;
+  uint32_t firstVertex = 0;
+  uint32_t firstInstance = 0;
+  // Drawn indexed when set: indexCount indices from firstIndex, each added to baseVertex. vertexCount and firstVertex
+  // are ignored then. Consecutive draws from the same index buffer and type skip the rebind, like vertex buffers do.
+  VkBuffer indexBuffer = VK_NULL_HANDLE;
+  VkIndexType indexType = VK_INDEX_TYPE_UINT16;
+  uint32_t indexCount = 0;
+  uint32_t firstIndex = 0;
+  int32_t baseVertex = 0;
+  // A variant from Renderer::GetPipelines(), drawn in Renderer::GetRenderPass(). INVALID_HANDLE is the demo pipeline.
+  PipelineRegistry::Handle pipeline = PipelineRegistry::INVALID_HANDLE;
+  // Pushed at offset 0 to the variant's push constant stages right before the draw, nothing is pushed when 0.
+  // 128 bytes is all the spec guarantees for a whole layout, per-draw parameters should stay well below that.
+  static constexpr uint32_t MAX_PUSH_CONSTANT_SIZE = 32;
+  uint32_t pushConstantSize = 0;
+  alignas(16) unsigned char pushConstants[MAX_PUSH_CONSTANT_SIZE] = {};
+
+  template <typename T>
+  void SetPushConstants(const T &value)
+  {
+    static_assert(sizeof(T) <= MAX_PUSH_CONSTANT_SIZE, "Per-draw push constants are limited to MAX_PUSH_CONSTANT_SIZE bytes.");
+    std::memcpy(pushConstants, &value, sizeof(T));
+    pushConstantSize = sizeof(T);
+  }
+};
+
+// Instanced sprites read from a buffer the caller owns, like a tilemap chunk. The buffer has to stay alive
+// and unchanged (outside of Upload::Uploader copies, which are ordered against earlier frames) until the frame is done.
+struct InstanceDraw {
+  VkBuffer instanceBuffer = VK_NULL_HANDLE;
+  VkDeviceSize offset = 0;
+  uint32_t instanceCount = 0;
+  TextureCache::Handle texture = TextureCache::WHITE;
+};
+
+// Everything needed to record one frame in flight. The whole pool is reset once the frame's fence signals,
+// which is cheaper than resetting or freeing command buffers one by one.
+struct FrameContext {
+  VkCommandPool commandPool;
+  VkCommandBuffer commandBuffer;
+  // Reset once the frame's fence has signaled, so sets allocated here live for exactly one frame.
+  DescriptorAllocator descriptors;
+};
+
+// What the last DrawFrame submitted and spent recording. secondaryBuffers is 0 when the draw list was recorded inline.
+struct FrameStats {
+  uint32_t drawCalls = 0;
+  uint32_t instances = 0;
+  uint32_t sprites = 0;
+  uint32_t secondaryBuffers = 0;
+  double recordMilliseconds = 0.0;
+  // GPU time of the whole command buffer, from the last time this frame slot was used (MAX_FRAMES_IN_FLIGHT frames ago).
+  double gpuMilliseconds = 0.0;
+};
+
+// Headless renders into offscreen images instead of a window's swapchain. No window, surface or display is needed,
+// so it runs on build machines with a software ICD (lavapipe, SwiftShader) for benchmarks and image-diff tests.
+struct RendererOptions {
+  bool headless = false;
+  uint32_t width = 800;
+  uint32_t height = 600;
+};
+
 class Renderer
 {
   public:
-    Renderer();
+    struct PipelineCreationTimings
+    {
+        double coldMilliseconds = 0.0;
+        double warmMilliseconds = 0.0;
+    };
+
+    Renderer(const RendererOptions &options = RendererOptions());
     ~Renderer();
-    SDL_Window *GetWindow() { return _window; }
+    SDL_Window *GetWindow() { return _window; } // nullptr when headless
+    bool IsHeadless() { return _options.headless; }
     VkInstance GetInstance() { return _instance; }
     VkSurfaceKHR GetMainSurface() { return _mainSurface; }
     VkDevice GetDevice() { return _deviceInfo.logicalDevice; }
+    Memory::Allocator &GetAllocator() { return _allocator; }
+    Upload::Uploader &GetUploader() { return _uploader; }
+    // Background loads, uploaded through GetUploader. The game calls its Update once per frame.
+    AssetLoader &GetAssetLoader() { return _assetLoader; }
+    // Sprite textures and atlas pages, see AtlasBuilder.
+    TextureCache &GetTextureCache() { return _textures; }
+    // Meshes in shared vertex and index buffers, see CreateMeshDraw.
+    MeshCache &GetMeshes() { return _meshes; }
+    // TRIANGLE_VERTICES as a mesh, drawn with the demo pipeline. Built in at first, the baked DEMO_MESH_PATH once it has loaded.
+    MeshCache::Handle GetDemoMesh() { return _demoMesh; }
+    // Every set layout the renderer and the game create should come from here, so equal layouts are shared.
+    DescriptorLayoutCache &GetDescriptorLayouts() { return _descriptorLayouts; }
+    // Sets for the next DrawFrame only, e.g. with DescriptorBuilder(GetDescriptorLayouts(), GetFrameDescriptors()).
+    // The first call after a DrawFrame waits for the frame that last used these pools, the same wait DrawFrame would do.
+    DescriptorAllocator &GetFrameDescriptors();
+    // Uniforms and instance data for the next DrawFrame, e.g. a ring slice passed to DrawInstances. Waits like
+    // GetFrameDescriptors, and slices from it are overwritten MAX_FRAMES_IN_FLIGHT frames later.
+    FrameRing &GetFrameData();
+    // Register every variant a scene may draw with while loading it, then call CompilePending once.
+    PipelineRegistry &GetPipelines() { return _pipelines; }
+    // What every pipeline variant is drawn in. Changes when the surface format does, the registry follows it.
+    VkRenderPass GetRenderPass() { return _demoPipeline.renderPass; }
+    const Camera2D &GetCamera() { return _camera; }
+    VkExtent2D GetExtent() { return _swapchainInfo.extent; }
+    // For destroying resources that frames in flight may still read.
+    void WaitIdle() { vkDeviceWaitIdle(_deviceInfo.logicalDevice); }
+    // A draw of the whole mesh with the demo pipeline, ready for Draw. Pipeline, instances and push constants can be
+    // changed before queuing it. Meshes from the same block share buffers, so drawing them back to back rebinds nothing.
+    DrawCommand CreateMeshDraw(MeshCache::Handle mesh)
+    {
+        const MeshCache::Mesh &data = _meshes.GetMesh(mesh);
+        DrawCommand command;
+        command.vertexBuffer = _meshes.GetVertexBuffer(data.block);
+        command.indexBuffer = _meshes.GetIndexBuffer(data.block);
+        command.indexType = data.indexType;
+        command.indexCount = data.indexCount;
+        command.firstIndex = data.firstIndex;
+        command.baseVertex = data.baseVertex;
+        return command;
+    }
+    // Queues a draw for the next DrawFrame. The draw list keeps its capacity between frames, so this doesn't allocate in steady state.
+    void Draw(const DrawCommand &command)
+    {
+        _drawList.push_back(command);
+        _queuedInstances += command.instanceCount;
+    }
+    // Queues a sprite for the next DrawFrame, sampling texture at sprite.uvRect. The sprites of a frame go out before the
+    // draw list, in one instanced draw per run of sprites that share a texture.
+    void DrawSprite(const Vertex::SpriteInstance &sprite, TextureCache::Handle texture = TextureCache::WHITE) { _spriteBatch.Add(sprite, _textures.GetDescriptorSet(texture)); }
+    // Queues sprites from an external buffer. These are drawn before the sprite batch, in the order they were queued.
+    void DrawInstances(const InstanceDraw &draw)
+    {
+        _instanceDraws.push_back(draw);
+        _queuedInstances += draw.instanceCount;
+    }
+    void SetCamera(const Camera2D &camera) { _camera = camera; }
     void DrawFrame();
     void RecreateSwapchain();
+    // Headless only, rebuilds the offscreen images at the new size the same way a window resize rebuilds the swapchain.
+    void ResizeOffscreen(uint32_t width, uint32_t height);
+    // Number of slices (and so at most threads, including the caller of DrawFrame) that draw lists past
+    // PARALLEL_RECORD_THRESHOLD are split into. Changing it waits for the device to go idle.
+    void SetRecordingWorkers(uint32_t workerCount);
+    uint32_t GetRecordingWorkers() { return _recorder.GetSliceCount(); }
+    const FrameStats &GetLastFrameStats() { return _lastFrameStats; }
+    // Copies the last frame DrawFrame rendered back to the CPU, tightly packed RGBA8 rows from the top.
+    // Headless only, swapchain images aren't created for copying from. Waits for the device to go idle.
+    std::vector<uint8_t> ReadbackFrame();
+    // ReadbackFrame written as a binary PPM, which image diff tools read and which needs no image library to write.
+    void SaveFrame(const std::string &path);
+    // Builds the demo pipeline against a fresh, empty cache (cold) and then again against that now populated cache (warm).
+    // Runs at startup when ROGUE_BENCHMARK_PIPELINES is set.
+    PipelineCreationTimings BenchmarkPipelineCreation();
+    GpuProfiler &GetGpuProfiler() { return _gpuProfiler; }
 
   private:
-    const int WIDTH = 800, HEIGHT = 600, MAX_FRAMES_IN_FLIGHT = 2;
+    const int MAX_FRAMES_IN_FLIGHT = 2;
+    // Offscreen images are in a format every implementation can render to and that reads back as RGBA without swizzling.
+    const VkFormat HEADLESS_FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+    const size_t INITIAL_DRAW_LIST_CAPACITY = 1024;
+    const uint32_t INITIAL_SPRITE_CAPACITY = 8192;
+    // Below this many draws, waking the workers costs more than recording everything on this thread.
+    const size_t PARALLEL_RECORD_THRESHOLD = 512;
+    const uint32_t MAX_DEFAULT_RECORDING_WORKERS = 4;
+    const VkDeviceSize STAGING_RING_SIZE = 16 * 1024 * 1024;
+    // Starting size of each frame's region of the frame data ring, about 20k sprites. It grows if a frame needs more.
+    const VkDeviceSize FRAME_DATA_SIZE = 1024 * 1024;
+    const uint32_t MAX_GPU_SCOPES_PER_FRAME = 16;
+    // Sets in the first pool of each frame's descriptor allocator, later pools double.
+    const uint32_t FRAME_DESCRIPTOR_SETS = 64;
+    const std::string DEMO_MESH_PATH = "./assets/meshes/triangle.mesh";
 
+    RendererOptions _options;
     VkInstance _instance;
-    SDL_Window *_window;
+    SDL_Window *_window = nullptr;
     VkSurfaceKHR _mainSurface;
 
     RenderDevice::DeviceContainer _deviceInfo;
+    Memory::Allocator _allocator;
+    Upload::Uploader _uploader;
+    FrameRing _frameData;
+    AssetLoader _assetLoader;
+    DescriptorLayoutCache _descriptorLayouts;
+    TextureCache _textures;
+    MeshCache _meshes;
+    MeshCache::Handle _demoMesh = 0;
+    // Headless fills this with offscreen images and leaves swapchain VK_NULL_HANDLE, so the rest of the renderer doesn't care.
     Swapchain::SwapchainContainer _swapchainInfo;
+    std::vector<Memory::Image> _offscreenImages;
+    uint32_t _lastImageIndex = UINT32_MAX;
+    VkPipelineCache _pipelineCache;
     Pipeline::ConstructedPipeline _demoPipeline;
+    PipelineRegistry _pipelines;
+    PipelineRegistry::Handle _spritePipeline = PipelineRegistry::INVALID_HANDLE;
+    Vertex::VertexBuffer _quadVertexBuffer;
+    SpriteBatch _spriteBatch;
+    Camera2D _camera;
     SynchronizationObjects _syncObjects;
 
-    VkCommandPool _commandPool;
-    std::vector<VkCommandBuffer> _commandBuffers;
+    std::vector<FrameContext> _frames;
+    std::vector<DrawCommand> _drawList;
+    std::vector<InstanceDraw> _instanceDraws;
+    uint32_t _queuedInstances = 0;
+    ParallelRecorder _recorder;
+    std::vector<VkCommandBuffer> _secondaryBuffers;
+    FrameStats _lastFrameStats;
+    GpuProfiler _gpuProfiler;
 
     uint _currentFrame = 0;
+    // Set once the current frame's fence was waited on and its descriptor pools and frame data reset, cleared when it is submitted.
+    bool _frameBegun = false;
 
     void initVulkan();
     void createMainSurface();
+    Swapchain::SwapchainContainer createOffscreenTargets();
+    VkImageLayout attachmentFinalLayout();
     VkCommandPool createCommandPool(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, VkSurfaceKHR surface);
-    std::vector<VkCommandBuffer> createCommandBuffers(VkDevice logicalDevice, VkCommandPool commandPool, VkExtent2D extent, VkRenderPass renderPass, std::vector<VkFramebuffer> frameBuffers, Vertex::VertexBuffer vertexBuffer);
+    std::vector<FrameContext> createFrameContexts();
+    uint32_t defaultRecordingWorkers();
+    void beginFrame();
+    void recordCommandBuffer(VkCommandBuffer commandBuffer, VkFramebuffer framebuffer);
+    void recordSprites(VkCommandBuffer commandBuffer);
+    void recordDraws(VkCommandBuffer commandBuffer, size_t begin, size_t end);
+    static void recordDrawSlice(VkCommandBuffer commandBuffer, size_t begin, size_t end, void *userData);
     SynchronizationObjects createSyncObjects();
     void swapchainCleanup();
 };
@@ -0,0 +1,647 @@
+#include <vulkan/vulkan.h>
+#include <stdexcept>
+#include <algorithm>
+#include <unordered_map>
+#include <mutex>
+
+#include "shaderreflection.h"
+
+namespace
+{
+    const uint32_t SPIRV_MAGIC = 0x07230203;
+    const size_t HEADER_WORDS = 5;
+
+    // The few opcodes, decorations and enums the interface is made of, numbered as in the SPIR-V spec.
+    enum Op : uint32_t
+    {
+        OpName = 5,
+        OpEntryPoint = 15,
+        OpTypeBool = 20,
+        OpTypeInt = 21,
+        OpTypeFloat = 22,
+        OpTypeVector = 23,
+        OpTypeMatrix = 24,
+        OpTypeImage = 25,
+        OpTypeSampler = 26,
+        OpTypeSampledImage = 27,
+        OpTypeArray = 28,
+        OpTypeRuntimeArray = 29,
+        OpTypeStruct = 30,
+        OpTypePointer = 32,
+        OpConstant = 43,
+        OpVariable = 59,
+        OpDecorate = 71,
+        OpMemberDecorate = 72,
+    };
+
+    enum Decoration : uint32_t
+    {
+        DecorationBlock = 2,
+        DecorationBufferBlock = 3,
+        DecorationArrayStride = 6,
+        DecorationMatrixStride = 7,
+        DecorationBuiltIn = 11,
+        DecorationLocation = 30,
+        DecorationBinding = 33,
+        DecorationDescriptorSet = 34,
+        DecorationOffset = 35,
+    };
+
+    enum StorageClass : uint32_t
+    {
+        StorageUniformConstant = 0,
+        StorageInput = 1,
+        StorageUniform = 2,
+        StoragePushConstant = 9,
+        StorageStorageBuffer = 12,
+    };
+
+    enum ImageDim : uint32_t
+    {
+        DimBuffer = 5,
+        DimSubpassData = 6,
+    };
+
+    const uint32_t NOT_SET = UINT32_MAX;
+
+    // Everything known about one result id. Ids are dense and below the header's bound, so these live in a vector.
+    struct Id
+    {
+        uint32_t opcode = 0;
+        // Types: component / element / pointee type. Variables: pointer type. Constants: value.
+        uint32_t type = 0;
+        // Vectors: component count. Matrices: column count. Arrays: id of the length constant. Pointers and variables: storage class.
+        uint32_t count = 0;
+        uint32_t width = 0; // Scalars, in bits
+        bool isSigned = false;
+        uint32_t imageDim = 0;
+        uint32_t imageSampled = 0; // 1 sampled, 2 storage
+        std::vector<uint32_t> members;
+        std::vector<uint32_t> memberOffsets;
+        std::vector<uint32_t> memberMatrixStrides;
+        std::string name;
+
+        uint32_t location = NOT_SET;
+        uint32_t binding = NOT_SET;
+        uint32_t set = NOT_SET;
+        uint32_t arrayStride = 0;
+        bool builtIn = false;
+        bool block = false;
+        bool bufferBlock = false;
+    };
+
+    std::string readString(const uint32_t *words, size_t wordCount)
+    {
+        const char *chars = reinterpret_cast<const char *>(words);
+        size_t length = 0;
+        while (length < wordCount * sizeof(uint32_t) && chars[length] != '\0')
+        {
+            length++;
+        }
+        return std::string(chars, length);
+    }
+
+    VkShaderStageFlagBits stageFromExecutionModel(uint32_t model)
+    {
+        switch (model)
+        {
+        case 0: return VK_SHADER_STAGE_VERTEX_BIT;
+        case 1: return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+        case 2: return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+        case 3: return VK_SHADER_STAGE_GEOMETRY_BIT;
+        case 4: return VK_SHADER_STAGE_FRAGMENT_BIT;
+        case 5: return VK_SHADER_STAGE_COMPUTE_BIT;
+        default: throw std::runtime_error("SPIR-V entry point has an execution model Vulkan doesn't have.");
+        }
+    }
+
+    // Operands each handled opcode is read up to, so a truncated instruction is caught before it's indexed.
+    uint32_t minimumOperands(uint32_t opcode)
+    {
+        switch (opcode)
+        {
+        case OpName:
+        case OpTypeBool:
+        case OpTypeSampler:
+        case OpTypeStruct:
+            return 1;
+        case OpTypeFloat:
+        case OpTypeRuntimeArray:
+        case OpTypeSampledImage:
+        case OpDecorate:
+            return 2;
+        case OpEntryPoint:
+        case OpTypeInt:
+        case OpTypeVector:
+        case OpTypeMatrix:
+        case OpTypeArray:
+        case OpTypePointer:
+        case OpConstant:
+        case OpVariable:
+        case OpMemberDecorate:
+            return 3;
+        case OpTypeImage:
+            return 7;
+        default:
+            return 0;
+        }
+    }
+
+    VkFormat inputFormat(const Id &scalar, uint32_t components)
+    {
+        static const VkFormat FLOAT_FORMATS[] = {VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT};
+        static const VkFormat INT_FORMATS[] = {VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT};
+        static const VkFormat UINT_FORMATS[] = {VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT};
+        if (scalar.width != 32 || components < 1 || components > 4)
+        {
+            throw std::runtime_error("Vertex inputs have to be 32 bit scalars or vectors.");
+        }
+        if (scalar.opcode == OpTypeFloat)
+        {
+            return FLOAT_FORMATS[components - 1];
+        }
+        return scalar.isSigned ? INT_FORMATS[components - 1] : UINT_FORMATS[components - 1];
+    }
+
+    class Parser
+    {
+      public:
+        explicit Parser(const FileIOSystem::Span &spirv) : _spirv(spirv) {}
+        ShaderReflection::Module Run();
+
+      private:
+        const FileIOSystem::Span &_spirv;
+        std::vector<Id> _ids;
+        std::vector<uint32_t> _variables;
+
+        Id &id(uint32_t value);
+        void record(uint32_t opcode, const uint32_t *operands, uint32_t operandCount, ShaderReflection::Module &module);
+        uint32_t arrayLength(const Id &array);
+        uint32_t sizeOf(uint32_t type, uint32_t matrixStride);
+        void addInput(const Id &variable, ShaderReflection::Module &module);
+        void addBinding(const Id &variable, ShaderReflection::Module &module);
+    };
+
+    Id &Parser::id(uint32_t value)
+    {
+        if (value >= _ids.size())
+        {
+            throw std::runtime_error("SPIR-V id is out of the module's bound.");
+        }
+        return _ids[value];
+    }
+
+    ShaderReflection::Module Parser::Run()
+    {
+        const uint32_t *words = _spirv.Words();
+        size_t wordCount = _spirv.WordCount();
+        if (wordCount < HEADER_WORDS || words[0] != SPIRV_MAGIC)
+        {
+            throw std::runtime_error("Not a SPIR-V module, or not in host byte order.");
+        }
+        _ids.resize(words[3]);
+
+        ShaderReflection::Module module;
+        bool foundEntryPoint = false;
+        for (size_t i = HEADER_WORDS; i < wordCount;)
+        {
+            uint32_t instructionWords = words[i] >> 16;
+            uint32_t opcode = words[i] & 0xFFFF;
+            if (instructionWords == 0 || i + instructionWords > wordCount)
+            {
+                throw std::runtime_error("SPIR-V instruction runs past the end of the module.");
+            }
+            if (instructionWords - 1 < minimumOperands(opcode))
+            {
+                throw std::runtime_error("SPIR-V instruction with opcode " + std::to_string(opcode) + " is too short.");
+            }
+            if (opcode == OpEntryPoint)
+            {
+                // Modules from glslc have exactly one, a second one would need to be picked by name.
+                if (foundEntryPoint)
+                {
+                    throw std::runtime_error("SPIR-V modules with more than one entry point aren't supported.");
+                }
+                module.stage = stageFromExecutionModel(words[i + 1]);
+                foundEntryPoint = true;
+            }
+            record(opcode, words + i + 1, instructionWords - 1, module);
+            i += instructionWords;
+        }
+        if (!foundEntryPoint)
+        {
+            throw std::runtime_error("SPIR-V module has no entry point.");
+        }
+
+        // Decorations come before the types and variables they decorate, so the interface is only read once everything is known.
+        for (uint32_t variableId : _variables)
+        {
+            const Id &variable = _ids[variableId];
+            switch (variable.count)
+            {
+            case StorageInput:
+                if (module.stage == VK_SHADER_STAGE_VERTEX_BIT && !variable.builtIn && variable.location != NOT_SET)
+                {
+                    addInput(variable, module);
+                }
+                break;
+            case StoragePushConstant:
+                module.pushConstantSize = std::max(module.pushConstantSize, sizeOf(id(variable.type).type, 0));
+                break;
+            case StorageUniformConstant:
+            case StorageUniform:
+            case StorageStorageBuffer:
+                if (variable.binding != NOT_SET)
+                {
+                    addBinding(variable, module);
+                }
+                break;
+            default:
+                break;
+            }
+        }
+
+        std::sort(module.inputs.begin(), module.inputs.end(), [](const ShaderReflection::VertexInput &a, const ShaderReflection::VertexInput &b) { return a.location < b.location; });
+        std::sort(module.bindings.begin(), module.bindings.end(), [](const ShaderReflection::DescriptorBinding &a, const ShaderReflection::DescriptorBinding &b) {
+            return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+        });
+        return module;
+    }
+
+    void Parser::record(uint32_t opcode, const uint32_t *operands, uint32_t operandCount, ShaderReflection::Module &module)
+    {
+        (void)module;
+        switch (opcode)
+        {
+        case OpName:
+            id(operands[0]).name = readString(operands + 1, operandCount - 1);
+            break;
+        case OpTypeBool:
+        case OpTypeSampler:
+            id(operands[0]).opcode = opcode;
+            break;
+        case OpTypeInt:
+        case OpTypeFloat:
+        {
+            Id &type = id(operands[0]);
+            type.opcode = opcode;
+            type.width = operands[1];
+            type.isSigned = opcode == OpTypeInt && operands[2] != 0;
+            break;
+        }
+        case OpTypeVector:
+        case OpTypeMatrix:
+        case OpTypeArray:
+        {
+            Id &type = id(operands[0]);
+            type.opcode = opcode;
+            type.type = operands[1];
+            type.count = operands[2];
+            break;
+        }
+        case OpTypeRuntimeArray:
+        case OpTypeSampledImage:
+        {
+            Id &type = id(operands[0]);
+            type.opcode = opcode;
+            type.type = operands[1];
+            break;
+        }
+        case OpTypeImage:
+        {
+            Id &type = id(operands[0]);
+            type.opcode = opcode;
+            type.type = operands[1];
+            type.imageDim = operands[2];
+            type.imageSampled = operands[6];
+            break;
+        }
+        case OpTypeStruct:
+        {
+            Id &type = id(operands[0]);
+            type.opcode = opcode;
+            type.members.assign(operands + 1, operands + operandCount);
+            type.memberOffsets.resize(type.members.size(), 0);
+            type.memberMatrixStrides.resize(type.members.size(), 0);
+            break;
+        }
+        case OpTypePointer:
+        {
+            Id &type = id(operands[0]);
+            type.opcode = opcode;
+            type.count = operands[1];
+            type.type = operands[2];
+            break;
+        }
+        case OpConstant:
+        {
+            Id &constant = id(operands[1]);
+            constant.opcode = opcode;
+            constant.type = operands[2];
+            break;
+        }
+        case OpVariable:
+        {
+            Id &variable = id(operands[1]);
+            variable.opcode = opcode;
+            variable.type = operands[0];
+            variable.count = operands[2];
+            _variables.push_back(operands[1]);
+            break;
+        }
+        case OpDecorate:
+        {
+            Id &target = id(operands[0]);
+            uint32_t literal = operandCount >= 3 ? operands[2] : 0;
+            switch (operands[1])
+            {
+            case DecorationBlock: target.block = true; break;
+            case DecorationBufferBlock: target.bufferBlock = true; break;
+            case DecorationArrayStride: target.arrayStride = literal; break;
+            case DecorationBuiltIn: target.builtIn = true; break;
+            case DecorationLocation: target.location = literal; break;
+            case DecorationBinding: target.binding = literal; break;
+            case DecorationDescriptorSet: target.set = literal; break;
+            default: break;
+            }
+            break;
+        }
+        case OpMemberDecorate:
+        {
+            // Struct members are decorated before OpTypeStruct declares them, so the vectors grow as needed.
+            Id &target = id(operands[0]);
+            uint32_t member = operands[1];
+            if (target.memberOffsets.size() <= member)
+            {
+                target.memberOffsets.resize(member + 1, 0);
+                target.memberMatrixStrides.resize(member + 1, 0);
+            }
+            if (operands[2] == DecorationOffset && operandCount >= 4)
+            {
+                target.memberOffsets[member] = operands[3];
+            }
+            else if (operands[2] == DecorationMatrixStride && operandCount >= 4)
+            {
+                target.memberMatrixStrides[member] = operands[3];
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    uint32_t Parser::arrayLength(const Id &array)
+    {
+        const Id &length = id(array.count);
+        if (length.opcode != OpConstant)
+        {
+            throw std::runtime_error("Arrays sized by specialization constants aren't supported by shader reflection.");
+        }
+        return length.type;
+    }
+
+    // Size of a type as laid out in a block, with the offsets and strides the shader compiler decorated it with.
+    uint32_t Parser::sizeOf(uint32_t typeId, uint32_t matrixStride)
+    {
+        const Id &type = id(typeId);
+        switch (type.opcode)
+        {
+        case OpTypeBool:
+            return 4;
+        case OpTypeInt:
+        case OpTypeFloat:
+            return type.width / 8;
+        case OpTypeVector:
+            return sizeOf(type.type, 0) * type.count;
+        case OpTypeMatrix:
+            return (matrixStride != 0 ? matrixStride : sizeOf(type.type, 0)) * type.count;
+        case OpTypeArray:
+            return (type.arrayStride != 0 ? type.arrayStride : sizeOf(type.type, matrixStride)) * arrayLength(type);
+        case OpTypeStruct:
+        {
+            uint32_t size = 0;
+            for (size_t i = 0; i < type.members.size(); i++)
+            {
+                size = std::max(size, type.memberOffsets[i] + sizeOf(type.members[i], type.memberMatrixStrides[i]));
+            }
+            return size;
+        }
+        default:
+            throw std::runtime_error("Block member has a type shader reflection can't size.");
+        }
+    }
+
+    void Parser::addInput(const Id &variable, ShaderReflection::Module &module)
+    {
+        const Id &type = id(id(variable.type).type);
+        uint32_t columns = 1;
+        const Id *column = &type;
+        if (type.opcode == OpTypeMatrix)
+        {
+            columns = type.count;
+            column = &id(type.type);
+        }
+        const Id *scalar = column;
+        uint32_t components = 1;
+        if (column->opcode == OpTypeVector)
+        {
+            scalar = &id(column->type);
+            components = column->count;
+        }
+        if (scalar->opcode != OpTypeFloat && scalar->opcode != OpTypeInt)
+        {
+            throw std::runtime_error("Vertex input " + variable.name + " isn't a scalar, vector or matrix.");
+        }
+
+        VkFormat format = inputFormat(*scalar, components);
+        for (uint32_t i = 0; i < columns; i++)
+        {
+            module.inputs.push_back({variable.location + i, format, components * 4, variable.name});
+        }
+    }
+
+    void Parser::addBinding(const Id &variable, ShaderReflection::Module &module)
+    {
+        ShaderReflection::DescriptorBinding binding = {};
+        binding.set = variable.set == NOT_SET ? 0 : variable.set;
+        binding.binding = variable.binding;
+        binding.count = 1;
+        binding.stages = module.stage;
+        binding.name = variable.name;
+
+        const Id *type = &id(id(variable.type).type);
+        if (type->opcode == OpTypeArray)
+        {
+            binding.count = arrayLength(*type);
+            type = &id(type->type);
+        }
+        else if (type->opcode == OpTypeRuntimeArray)
+        {
+            throw std::runtime_error("Unsized descriptor array " + variable.name + " isn't supported by shader reflection.");
+        }
+
+        switch (type->opcode)
+        {
+        case OpTypeSampledImage:
+            binding.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            break;
+        case OpTypeSampler:
+            binding.type = VK_DESCRIPTOR_TYPE_SAMPLER;
+            break;
+        case OpTypeImage:
+            if (type->imageDim == DimSubpassData)
+            {
+                binding.type = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+            }
+            else if (type->imageDim == DimBuffer)
+            {
+                binding.type = type->imageSampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+            }
+            else
+            {
+                binding.type = type->imageSampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+            }
+            break;
+        case OpTypeStruct:
+            // Storage buffers are BufferBlock in the Uniform storage class before SPIR-V 1.3, StorageBuffer after.
+            binding.type = variable.count == StorageStorageBuffer || type->bufferBlock ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            if (binding.name.empty())
+            {
+                binding.name = type->name;
+            }
+            break;
+        default:
+            throw std::runtime_error("Descriptor " + variable.name + " has a type shader reflection doesn't know.");
+        }
+        module.bindings.push_back(binding);
+    }
+
+    uint64_t hashWords(const FileIOSystem::Span &spirv)
+    {
+        // FNV-1a over whole words, shaders are a few KB so this is far cheaper than parsing them again.
+        uint64_t hash = 14695981039346656037ull;
+        const uint32_t *words = spirv.Words();
+        for (size_t i = 0; i < spirv.WordCount(); i++)
+        {
+            hash ^= words[i];
+            hash *= 1099511628211ull;
+        }
+        return hash ^ spirv.size;
+    }
+
+    std::mutex reflectionCacheMutex;
+    std::unordered_map<uint64_t, std::shared_ptr<const ShaderReflection::Module>> reflectionCache;
+}
+
+ShaderReflection::Module ShaderReflection::Parse(const FileIOSystem::Span &spirv)
+{
+    if (spirv.size % sizeof(uint32_t) != 0 || reinterpret_cast<uintptr_t>(spirv.data) % alignof(uint32_t) != 0)
+    {
+        throw std::runtime_error("Shader code has to be a 4 byte aligned run of 32 bit words.");
+    }
+    Module module = Parser(spirv).Run();
+    module.hash = hashWords(spirv);
+    return module;
+}
+
+std::shared_ptr<const ShaderReflection::Module> ShaderReflection::Reflect(const FileIOSystem::Span &spirv)
+{
+    uint64_t hash = hashWords(spirv);
+    {
+        std::lock_guard<std::mutex> lock(reflectionCacheMutex);
+        auto found = reflectionCache.find(hash);
+        if (found != reflectionCache.end())
+        {
+            return found->second;
+        }
+    }
+    // Parsed outside the lock, two threads racing on the same new shader both parse it and the first one wins.
+    std::shared_ptr<const Module> module = std::make_shared<const Module>(Parse(spirv));
+    std::lock_guard<std::mutex> lock(reflectionCacheMutex);
+    return reflectionCache.emplace(hash, module).first->second;
+}
+
+std::shared_ptr<const ShaderReflection::Module> ShaderReflection::ReflectFile(const std::string &path)
+{
+    std::shared_ptr<const FileIOSystem::FileView> file = FileIOSystem::OpenFile(path);
+    return Reflect(file->GetSpan());
+}
+
+std::vector<ShaderReflection::DescriptorBinding> ShaderReflection::MergeBindings(const Module &vertex, const Module &fragment)
+{
+    std::vector<DescriptorBinding> merged = vertex.bindings;
+    for (const DescriptorBinding &binding : fragment.bindings)
+    {
+        auto same = std::find_if(merged.begin(), merged.end(), [&binding](const DescriptorBinding &other) { return other.set == binding.set && other.binding == binding.binding; });
+        if (same == merged.end())
+        {
+            merged.push_back(binding);
+        }
+        else if (same->type != binding.type || same->count != binding.count)
+        {
+            throw std::runtime_error("Shader stages disagree about set " + std::to_string(binding.set) + " binding " + std::to_string(binding.binding) + ".");
+        }
+        else
+        {
+            same->stages |= binding.stages;
+        }
+    }
+    std::sort(merged.begin(), merged.end(), [](const DescriptorBinding &a, const DescriptorBinding &b) { return a.set != b.set ? a.set < b.set : a.binding < b.binding; });
+    return merged;
+}
+
+std::vector<VkPushConstantRange> ShaderReflection::CreatePushConstantRanges(const Module &vertex, const Module &fragment)
+{
+    // Draws push their whole block once with every stage's flag, which is only valid when each pushed byte lies in
+    // a range covering all of those stages. Separate per-stage ranges of different sizes would break that.
+    // https://docs.vulkan.org/spec/latest/chapters/descriptorsets.html#vkCmdPushConstants
+    VkPushConstantRange range = {0, 0, 0};
+    for (const Module *module : {&vertex, &fragment})
+    {
+        if (module->pushConstantSize > 0)
+        {
+            range.stageFlags |= static_cast<VkShaderStageFlags>(module->stage);
+            range.size = std::max(range.size, module->pushConstantSize);
+        }
+    }
+    if (range.size == 0)
+    {
+        return {};
+    }
+    return {range};
+}
+
+std::vector<VkDescriptorSetLayout> ShaderReflection::CreateSetLayouts(const std::vector<DescriptorBinding> &bindings, DescriptorLayoutCache &layoutCache)
+{
+    std::vector<VkDescriptorSetLayout> layouts;
+    if (bindings.empty())
+    {
+        return layouts;
+    }
+    uint32_t setCount = 0;
+    for (const DescriptorBinding &binding : bindings)
+    {
+        setCount = std::max(setCount, binding.set + 1);
+    }
+
+    std::vector<VkDescriptorSetLayoutBinding> setBindings;
+    for (uint32_t set = 0; set < setCount; set++)
+    {
+        setBindings.clear();
+        for (const DescriptorBinding &binding : bindings)
+        {
+            if (binding.set == set)
+            {
+                VkDescriptorSetLayoutBinding layoutBinding = {};
+                layoutBinding.binding = binding.binding;
+                layoutBinding.descriptorType = binding.type;
+                layoutBinding.descriptorCount = binding.count;
+                layoutBinding.stageFlags = binding.stages;
+                setBindings.push_back(layoutBinding);
+            }
+        }
+        layouts.push_back(layoutCache.Get(setBindings.data(), static_cast<uint32_t>(setBindings.size())));
+    }
+    return layouts;
+}
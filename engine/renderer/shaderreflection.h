@@ -0,0 +1,66 @@
+#ifndef SHADER_REFLECTION_H
+#define SHADER_REFLECTION_H
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdint>
+
+#include "descriptors.h"
+#include "../systems/fileio.h"
+
+// Reads what a SPIR-V module expects from the pipeline straight out of its bytecode: vertex inputs, descriptor
+// bindings and push constants, so none of that has to be written down by hand next to the shader.
+// Only the handful of instructions that describe the interface are looked at, everything else is skipped.
+// https://registry.khronos.org/SPIR-V/specs/unified1/SPIRV.html#_physical_layout_of_a_spir_v_module_and_instruction
+namespace ShaderReflection
+{
+    // A `layout(location = n) in` of the vertex stage. Matrices take one location per column.
+    struct VertexInput
+    {
+        uint32_t location;
+        VkFormat format; // The 32 bit format matching the shader type, e.g. vec3 is R32G32B32_SFLOAT
+        uint32_t size;   // Bytes of format
+        std::string name;
+    };
+
+    struct DescriptorBinding
+    {
+        uint32_t set;
+        uint32_t binding;
+        VkDescriptorType type;
+        uint32_t count; // Array length, 1 for a single descriptor
+        VkShaderStageFlags stages;
+        std::string name;
+    };
+
+    struct Module
+    {
+        uint64_t hash = 0;
+        VkShaderStageFlagBits stage = VK_SHADER_STAGE_VERTEX_BIT;
+        std::vector<VertexInput> inputs; // Vertex stage only, sorted by location, built-ins left out
+        std::vector<DescriptorBinding> bindings; // Sorted by set, then binding
+        uint32_t pushConstantSize = 0; // Bytes up to the end of the last member, 0 without a push constant block
+    };
+
+    // Throws if the bytes aren't a SPIR-V module, or use something reflection doesn't understand (like unsized
+    // descriptor arrays). No Vulkan calls, safe from any thread.
+    Module Parse(const FileIOSystem::Span &spirv);
+    // Parse, cached by a hash of the bytecode, so the same shader is only ever parsed once however many pipelines
+    // and paths it is loaded through. The result is shared and immutable. Safe from any thread.
+    std::shared_ptr<const Module> Reflect(const FileIOSystem::Span &spirv);
+    std::shared_ptr<const Module> ReflectFile(const std::string &path);
+
+    // Merges the stages' bindings, a binding both stages use is visible to both.
+    // Throws if two stages disagree about a binding's type or count.
+    std::vector<DescriptorBinding> MergeBindings(const Module &vertex, const Module &fragment);
+    // One range at offset 0, as big as the largest stage's block and visible to every stage that has one, so a
+    // single vkCmdPushConstants with all of those stages is valid. Empty when no stage uses push constants.
+    std::vector<VkPushConstantRange> CreatePushConstantRanges(const Module &vertex, const Module &fragment);
+    // Set i of the result is set i of the shaders. Sets the shaders skip get an empty layout, which Vulkan requires.
+    // Every layout comes from layoutCache, so pipelines with matching sets share layouts and stay compatible.
+    std::vector<VkDescriptorSetLayout> CreateSetLayouts(const std::vector<DescriptorBinding> &bindings, DescriptorLayoutCache &layoutCache);
+}
+
+#endif
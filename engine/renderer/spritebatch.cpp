@@ -0,0 +1,83 @@
+#include <vulkan/vulkan.h>
+#include <algorithm>
+
+#include "spritebatch.h"
+
+void SpriteBatch::Init(uint32_t framesInFlight, uint32_t initialCapacity)
+{
+    _instances.resize(framesInFlight);
+    _uploadedCounts = std::vector<uint32_t>(framesInFlight, 0);
+    _runs.resize(framesInFlight);
+    _sprites.reserve(initialCapacity);
+}
+
+uint32_t SpriteBatch::Upload(uint32_t frame, FrameRing &ring)
+{
+    // Blending needs back to front order. Sprites are usually queued layer by layer already, so check before sorting.
+    // stable_sort keeps submission order within a layer, which is the draw order callers expect. That also means
+    // sprites aren't regrouped by texture, a new run starts wherever the texture changes in that order.
+    auto byLayer = [](const QueuedSprite &a, const QueuedSprite &b) { return a.instance.layer < b.instance.layer; };
+    if (!std::is_sorted(_sprites.begin(), _sprites.end(), byLayer))
+    {
+        std::stable_sort(_sprites.begin(), _sprites.end(), byLayer);
+    }
+
+    uint32_t count = static_cast<uint32_t>(_sprites.size());
+    // Host coherent, so the writes are visible to the submit that follows without a flush.
+    _instances[frame] = ring.Allocate(sizeof(Vertex::SpriteInstance) * count, alignof(Vertex::SpriteInstance));
+    Vertex::SpriteInstance *instances = static_cast<Vertex::SpriteInstance *>(_instances[frame].data);
+    std::vector<Run> &runs = _runs[frame];
+    runs.clear();
+    for (uint32_t i = 0; i < count; i++)
+    {
+        instances[i] = _sprites[i].instance;
+        if (runs.empty() || runs.back().texture != _sprites[i].texture)
+        {
+            runs.push_back({_sprites[i].texture, i, 0});
+        }
+        runs.back().count += 1;
+    }
+    _uploadedCounts[frame] = count;
+    _sprites.clear();
+    return count;
+}
+
+void SpriteBatch::Record(VkCommandBuffer commandBuffer, uint32_t frame, const Memory::Buffer &quad, VkPipelineLayout layout, VkDescriptorSet boundTexture)
+{
+    for (const Run &run : _runs[frame])
+    {
+        if (run.texture != boundTexture)
+        {
+            BindTexture(commandBuffer, layout, run.texture);
+            boundTexture = run.texture;
+        }
+        DrawInstances(commandBuffer, quad, _instances[frame].buffer, _instances[frame].offset + sizeof(Vertex::SpriteInstance) * run.first, run.count);
+    }
+}
+
+void SpriteBatch::BindPipeline(VkCommandBuffer commandBuffer, const Pipeline::ConstructedPipeline &pipeline, const Memory::Buffer &quad, const Camera2D &camera, const VkExtent2D &extent)
+{
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.pipeline);
+    Pipeline::SetViewportAndScissor(commandBuffer, extent);
+
+    // Clip space spans 2 units across the screen, so a world unit is 2 * pixelsPerUnit / extent of it.
+    Pipeline::CameraConstants cameraConstants;
+    cameraConstants.scale = glm::vec2(2.0f * camera.pixelsPerUnit / extent.width, 2.0f * camera.pixelsPerUnit / extent.height);
+    cameraConstants.offset = glm::vec2(-camera.position.x * cameraConstants.scale.x, -camera.position.y * cameraConstants.scale.y);
+    vkCmdPushConstants(commandBuffer, pipeline.layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(cameraConstants), &cameraConstants);
+
+    VkDeviceSize quadOffset = 0;
+    vkCmdBindVertexBuffers(commandBuffer, Vertex::VERTEX_BINDING, 1, &quad.buffer, &quadOffset);
+}
+
+void SpriteBatch::BindTexture(VkCommandBuffer commandBuffer, VkPipelineLayout layout, VkDescriptorSet texture)
+{
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0, 1, &texture, 0, nullptr);
+}
+
+void SpriteBatch::DrawInstances(VkCommandBuffer commandBuffer, const Memory::Buffer &quad, VkBuffer instanceBuffer, VkDeviceSize offset, uint32_t instanceCount)
+{
+    // Only the instance binding changes between draws, the quad stays bound.
+    vkCmdBindVertexBuffers(commandBuffer, Vertex::INSTANCE_BINDING, 1, &instanceBuffer, &offset);
+    vkCmdDraw(commandBuffer, static_cast<uint32_t>(quad.size / sizeof(Vertex::Vertex)), instanceCount, 0, 0);
+}
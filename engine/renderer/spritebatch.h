@@ -0,0 +1,74 @@
+#ifndef SPRITEBATCH_H
+#define SPRITEBATCH_H
+
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+
+#include "memory.h"
+#include "framering.h"
+#include "vertex.h"
+#include "pipeline.h"
+
+// World units to pixels, the camera position ends up in the middle of the screen. World y points down like screen y.
+struct Camera2D {
+  glm::vec2 position = glm::vec2(0.0f, 0.0f);
+  float pixelsPerUnit = 16.0f;
+};
+
+// Collects sprites during the frame and draws them with instanced draws of the unit quad, one per run of sprites
+// that share a texture. With sprites packed into a few atlas pages (see AtlasBuilder) that is a handful of draws.
+// Instances are written straight into the frame's region of a FrameRing, which is only reused once the frame's
+// fence has signaled, so the GPU never reads instance data that is being rewritten.
+class SpriteBatch
+{
+  public:
+    void Init(uint32_t framesInFlight, uint32_t initialCapacity);
+
+    // Queues a sprite for the next Upload, drawn with texture's descriptor set (see TextureCache::GetDescriptorSet).
+    // The queue keeps its capacity between frames.
+    void Add(const Vertex::SpriteInstance &sprite, VkDescriptorSet texture) { _sprites.push_back({sprite, texture}); }
+    void Clear() { _sprites.clear(); }
+    uint32_t GetQueuedCount() { return static_cast<uint32_t>(_sprites.size()); }
+
+    // Orders the queue by layer and copies it into ring, which has to be in frame's BeginFrame.
+    // Empties the queue and returns the number of sprites written.
+    uint32_t Upload(uint32_t frame, FrameRing &ring);
+    uint32_t GetUploadedCount(uint32_t frame) { return _uploadedCounts[frame]; }
+    // Draws Record(frame) issues, one per texture change in layer order.
+    uint32_t GetDrawCount(uint32_t frame) { return static_cast<uint32_t>(_runs[frame].size()); }
+    // Records everything the last Upload(frame) wrote. The sprite pipeline has to be bound with BindPipeline.
+    // boundTexture is the set already bound at set 0, if any, so the first draw can skip binding it again.
+    // Safe to call from any thread.
+    void Record(VkCommandBuffer commandBuffer, uint32_t frame, const Memory::Buffer &quad, VkPipelineLayout layout, VkDescriptorSet boundTexture = VK_NULL_HANDLE);
+
+    // Binds the sprite pipeline, its dynamic state, the camera and the quad. Shared by every instanced sprite draw in a command buffer.
+    static void BindPipeline(VkCommandBuffer commandBuffer, const Pipeline::ConstructedPipeline &pipeline, const Memory::Buffer &quad, const Camera2D &camera, const VkExtent2D &extent);
+    // Binds texture at set 0 for the draws that follow.
+    static void BindTexture(VkCommandBuffer commandBuffer, VkPipelineLayout layout, VkDescriptorSet texture);
+    // Draws instanceCount sprites read from instanceBuffer at offset, with the pipeline from BindPipeline.
+    static void DrawInstances(VkCommandBuffer commandBuffer, const Memory::Buffer &quad, VkBuffer instanceBuffer, VkDeviceSize offset, uint32_t instanceCount);
+
+  private:
+    struct QueuedSprite
+    {
+        Vertex::SpriteInstance instance;
+        VkDescriptorSet texture;
+    };
+
+    // Consecutive instances in the frame's buffer that are drawn with the same texture.
+    struct Run
+    {
+        VkDescriptorSet texture;
+        uint32_t first;
+        uint32_t count;
+    };
+
+    std::vector<FrameRing::Slice> _instances;
+    std::vector<uint32_t> _uploadedCounts;
+    std::vector<std::vector<Run>> _runs;
+    std::vector<QueuedSprite> _sprites;
+};
+
+#endif
\ No newline at end of file
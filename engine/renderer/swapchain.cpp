@@ -1,6 +1,7 @@
 #include <iostream>
 #include <vector>
 #include <algorithm>
+#include <limits>
 #include <set>
 #include <vulkan/vulkan.h>
 #include <SDL2/SDL.h>
@@ -160,7 +161,7 @@ Swapchain::SwapchainContainer Swapchain::CreateSwapchain(SDL_Window *window, VkP
 
     QueueFamily::QueueFamilyIndices queueFamilyIndices = QueueFamily::findQueueFamilies(physicalDevice, surface);
     std::set<uint32_t> queueFamilyIndicesSet;
-    // TODO:  If more indices are added to the struct they need to be added here too.  Improve this.
+    // Only the families that touch swapchain images belong here. The transfer and compute families never do.
     queueFamilyIndicesSet.insert((uint32_t)queueFamilyIndices.graphicsFamily);
     queueFamilyIndicesSet.insert((uint32_t)queueFamilyIndices.presentFamily);
 
@@ -0,0 +1,244 @@
+#include <vulkan/vulkan.h>
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+
+#include "texture.h"
+
+void TextureCache::Init(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, Memory::Allocator &allocator, Upload::Uploader &uploader, DescriptorLayoutCache &layoutCache)
+{
+    _physicalDevice = physicalDevice;
+    _logicalDevice = logicalDevice;
+    _allocator = &allocator;
+    _uploader = &uploader;
+
+    // Mips are blitted with linear filtering, which RGBA8 UNORM supports almost everywhere, but it isn't guaranteed.
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, TEXTURE_FORMAT, &formatProperties);
+    VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    _canBlitMips = (formatProperties.optimalTilingFeatures & blitFeatures) == blitFeatures;
+    if (!_canBlitMips)
+    {
+        std::cout << "Texture format can't be blitted with linear filtering, textures get no mips" << std::endl;
+    }
+
+    VkDescriptorSetLayoutBinding binding = {};
+    binding.binding = 0;
+    binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    binding.descriptorCount = 1;
+    binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    _setLayout = layoutCache.Get(&binding, 1);
+    // Sets are never freed, a destroyed texture's set is rewritten for the next one.
+    _descriptorAllocator.Init(logicalDevice, INITIAL_SETS_PER_POOL);
+
+    ImageFile::Pixels white;
+    white.width = 1;
+    white.height = 1;
+    white.rgba = {255, 255, 255, 255};
+    TextureOptions whiteOptions;
+    whiteOptions.generateMips = false;
+    if (Create(white, whiteOptions) != WHITE)
+    {
+        throw std::runtime_error("The white texture has to be the first one.");
+    }
+}
+
+void TextureCache::Cleanup()
+{
+    for (Texture &texture : _textures)
+    {
+        if (texture.view != VK_NULL_HANDLE)
+        {
+            vkDestroyImageView(_logicalDevice, texture.view, nullptr);
+            _allocator->DestroyImage(texture.image);
+        }
+    }
+    _textures.clear();
+    _freeHandles.clear();
+    _pathLookup.clear();
+    for (SamplerEntry &entry : _samplers)
+    {
+        vkDestroySampler(_logicalDevice, entry.sampler, nullptr);
+    }
+    _samplers.clear();
+    // Destroying the pools frees every set allocated from them. The layout belongs to the layout cache.
+    _descriptorAllocator.Cleanup();
+}
+
+TextureCache::Handle TextureCache::Create(const ImageFile::Pixels &pixels, const TextureOptions &options)
+{
+    if (pixels.width == 0 || pixels.height == 0 || pixels.rgba.size() != static_cast<size_t>(pixels.width) * pixels.height * TEXEL_SIZE)
+    {
+        throw std::runtime_error("Texture pixels don't match their size.");
+    }
+
+    // Every level halves the larger side until it is 1 texel.
+    uint32_t mipLevels = 1;
+    if (options.generateMips && _canBlitMips)
+    {
+        uint32_t largest = std::max(pixels.width, pixels.height);
+        while (largest > 1)
+        {
+            largest /= 2;
+            mipLevels++;
+        }
+    }
+
+    // Capped for textures whose neighbouring texels shouldn't blend, like atlas pages.
+    if (options.maxMipLevels > 0)
+    {
+        mipLevels = std::min(mipLevels, options.maxMipLevels);
+    }
+    VkSampler sampler = GetSampler(options);
+
+    // The handle is only taken once the image and its view exist, so a failure here doesn't leak a slot.
+    Texture created;
+    created.width = pixels.width;
+    created.height = pixels.height;
+    created.mipLevels = mipLevels;
+
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = TEXTURE_FORMAT;
+    imageInfo.extent = {pixels.width, pixels.height, 1};
+    imageInfo.mipLevels = mipLevels;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    // TRANSFER_SRC because every level but the last is the source of the blit into the next.
+    imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    created.image = _allocator->CreateImage(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    VkImageViewCreateInfo viewInfo = {};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = created.image.image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = TEXTURE_FORMAT;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.levelCount = mipLevels;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = 1;
+    if (vkCreateImageView(_logicalDevice, &viewInfo, nullptr, &created.view) != VkResult::VK_SUCCESS)
+    {
+        _allocator->DestroyImage(created.image);
+        throw std::runtime_error("Failed to create texture image view.");
+    }
+
+    Handle handle;
+    try
+    {
+        handle = allocateHandle();
+    }
+    catch (...)
+    {
+        vkDestroyImageView(_logicalDevice, created.view, nullptr);
+        _allocator->DestroyImage(created.image);
+        throw;
+    }
+    // A reused slot keeps its descriptor set.
+    Texture &texture = _textures[handle];
+    created.descriptorSet = texture.descriptorSet;
+    texture = created;
+
+    _uploader->EnqueueImage(texture.image.image, pixels.width, pixels.height, mipLevels, TEXEL_SIZE, pixels.rgba.data());
+
+    VkDescriptorImageInfo descriptorImage = {};
+    descriptorImage.sampler = sampler;
+    descriptorImage.imageView = texture.view;
+    descriptorImage.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    VkWriteDescriptorSet write = {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = texture.descriptorSet;
+    write.dstBinding = 0;
+    write.dstArrayElement = 0;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.descriptorCount = 1;
+    write.pImageInfo = &descriptorImage;
+    vkUpdateDescriptorSets(_logicalDevice, 1, &write, 0, nullptr);
+    return handle;
+}
+
+TextureCache::Handle TextureCache::Load(const std::string &path, const TextureOptions &options)
+{
+    auto found = _pathLookup.find(path);
+    if (found != _pathLookup.end())
+    {
+        return found->second;
+    }
+    Handle handle = Create(ImageFile::Load(path), options);
+    _textures[handle].path = path;
+    _pathLookup.emplace(path, handle);
+    return handle;
+}
+
+void TextureCache::Destroy(Handle texture)
+{
+    if (texture == WHITE || texture >= _textures.size() || _textures[texture].view == VK_NULL_HANDLE)
+    {
+        return;
+    }
+    Texture &destroyed = _textures[texture];
+    vkDestroyImageView(_logicalDevice, destroyed.view, nullptr);
+    _allocator->DestroyImage(destroyed.image);
+    destroyed.view = VK_NULL_HANDLE;
+    if (!destroyed.path.empty())
+    {
+        _pathLookup.erase(destroyed.path);
+        destroyed.path.clear();
+    }
+    _freeHandles.push_back(texture);
+}
+
+VkSampler TextureCache::GetSampler(const TextureOptions &options)
+{
+    // A texture without mips only ever reads level 0, so the mipmap mode only matters for the ones that have them.
+    VkSamplerMipmapMode mipmapMode = options.minFilter == VK_FILTER_LINEAR ? VK_SAMPLER_MIPMAP_MODE_LINEAR : VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    for (const SamplerEntry &entry : _samplers)
+    {
+        if (entry.magFilter == options.magFilter && entry.minFilter == options.minFilter && entry.mipmapMode == mipmapMode && entry.addressMode == options.addressMode)
+        {
+            return entry.sampler;
+        }
+    }
+
+    VkSamplerCreateInfo samplerInfo = {};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = options.magFilter;
+    samplerInfo.minFilter = options.minFilter;
+    samplerInfo.mipmapMode = mipmapMode;
+    samplerInfo.addressModeU = options.addressMode;
+    samplerInfo.addressModeV = options.addressMode;
+    samplerInfo.addressModeW = options.addressMode;
+    samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK;
+    samplerInfo.unnormalizedCoordinates = VK_FALSE;
+    samplerInfo.compareEnable = VK_FALSE;
+    samplerInfo.anisotropyEnable = VK_FALSE;
+    samplerInfo.minLod = 0.0f;
+    // Clamped to each image's own level count, so one sampler serves textures with any number of mips.
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+    SamplerEntry entry = {options.magFilter, options.minFilter, mipmapMode, options.addressMode, VK_NULL_HANDLE};
+    if (vkCreateSampler(_logicalDevice, &samplerInfo, nullptr, &entry.sampler) != VkResult::VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create texture sampler.");
+    }
+    _samplers.push_back(entry);
+    return entry.sampler;
+}
+
+TextureCache::Handle TextureCache::allocateHandle()
+{
+    if (!_freeHandles.empty())
+    {
+        Handle handle = _freeHandles.back();
+        _freeHandles.pop_back();
+        return handle;
+    }
+    Texture texture;
+    texture.descriptorSet = _descriptorAllocator.Allocate(_setLayout);
+    _textures.push_back(texture);
+    return static_cast<Handle>(_textures.size() - 1);
+}
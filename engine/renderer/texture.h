@@ -0,0 +1,107 @@
+#ifndef TEXTURE_H
+#define TEXTURE_H
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <cstdint>
+
+#include "memory.h"
+#include "upload.h"
+#include "descriptors.h"
+#include "../systems/imagefile.h"
+
+// How a texture is sampled and whether it gets mips. Textures created with the same options share a sampler.
+struct TextureOptions {
+  // Pixel art wants NEAREST magnification, and LINEAR minification with mips once it is zoomed out.
+  VkFilter magFilter = VK_FILTER_NEAREST;
+  VkFilter minFilter = VK_FILTER_LINEAR;
+  VkSamplerAddressMode addressMode = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  // Builds the whole mip chain on the GPU. Ignored on devices that can't blit the format with linear filtering.
+  bool generateMips = true;
+  // Stops the chain after this many levels, 0 builds it down to 1x1.
+  uint32_t maxMipLevels = 0;
+};
+
+// Owns every sampled image, the samplers they are read with and one descriptor set per texture.
+// A texture's set never changes after it is written, so drawing with a texture is a single vkCmdBindDescriptorSets
+// and nothing is allocated or written per frame. The sets come from the cache's own DescriptorAllocator, which is
+// never reset, so there is no fixed limit on the number of textures.
+// Samplers are shared: textures created with the same options get the same VkSampler, and there are only ever a
+// handful of them.
+// Images are RGBA8 UNORM, so texels reach the shader as authored, the same as vertex colors do.
+// https://vulkan-tutorial.com/Texture_mapping/Combined_image_sampler
+class TextureCache
+{
+  public:
+    using Handle = uint32_t;
+
+    // 1x1 opaque white, for drawing untextured sprites with the textured pipeline. Always valid after Init.
+    static constexpr Handle WHITE = 0;
+
+    // The set layout comes from layoutCache, so any other set with one fragment stage sampler at binding 0 shares it.
+    void Init(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, Memory::Allocator &allocator, Upload::Uploader &uploader, DescriptorLayoutCache &layoutCache);
+    void Cleanup();
+
+    // Queues the pixels on the uploader, they are ready to sample once its next Flush() has executed. DrawFrame
+    // flushes ahead of the frame's draws, so a texture can be drawn with in the frame it was created in.
+    Handle Create(const ImageFile::Pixels &pixels, const TextureOptions &options = TextureOptions());
+    // Loads through ImageFile::Load. Loading a path again returns the texture it was first loaded into.
+    Handle Load(const std::string &path, const TextureOptions &options = TextureOptions());
+    // Only once no frame in flight samples the texture anymore, see Renderer::WaitIdle. The handle may be reused.
+    void Destroy(Handle texture);
+
+    // Set 0 of every pipeline that samples a texture: one combined image sampler at binding 0, in the fragment stage.
+    VkDescriptorSetLayout GetDescriptorSetLayout() { return _setLayout; }
+    VkDescriptorSet GetDescriptorSet(Handle texture) { return _textures[texture].descriptorSet; }
+    uint32_t GetWidth(Handle texture) { return _textures[texture].width; }
+    uint32_t GetHeight(Handle texture) { return _textures[texture].height; }
+    uint32_t GetMipLevels(Handle texture) { return _textures[texture].mipLevels; }
+    uint32_t GetTextureCount() { return static_cast<uint32_t>(_textures.size() - _freeHandles.size()); }
+    // Shared between every texture created with the same filters and address mode, owned by the cache.
+    VkSampler GetSampler(const TextureOptions &options);
+
+  private:
+    const VkFormat TEXTURE_FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+    static constexpr uint32_t TEXEL_SIZE = 4;
+    const uint32_t INITIAL_SETS_PER_POOL = 64;
+
+    struct Texture
+    {
+        Memory::Image image;
+        VkImageView view = VK_NULL_HANDLE;
+        // Kept when the texture is destroyed, a reused handle writes its new image into the same set.
+        VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t mipLevels = 0;
+        std::string path;
+    };
+
+    struct SamplerEntry
+    {
+        VkFilter magFilter;
+        VkFilter minFilter;
+        VkSamplerMipmapMode mipmapMode;
+        VkSamplerAddressMode addressMode;
+        VkSampler sampler;
+    };
+
+    VkPhysicalDevice _physicalDevice = VK_NULL_HANDLE;
+    VkDevice _logicalDevice = VK_NULL_HANDLE;
+    Memory::Allocator *_allocator = nullptr;
+    Upload::Uploader *_uploader = nullptr;
+    VkDescriptorSetLayout _setLayout = VK_NULL_HANDLE;
+    DescriptorAllocator _descriptorAllocator;
+    bool _canBlitMips = false;
+
+    std::vector<Texture> _textures;
+    std::vector<Handle> _freeHandles;
+    std::vector<SamplerEntry> _samplers;
+    std::unordered_map<std::string, Handle> _pathLookup;
+
+    Handle allocateHandle();
+};
+
+#endif
@@ -0,0 +1,687 @@
+#include <vulkan/vulkan.h>
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+#include <limits>
+#include <cstring>
+
+#include "upload.h"
+
+void Upload::Uploader::Init(Memory::Allocator &allocator, VkDevice logicalDevice, uint32_t queueFamily, VkQueue queue, VkDeviceSize ringSize, int transferFamily, VkQueue transferQueue)
+{
+    _allocator = &allocator;
+    _logicalDevice = logicalDevice;
+    _queue = queue;
+    _queueFamily = queueFamily;
+
+    VkCommandPoolCreateInfo commandPoolInfo = {};
+    commandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    // Upload command buffers are short lived and re-recorded every batch.
+    commandPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    commandPoolInfo.queueFamilyIndex = queueFamily;
+    if (vkCreateCommandPool(logicalDevice, &commandPoolInfo, nullptr, &_commandPool) != VkResult::VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create upload command pool.");
+    }
+
+    std::vector<uint32_t> ringFamilies = {queueFamily};
+    if (transferFamily >= 0 && transferQueue != VK_NULL_HANDLE && static_cast<uint32_t>(transferFamily) != queueFamily)
+    {
+        _transferQueue = transferQueue;
+        _transferFamily = static_cast<uint32_t>(transferFamily);
+        commandPoolInfo.queueFamilyIndex = _transferFamily;
+        if (vkCreateCommandPool(logicalDevice, &commandPoolInfo, nullptr, &_transferCommandPool) != VkResult::VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create transfer command pool.");
+        }
+        // Both queues read the ring. It is only ever written by the host, so sharing it costs nothing.
+        ringFamilies.push_back(_transferFamily);
+        std::cout << "Uploading on dedicated transfer queue family " << _transferFamily << std::endl;
+    }
+
+    _ring = allocator.CreateBuffer(ringSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, ringFamilies);
+    _pendingCopies.reserve(256);
+    _pendingTransferCopies.reserve(256);
+    _pendingImageCopies.reserve(64);
+    _regionScratch.reserve(256);
+    _trimScratch.reserve(256);
+    _barrierScratch.reserve(256);
+}
+
+void Upload::Uploader::Cleanup()
+{
+    WaitIdle();
+    for (Batch &batch : _batches)
+    {
+        vkDestroyFence(_logicalDevice, batch.fence, nullptr);
+        vkDestroyFence(_logicalDevice, batch.transferFence, nullptr);
+    }
+    _batches.clear();
+    // Destroying the pool frees every command buffer allocated from it.
+    vkDestroyCommandPool(_logicalDevice, _commandPool, nullptr);
+    vkDestroyCommandPool(_logicalDevice, _transferCommandPool, nullptr);
+    _transferCommandPool = VK_NULL_HANDLE;
+    _transferQueue = VK_NULL_HANDLE;
+    _allocator->DestroyBuffer(_ring);
+}
+
+Upload::Ticket Upload::Uploader::Enqueue(VkBuffer destination, VkDeviceSize destinationOffset, const void *data, VkDeviceSize size)
+{
+    return enqueue(_pendingCopies, destination, destinationOffset, data, size);
+}
+
+Upload::Ticket Upload::Uploader::EnqueueAsync(VkBuffer destination, VkDeviceSize destinationOffset, const void *data, VkDeviceSize size)
+{
+    return enqueue(HasTransferQueue() ? _pendingTransferCopies : _pendingCopies, destination, destinationOffset, data, size);
+}
+
+Upload::Ticket Upload::Uploader::enqueue(std::vector<PendingCopy> &copies, VkBuffer destination, VkDeviceSize destinationOffset, const void *data, VkDeviceSize size)
+{
+    // Anything bigger than half the ring goes through in pieces so it can never deadlock waiting for itself.
+    VkDeviceSize maxChunk = _ring.size / 2;
+    const char *source = static_cast<const char *>(data);
+    while (size > 0)
+    {
+        VkDeviceSize chunk = std::min(size, maxChunk);
+        VkDeviceSize ringOffset = allocateRing(chunk);
+        memcpy(static_cast<char *>(_ring.allocation.mapped) + ringOffset, source, (size_t)chunk);
+
+        PendingCopy copy = {};
+        copy.destination = destination;
+        copy.region.srcOffset = ringOffset;
+        copy.region.dstOffset = destinationOffset;
+        copy.region.size = chunk;
+        copies.push_back(copy);
+
+        source += chunk;
+        destinationOffset += chunk;
+        size -= chunk;
+    }
+    return _nextTicket;
+}
+
+Upload::Ticket Upload::Uploader::EnqueueImage(VkImage destination, uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t texelSize, const void *data)
+{
+    // Split into bands of whole rows, so a band is still one rectangle of the image.
+    VkDeviceSize rowSize = static_cast<VkDeviceSize>(width) * texelSize;
+    VkDeviceSize maxChunk = _ring.size / 2;
+    if (rowSize > maxChunk)
+    {
+        throw std::runtime_error("Image rows are too wide for the upload ring.");
+    }
+    uint32_t rowsPerChunk = static_cast<uint32_t>(std::min<VkDeviceSize>(maxChunk / rowSize, height));
+    const char *source = static_cast<const char *>(data);
+    for (uint32_t row = 0; row < height; row += rowsPerChunk)
+    {
+        uint32_t rows = std::min(rowsPerChunk, height - row);
+        VkDeviceSize chunk = rowSize * rows;
+        VkDeviceSize ringOffset = allocateRing(chunk);
+        memcpy(static_cast<char *>(_ring.allocation.mapped) + ringOffset, source, (size_t)chunk);
+
+        PendingImageCopy copy = {};
+        copy.destination = destination;
+        // Row length and image height of 0 mean the texels are tightly packed.
+        copy.region.bufferOffset = ringOffset;
+        copy.region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        copy.region.imageSubresource.mipLevel = 0;
+        copy.region.imageSubresource.baseArrayLayer = 0;
+        copy.region.imageSubresource.layerCount = 1;
+        copy.region.imageOffset = {0, static_cast<int32_t>(row), 0};
+        copy.region.imageExtent = {width, rows, 1};
+        copy.width = width;
+        copy.height = height;
+        copy.mipLevels = mipLevels;
+        copy.first = row == 0;
+        copy.last = row + rows == height;
+        _pendingImageCopies.push_back(copy);
+
+        source += chunk;
+    }
+    return _nextTicket;
+}
+
+Upload::Ticket Upload::Uploader::Flush()
+{
+    reclaim();
+
+    // Transfer parts whose copies have landed, their buffers get acquired by this batch's graphics part.
+    _acquireScratch.clear();
+    for (size_t i = 0; i < _batches.size(); i++)
+    {
+        const Batch &released = _batches[i];
+        if (released.inFlight && released.transferSubmitted && released.acquiredBy == NOT_ACQUIRED && vkGetFenceStatus(_logicalDevice, released.transferFence) == VkResult::VK_SUCCESS)
+        {
+            _acquireScratch.push_back(i);
+        }
+    }
+
+    if (_pendingCopies.empty() && _pendingTransferCopies.empty() && _pendingImageCopies.empty() && _acquireScratch.empty())
+    {
+        return _nextTicket - 1;
+    }
+
+    Batch &batch = acquireBatch();
+    size_t batchIndex = static_cast<size_t>(&batch - _batches.data());
+    batch.ticket = _nextTicket;
+    batch.ringBytes = _pendingBytes;
+    batch.ringEnd = _head;
+
+    if (!_pendingTransferCopies.empty())
+    {
+        submitTransfer(batch);
+    }
+
+    if (!_pendingCopies.empty() || !_pendingImageCopies.empty() || !_acquireScratch.empty())
+    {
+        VkCommandBufferBeginInfo beginInfo = {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        if (vkBeginCommandBuffer(batch.commandBuffer, &beginInfo) != VkResult::VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to begin upload command buffer.");
+        }
+
+        // The acquire half of the ownership transfers. It has to match the release exactly (buffer, range and families),
+        // and makes the transfer queue's writes visible to the graphics queue's reads.
+        _barrierScratch.clear();
+        for (size_t released : _acquireScratch)
+        {
+            for (const ReleasedRange &range : _batches[released].releasedRanges)
+            {
+                VkBufferMemoryBarrier acquire = {};
+                acquire.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+                acquire.srcAccessMask = 0;
+                acquire.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+                acquire.srcQueueFamilyIndex = _transferFamily;
+                acquire.dstQueueFamilyIndex = _queueFamily;
+                acquire.buffer = range.buffer;
+                acquire.offset = range.offset;
+                acquire.size = range.size;
+                _barrierScratch.push_back(acquire);
+            }
+            _batches[released].acquiredBy = batchIndex;
+        }
+        if (!_barrierScratch.empty())
+        {
+            vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, static_cast<uint32_t>(_barrierScratch.size()), _barrierScratch.data(), 0, nullptr);
+        }
+
+        if (!_pendingCopies.empty())
+        {
+            // Destinations may be re-uploaded while earlier frames still read them (tilemap chunks, for example).
+            // A barrier's first scope covers everything submitted before it on the queue, so this keeps the copies from
+            // overwriting data those frames haven't read yet. Write-after-read only needs the execution dependency.
+            vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+            recordCopies(batch.commandBuffer, _pendingCopies);
+
+            // Make the transfer writes visible to anything that reads the buffers afterwards on this queue.
+            VkMemoryBarrier barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+            vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+        }
+
+        recordImageCopies(batch.commandBuffer);
+
+        if (vkEndCommandBuffer(batch.commandBuffer) != VkResult::VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to end upload command buffer.");
+        }
+
+        VkSubmitInfo submitInfo = {};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &batch.commandBuffer;
+        vkResetFences(_logicalDevice, 1, &batch.fence);
+        if (vkQueueSubmit(_queue, 1, &submitInfo, batch.fence) != VkResult::VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to submit upload batch.");
+        }
+        batch.graphicsSubmitted = true;
+    }
+
+    batch.inFlight = true;
+    _pendingCopies.clear();
+    _pendingImageCopies.clear();
+    _pendingBytes = 0;
+    return _nextTicket++;
+}
+
+// Copies and the release half of the ownership transfers, on the transfer queue. Nothing on the graphics queue waits for it.
+void Upload::Uploader::submitTransfer(Batch &batch)
+{
+    if (batch.transferCommandBuffer == VK_NULL_HANDLE)
+    {
+        VkCommandBufferAllocateInfo bufferInfo = {};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        bufferInfo.commandPool = _transferCommandPool;
+        bufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        bufferInfo.commandBufferCount = 1;
+        if (vkAllocateCommandBuffers(_logicalDevice, &bufferInfo, &batch.transferCommandBuffer) != VkResult::VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to allocate transfer command buffer.");
+        }
+        VkFenceCreateInfo fenceInfo = {};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        if (vkCreateFence(_logicalDevice, &fenceInfo, nullptr, &batch.transferFence) != VkResult::VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create transfer fence.");
+        }
+    }
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (vkBeginCommandBuffer(batch.transferCommandBuffer, &beginInfo) != VkResult::VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to begin transfer command buffer.");
+    }
+
+    recordCopies(batch.transferCommandBuffer, _pendingTransferCopies);
+
+    // recordCopies left the copies sorted by destination, in the order they were queued, so neighbouring chunks
+    // of one upload fold into a single range.
+    batch.releasedRanges.clear();
+    for (const PendingCopy &copy : _pendingTransferCopies)
+    {
+        if (!batch.releasedRanges.empty())
+        {
+            ReleasedRange &last = batch.releasedRanges.back();
+            if (last.buffer == copy.destination && last.offset + last.size == copy.region.dstOffset)
+            {
+                last.size += copy.region.size;
+                continue;
+            }
+        }
+        batch.releasedRanges.push_back({copy.destination, copy.region.dstOffset, copy.region.size});
+    }
+    _barrierScratch.clear();
+    for (const ReleasedRange &range : batch.releasedRanges)
+    {
+        VkBufferMemoryBarrier release = {};
+        release.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        release.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        release.dstAccessMask = 0;
+        release.srcQueueFamilyIndex = _transferFamily;
+        release.dstQueueFamilyIndex = _queueFamily;
+        release.buffer = range.buffer;
+        release.offset = range.offset;
+        release.size = range.size;
+        _barrierScratch.push_back(release);
+    }
+    vkCmdPipelineBarrier(batch.transferCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, static_cast<uint32_t>(_barrierScratch.size()), _barrierScratch.data(), 0, nullptr);
+
+    if (vkEndCommandBuffer(batch.transferCommandBuffer) != VkResult::VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to end transfer command buffer.");
+    }
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &batch.transferCommandBuffer;
+    vkResetFences(_logicalDevice, 1, &batch.transferFence);
+    if (vkQueueSubmit(_transferQueue, 1, &submitInfo, batch.transferFence) != VkResult::VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to submit transfer batch.");
+    }
+    batch.transferSubmitted = true;
+    _pendingTransferCopies.clear();
+}
+
+// Groups copies by destination so each buffer gets one vkCmdCopyBuffer with all of its regions,
+// folds regions that are contiguous in both the ring and the destination into one, and drops overwritten bytes.
+void Upload::Uploader::recordCopies(VkCommandBuffer commandBuffer, std::vector<PendingCopy> &copies)
+{
+    std::stable_sort(copies.begin(), copies.end(), [](const PendingCopy &a, const PendingCopy &b) { return a.destination < b.destination; });
+    size_t first = 0;
+    while (first < copies.size())
+    {
+        VkBuffer destination = copies[first].destination;
+        _regionScratch.clear();
+        size_t i = first;
+        for (; i < copies.size() && copies[i].destination == destination; i++)
+        {
+            const VkBufferCopy &region = copies[i].region;
+            if (!_regionScratch.empty())
+            {
+                VkBufferCopy &last = _regionScratch.back();
+                if (last.srcOffset + last.size == region.srcOffset && last.dstOffset + last.size == region.dstOffset)
+                {
+                    last.size += region.size;
+                    continue;
+                }
+            }
+            _regionScratch.push_back(region);
+        }
+        trimOverwrittenRegions();
+        vkCmdCopyBuffer(commandBuffer, _ring.buffer, destination, static_cast<uint32_t>(_regionScratch.size()), _regionScratch.data());
+        first = i;
+    }
+}
+
+// The regions of one vkCmdCopyBuffer must not overlap in the destination, and in what order they land is undefined.
+// Writing a range again before Flush (a tilemap chunk changing twice in a frame) would break that, so only the
+// latest write to each byte is kept: earlier regions are cut down to the parts no later region covers.
+// https://docs.vulkan.org/spec/latest/chapters/copies.html#vkCmdCopyBuffer
+void Upload::Uploader::trimOverwrittenRegions()
+{
+    // Overlaps are rare, a sorted pass finds out whether there are any without the quadratic work below.
+    _trimScratch.assign(_regionScratch.begin(), _regionScratch.end());
+    std::sort(_trimScratch.begin(), _trimScratch.end(), [](const VkBufferCopy &a, const VkBufferCopy &b) { return a.dstOffset < b.dstOffset; });
+    bool overlap = false;
+    for (size_t i = 1; i < _trimScratch.size() && !overlap; i++)
+    {
+        overlap = _trimScratch[i - 1].dstOffset + _trimScratch[i - 1].size > _trimScratch[i].dstOffset;
+    }
+    if (!overlap)
+    {
+        return;
+    }
+
+    // _regionScratch is in the order the copies were queued, each region cuts into the ones kept before it.
+    _trimScratch.clear();
+    for (const VkBufferCopy &later : _regionScratch)
+    {
+        VkDeviceSize laterEnd = later.dstOffset + later.size;
+        size_t kept = _trimScratch.size();
+        for (size_t j = 0; j < kept; j++)
+        {
+            VkBufferCopy earlier = _trimScratch[j];
+            VkDeviceSize earlierEnd = earlier.dstOffset + earlier.size;
+            if (earlier.size == 0 || earlier.dstOffset >= laterEnd || later.dstOffset >= earlierEnd)
+            {
+                continue;
+            }
+            // What is left before and after the later region. Both can exist when it lands in the middle.
+            _trimScratch[j].size = later.dstOffset > earlier.dstOffset ? later.dstOffset - earlier.dstOffset : 0;
+            if (earlierEnd > laterEnd)
+            {
+                VkDeviceSize skipped = laterEnd - earlier.dstOffset;
+                _trimScratch.push_back({earlier.srcOffset + skipped, laterEnd, earlierEnd - laterEnd});
+            }
+        }
+        _trimScratch.push_back(later);
+    }
+    _trimScratch.erase(std::remove_if(_trimScratch.begin(), _trimScratch.end(), [](const VkBufferCopy &region) { return region.size == 0; }), _trimScratch.end());
+    _regionScratch.swap(_trimScratch);
+}
+
+// Images are only ever uploaded once, right after they were created, so there are no earlier reads to wait for.
+void Upload::Uploader::recordImageCopies(VkCommandBuffer commandBuffer)
+{
+    for (const PendingImageCopy &copy : _pendingImageCopies)
+    {
+        if (copy.first)
+        {
+            // Every level goes to TRANSFER_DST, mip 0 for the copy and the rest for the blits. Coming from UNDEFINED
+            // lets the driver throw away whatever the memory held before.
+            VkImageMemoryBarrier barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = copy.destination;
+            barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            barrier.subresourceRange.baseMipLevel = 0;
+            barrier.subresourceRange.levelCount = copy.mipLevels;
+            barrier.subresourceRange.baseArrayLayer = 0;
+            barrier.subresourceRange.layerCount = 1;
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+        }
+        vkCmdCopyBufferToImage(commandBuffer, _ring.buffer, copy.destination, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy.region);
+        if (copy.last)
+        {
+            recordMipChain(commandBuffer, copy);
+        }
+    }
+}
+
+// Each level is blitted from the one above it at half the size, then that source level is done and moves to
+// SHADER_READ_ONLY. The barriers are per level, so level i - 1 is only read once its own write has finished.
+void Upload::Uploader::recordMipChain(VkCommandBuffer commandBuffer, const PendingImageCopy &copy)
+{
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = copy.destination;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+
+    int32_t mipWidth = static_cast<int32_t>(copy.width);
+    int32_t mipHeight = static_cast<int32_t>(copy.height);
+    for (uint32_t level = 1; level < copy.mipLevels; level++)
+    {
+        barrier.subresourceRange.baseMipLevel = level - 1;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        int32_t nextWidth = std::max(mipWidth / 2, 1);
+        int32_t nextHeight = std::max(mipHeight / 2, 1);
+        VkImageBlit blit = {};
+        blit.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1};
+        blit.srcOffsets[0] = {0, 0, 0};
+        blit.srcOffsets[1] = {mipWidth, mipHeight, 1};
+        blit.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1};
+        blit.dstOffsets[0] = {0, 0, 0};
+        blit.dstOffsets[1] = {nextWidth, nextHeight, 1};
+        vkCmdBlitImage(commandBuffer, copy.destination, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, copy.destination, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        mipWidth = nextWidth;
+        mipHeight = nextHeight;
+    }
+
+    // The last level was only ever written.
+    barrier.subresourceRange.baseMipLevel = copy.mipLevels - 1;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+bool Upload::Uploader::IsComplete(Ticket ticket)
+{
+    reclaim();
+    return ticket <= _completedTicket;
+}
+
+void Upload::Uploader::Wait(Ticket ticket)
+{
+    if (ticket >= _nextTicket)
+    {
+        Flush();
+    }
+    while (!IsComplete(ticket) && waitOldest())
+    {
+    }
+}
+
+void Upload::Uploader::WaitIdle()
+{
+    Wait(_nextTicket - 1);
+}
+
+VkDeviceSize Upload::Uploader::allocateRing(VkDeviceSize size)
+{
+    size = (size + RING_ALIGNMENT - 1) / RING_ALIGNMENT * RING_ALIGNMENT;
+    while (true)
+    {
+        if (_bytesInUse == 0)
+        {
+            _head = 0;
+            _tail = 0;
+        }
+
+        // Free space is [head, end) + [0, tail) until the head wraps around, then it is [head, tail).
+        bool wrapped = _head < _tail || (_head == _tail && _bytesInUse > 0);
+        if (!wrapped)
+        {
+            if (_ring.size - _head >= size)
+            {
+                VkDeviceSize offset = _head;
+                _head += size;
+                _bytesInUse += size;
+                _pendingBytes += size;
+                return offset;
+            }
+            if (_tail >= size)
+            {
+                // The unused end of the ring is charged to this batch so it is released together with it.
+                VkDeviceSize waste = _ring.size - _head;
+                _head = size;
+                _bytesInUse += waste + size;
+                _pendingBytes += waste + size;
+                return 0;
+            }
+        }
+        else if (_tail - _head >= size)
+        {
+            VkDeviceSize offset = _head;
+            _head += size;
+            _bytesInUse += size;
+            _pendingBytes += size;
+            return offset;
+        }
+
+        // Out of ring space: push out what is queued and wait for the oldest batch to give its bytes back.
+        if (!_pendingCopies.empty() || !_pendingTransferCopies.empty() || !_pendingImageCopies.empty())
+        {
+            Flush();
+        }
+        if (!waitOldest())
+        {
+            throw std::runtime_error("Upload ring is full with no batch in flight.");
+        }
+    }
+}
+
+bool Upload::Uploader::isBatchComplete(const Batch &batch)
+{
+    if (batch.graphicsSubmitted && vkGetFenceStatus(_logicalDevice, batch.fence) != VkResult::VK_SUCCESS)
+    {
+        return false;
+    }
+    if (batch.transferSubmitted)
+    {
+        // The copies landing isn't enough, the buffers are only usable once the acquire has run too.
+        return batch.acquiredBy != NOT_ACQUIRED && vkGetFenceStatus(_logicalDevice, _batches[batch.acquiredBy].fence) == VkResult::VK_SUCCESS;
+    }
+    return true;
+}
+
+Upload::Uploader::Batch *Upload::Uploader::findOldest()
+{
+    Batch *oldest = nullptr;
+    for (Batch &batch : _batches)
+    {
+        if (batch.inFlight && (oldest == nullptr || batch.ticket < oldest->ticket))
+        {
+            oldest = &batch;
+        }
+    }
+    return oldest;
+}
+
+void Upload::Uploader::reclaim()
+{
+    // Release ring space oldest first and stop at the first busy batch. A batch acquired by a later one can only
+    // complete after it, so tickets still complete in order.
+    while (true)
+    {
+        Batch *oldest = findOldest();
+        if (oldest == nullptr || !isBatchComplete(*oldest))
+        {
+            return;
+        }
+        oldest->inFlight = false;
+        _bytesInUse -= oldest->ringBytes;
+        _tail = oldest->ringEnd;
+        _completedTicket = oldest->ticket;
+    }
+}
+
+bool Upload::Uploader::waitOldest()
+{
+    Batch *oldest = findOldest();
+    if (oldest == nullptr)
+    {
+        return false;
+    }
+    if (oldest->transferSubmitted && oldest->acquiredBy == NOT_ACQUIRED)
+    {
+        // Nothing acquires the buffers until the next Flush, so wait for the copies and flush right away.
+        vkWaitForFences(_logicalDevice, 1, &oldest->transferFence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+        size_t oldestIndex = static_cast<size_t>(oldest - _batches.data());
+        Flush();
+        oldest = &_batches[oldestIndex];
+    }
+    if (oldest->graphicsSubmitted)
+    {
+        vkWaitForFences(_logicalDevice, 1, &oldest->fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+    }
+    if (oldest->transferSubmitted)
+    {
+        vkWaitForFences(_logicalDevice, 1, &_batches[oldest->acquiredBy].fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+    }
+    reclaim();
+    return true;
+}
+
+Upload::Uploader::Batch &Upload::Uploader::acquireBatch()
+{
+    for (Batch &batch : _batches)
+    {
+        if (!batch.inFlight)
+        {
+            vkResetCommandBuffer(batch.commandBuffer, 0);
+            if (batch.transferCommandBuffer != VK_NULL_HANDLE)
+            {
+                vkResetCommandBuffer(batch.transferCommandBuffer, 0);
+            }
+            batch.graphicsSubmitted = false;
+            batch.transferSubmitted = false;
+            batch.releasedRanges.clear();
+            batch.acquiredBy = NOT_ACQUIRED;
+            return batch;
+        }
+    }
+
+    Batch batch = {};
+    VkCommandBufferAllocateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    bufferInfo.commandPool = _commandPool;
+    bufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    bufferInfo.commandBufferCount = 1;
+    if (vkAllocateCommandBuffers(_logicalDevice, &bufferInfo, &batch.commandBuffer) != VkResult::VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to allocate upload command buffer.");
+    }
+
+    VkFenceCreateInfo fenceInfo = {};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    if (vkCreateFence(_logicalDevice, &fenceInfo, nullptr, &batch.fence) != VkResult::VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create upload fence.");
+    }
+
+    _batches.push_back(batch);
+    return _batches.back();
+}
@@ -0,0 +1,151 @@
+#ifndef UPLOAD_H
+#define UPLOAD_H
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <cstdint>
+
+#include "memory.h"
+
+namespace Upload
+{
+// Identifies the batch an upload went out with. Tickets increase monotonically, so
+// "ticket <= last completed ticket" is all that's needed to know an upload landed.
+using Ticket = uint64_t;
+
+// Moves data into DEVICE_LOCAL buffers through one persistent, persistently mapped staging ring.
+// Enqueue() only memcpys into the ring and remembers the copy, Flush() records every pending copy
+// into one command buffer (one vkCmdCopyBuffer per destination buffer) and submits it with a fence.
+// Ring space is reclaimed when those fences signal, nothing ever waits on the queue going idle.
+// https://vulkan-tutorial.com/Vertex_buffers/Staging_buffer
+//
+// With a dedicated transfer queue, EnqueueAsync copies go out on the copy engine instead and overlap with rendering.
+// Destinations are exclusive to one queue family, so the transfer queue releases them once the copy is recorded and
+// the graphics queue acquires them. The acquire is only recorded once the transfer fence has signaled, so it never
+// makes the graphics queue wait on the copy engine.
+// https://docs.vulkan.org/spec/latest/chapters/synchronization.html#synchronization-queue-transfers
+//
+// Images always go through the graphics queue, since building their mip chains with vkCmdBlitImage needs it.
+// https://vulkan-tutorial.com/Generating_Mipmaps
+class Uploader
+{
+  public:
+    // transferFamily < 0 (or transferQueue VK_NULL_HANDLE) keeps every copy on `queue`.
+    void Init(Memory::Allocator &allocator, VkDevice logicalDevice, uint32_t queueFamily, VkQueue queue, VkDeviceSize ringSize, int transferFamily = -1, VkQueue transferQueue = VK_NULL_HANDLE);
+    void Cleanup();
+    bool HasTransferQueue() { return _transferQueue != VK_NULL_HANDLE; }
+
+    // Copies `data` into the staging ring right away, the GPU copy goes out with the next Flush().
+    Ticket Enqueue(VkBuffer destination, VkDeviceSize destinationOffset, const void *data, VkDeviceSize size);
+    // Like Enqueue, but only for destinations nothing has been submitted against yet, like freshly created buffers.
+    // The copy runs on the transfer queue when there is one, and its ticket completes a little later than it would
+    // with Enqueue: the handover to the graphics queue goes out with the first Flush after the copy finished.
+    Ticket EnqueueAsync(VkBuffer destination, VkDeviceSize destinationOffset, const void *data, VkDeviceSize size);
+    // Fills mip 0 of a freshly created image (TRANSFER_SRC | TRANSFER_DST | SAMPLED usage, UNDEFINED layout) with
+    // width x height tightly packed texels and blits the rest of its mipLevels from it, leaving every level in
+    // SHADER_READ_ONLY_OPTIMAL. The blits filter linearly, so the format has to support that for mipLevels > 1.
+    Ticket EnqueueImage(VkImage destination, uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t texelSize, const void *data);
+    // Submits everything queued since the last flush as a single batch. Returns the ticket of that batch.
+    Ticket Flush();
+
+    bool IsComplete(Ticket ticket);
+    void Wait(Ticket ticket);
+    void WaitIdle();
+
+  private:
+    // Copy sources are kept 16 byte aligned, which also satisfies buffer->image copies for every texel size we use.
+    const VkDeviceSize RING_ALIGNMENT = 16;
+
+    struct PendingCopy
+    {
+        VkBuffer destination;
+        VkBufferCopy region;
+    };
+
+    // One band of rows of an image. Images bigger than half the ring are split into several, the first one moves the
+    // image into TRANSFER_DST_OPTIMAL and the last one builds the mip chain, possibly a few batches later.
+    struct PendingImageCopy
+    {
+        VkImage destination;
+        VkBufferImageCopy region;
+        uint32_t width;
+        uint32_t height;
+        uint32_t mipLevels;
+        bool first;
+        bool last;
+    };
+
+    static constexpr size_t NOT_ACQUIRED = SIZE_MAX;
+
+    struct ReleasedRange
+    {
+        VkBuffer buffer;
+        VkDeviceSize offset;
+        VkDeviceSize size;
+    };
+
+    // A batch has a graphics part, a transfer part or both. The transfer part is only done once a later batch's
+    // graphics part has acquired its buffers and completed.
+    struct Batch
+    {
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        VkFence fence = VK_NULL_HANDLE;
+        VkCommandBuffer transferCommandBuffer = VK_NULL_HANDLE;
+        VkFence transferFence = VK_NULL_HANDLE;
+        Ticket ticket = 0;
+        VkDeviceSize ringBytes = 0; // Ring bytes (including wrap waste) released when this batch completes
+        VkDeviceSize ringEnd = 0;
+        bool inFlight = false;
+        bool graphicsSubmitted = false;
+        bool transferSubmitted = false;
+        // Released by the transfer part, waiting to be acquired on the graphics queue. Ownership is transferred per
+        // range, a big upload whose chunks end up in different batches hands each chunk over on its own.
+        std::vector<ReleasedRange> releasedRanges;
+        // Index in _batches of the batch whose graphics part acquired releasedRanges.
+        size_t acquiredBy = NOT_ACQUIRED;
+    };
+
+    Memory::Allocator *_allocator = nullptr;
+    VkDevice _logicalDevice = VK_NULL_HANDLE;
+    VkQueue _queue = VK_NULL_HANDLE;
+    VkCommandPool _commandPool = VK_NULL_HANDLE;
+    uint32_t _queueFamily = 0;
+    VkQueue _transferQueue = VK_NULL_HANDLE;
+    VkCommandPool _transferCommandPool = VK_NULL_HANDLE;
+    uint32_t _transferFamily = 0;
+
+    Memory::Buffer _ring;
+    VkDeviceSize _head = 0;
+    VkDeviceSize _tail = 0;
+    VkDeviceSize _bytesInUse = 0;
+    VkDeviceSize _pendingBytes = 0;
+
+    std::vector<PendingCopy> _pendingCopies;
+    std::vector<PendingCopy> _pendingTransferCopies;
+    std::vector<PendingImageCopy> _pendingImageCopies;
+    std::vector<VkBufferCopy> _regionScratch;
+    std::vector<VkBufferCopy> _trimScratch;
+    std::vector<VkBufferMemoryBarrier> _barrierScratch;
+    std::vector<size_t> _acquireScratch;
+    // In submission order, completed batches are recycled from the front.
+    std::vector<Batch> _batches;
+    Ticket _nextTicket = 1;
+    Ticket _completedTicket = 0;
+
+    Ticket enqueue(std::vector<PendingCopy> &copies, VkBuffer destination, VkDeviceSize destinationOffset, const void *data, VkDeviceSize size);
+    void recordCopies(VkCommandBuffer commandBuffer, std::vector<PendingCopy> &copies);
+    void trimOverwrittenRegions();
+    void recordImageCopies(VkCommandBuffer commandBuffer);
+    void recordMipChain(VkCommandBuffer commandBuffer, const PendingImageCopy &copy);
+    void submitTransfer(Batch &batch);
+    VkDeviceSize allocateRing(VkDeviceSize size);
+    bool isBatchComplete(const Batch &batch);
+    Batch *findOldest();
+    void reclaim();
+    bool waitOldest();
+    Batch &acquireBatch();
+};
+
+} // namespace Upload
+
+#endif
@@ -5,25 +5,77 @@
 #include <glm/glm.hpp>
 #include <vector>
 #include <array>
+#include <cstdint>
+
+#include "memory.h"
+#include "upload.h"
+#include "vertexformat.h"
 
 namespace Vertex
 {
+// 8 bytes instead of the 20 of a float vec2 and vec3, the shaders still read vec2 and vec3.
 struct Vertex {
-    glm::vec2 pos;
-    glm::vec3 color;
+    VertexFormat::Snorm16x2 pos; // Positions and quad corners are all within [-1, 1]
+    VertexFormat::Unorm8x4 color;
 };
 
-struct VertexBuffer {
-    VkBuffer buffer;
-    VkDeviceMemory memory;
+// One sprite or tile of a SpriteBatch. Read once per instance from binding 1, while binding 0 supplies the unit quad's corners.
+struct SpriteInstance {
+    glm::vec2 position; // World space top left corner
+    glm::vec2 size;     // World units
+    glm::vec4 uvRect;   // u0, v0, u1, v1
+    uint32_t tint;      // RGBA8, see PackTint
+    float layer;        // Higher layers are drawn on top
 };
 
-const int VERTEX_PROPERTIES_COUNT = 2;
+using VertexBuffer = Memory::Buffer;
+
+const uint32_t VERTEX_BINDING = 0;
+const uint32_t INSTANCE_BINDING = 1;
+
+// Byte order matches VK_FORMAT_R8G8B8A8_UNORM, the shader sees the tint as a normalized vec4.
+inline uint32_t PackTint(uint8_t r, uint8_t g, uint8_t b, uint8_t a)
+{
+    return static_cast<uint32_t>(r) | static_cast<uint32_t>(g) << 8 | static_cast<uint32_t>(b) << 16 | static_cast<uint32_t>(a) << 24;
+}
 
-VkVertexInputBindingDescription CreateBindingDescription();
-std::array<VkVertexInputAttributeDescription, VERTEX_PROPERTIES_COUNT> CreateAttributeDescriptions();
-VertexBuffer CreateVertexBuffer(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, std::vector<Vertex> vertices);
+// Creates a DEVICE_LOCAL vertex buffer and queues its contents on the uploader.
+// The data is on the GPU once the uploader's next Flush() completes. Throws if vertices is empty.
+VertexBuffer CreateVertexBuffer(Memory::Allocator &allocator, Upload::Uploader &uploader, const std::vector<Vertex> &vertices);
 
 } // namespace Vertex
 
+namespace VertexFormat
+{
+template <> struct Layout<Vertex::Vertex> {
+    static constexpr std::array<Attribute, 2> ATTRIBUTES = {{
+        VERTEX_ATTRIBUTE(Vertex::Vertex, pos, 0),
+        VERTEX_ATTRIBUTE(Vertex::Vertex, color, 1),
+    }};
+};
+
+// Locations continue after Vertex::Vertex, so both can be used by one pipeline.
+template <> struct Layout<Vertex::SpriteInstance> {
+    static constexpr std::array<Attribute, 5> ATTRIBUTES = {{
+        VERTEX_ATTRIBUTE(Vertex::SpriteInstance, position, 2),
+        VERTEX_ATTRIBUTE(Vertex::SpriteInstance, size, 3),
+        VERTEX_ATTRIBUTE(Vertex::SpriteInstance, uvRect, 4),
+        // 4 bytes instead of 16, the vertex fetch unpacks it to a vec4 for free
+        VERTEX_ATTRIBUTE_AS(Vertex::SpriteInstance, tint, 5, VK_FORMAT_R8G8B8A8_UNORM),
+        VERTEX_ATTRIBUTE(Vertex::SpriteInstance, layer, 6),
+    }};
+};
+} // namespace VertexFormat
+
+namespace Vertex
+{
+// A vertex binding describes at which rate to load data from memory throughout the vertices.
+// It specifies the number of bytes between data entries and whether to move to the next data entry after each vertex or after each instance.
+// The instance binding moves on once per instance, so one draw of the 6 quad vertices with N instances draws N sprites.
+constexpr VkVertexInputBindingDescription VERTEX_BINDING_DESCRIPTION = VertexFormat::BindingDescription<Vertex>(VERTEX_BINDING, VK_VERTEX_INPUT_RATE_VERTEX);
+constexpr auto VERTEX_ATTRIBUTES = VertexFormat::AttributeDescriptions<Vertex>(VERTEX_BINDING);
+constexpr VkVertexInputBindingDescription INSTANCE_BINDING_DESCRIPTION = VertexFormat::BindingDescription<SpriteInstance>(INSTANCE_BINDING, VK_VERTEX_INPUT_RATE_INSTANCE);
+constexpr auto INSTANCE_ATTRIBUTES = VertexFormat::AttributeDescriptions<SpriteInstance>(INSTANCE_BINDING);
+} // namespace Vertex
+
 #endif
\ No newline at end of file
@@ -0,0 +1,257 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+#include <array>
+#include <stdexcept>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Vertex layouts described once, next to their struct, and turned into Vulkan binding and attribute descriptions at
+// compile time. Each attribute's format follows from its member's type and its offset from offsetof, so changing a
+// member can't leave a stale format or offset behind, and a layout that misses or overlaps bytes doesn't compile.
+// https://docs.vulkan.org/spec/latest/chapters/fxvertex.html#fxvertex-attrib
+//
+// Packed members cut vertex bandwidth without touching the shaders: vertex fetch unpacks half floats and normalized
+// integers to floats for free, so a shader reading vec2 or vec4 works with any of them.
+// https://docs.vulkan.org/spec/latest/chapters/fundamentals.html#fundamentals-fixednormal
+namespace VertexFormat
+{
+    constexpr int16_t ToSnorm16(float value)
+    {
+        value = value < -1.0f ? -1.0f : (value > 1.0f ? 1.0f : value);
+        return static_cast<int16_t>(value * 32767.0f + (value < 0.0f ? -0.5f : 0.5f));
+    }
+
+    constexpr uint16_t ToUnorm16(float value)
+    {
+        value = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+        return static_cast<uint16_t>(value * 65535.0f + 0.5f);
+    }
+
+    constexpr uint8_t ToUnorm8(float value)
+    {
+        value = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+        return static_cast<uint8_t>(value * 255.0f + 0.5f);
+    }
+
+    // IEEE 754 binary16, rounded to nearest even. Too large values become infinity, too small ones zero.
+    inline uint16_t ToHalf(float value)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        uint32_t sign = (bits >> 16) & 0x8000;
+        uint32_t floatExponent = (bits >> 23) & 0xFF;
+        uint32_t mantissa = bits & 0x7FFFFF;
+        if (floatExponent == 0xFF)
+        {
+            return static_cast<uint16_t>(sign | 0x7C00 | (mantissa != 0 ? 0x200 : 0));
+        }
+        int32_t exponent = static_cast<int32_t>(floatExponent) - 127 + 15;
+        if (exponent >= 31)
+        {
+            return static_cast<uint16_t>(sign | 0x7C00);
+        }
+
+        uint32_t shift = 13;
+        uint32_t half = (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+        if (exponent <= 0)
+        {
+            // Denormal, the implicit leading 1 becomes part of the mantissa.
+            if (exponent < -10)
+            {
+                return static_cast<uint16_t>(sign);
+            }
+            mantissa |= 0x800000;
+            shift = static_cast<uint32_t>(14 - exponent);
+            half = mantissa >> shift;
+        }
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        // Rounding up may carry into the exponent, which is still the right result (up to infinity).
+        if (rest > halfway || (rest == halfway && (half & 1) != 0))
+        {
+            half++;
+        }
+        return static_cast<uint16_t>(sign | half);
+    }
+
+    // Packed member types, each constructed from the floats the shader will see.
+
+    struct Half2
+    {
+        uint16_t x, y;
+        Half2() = default;
+        Half2(float x, float y) : x(ToHalf(x)), y(ToHalf(y)) {}
+    };
+
+    struct Half4
+    {
+        uint16_t x, y, z, w;
+        Half4() = default;
+        Half4(float x, float y, float z, float w) : x(ToHalf(x)), y(ToHalf(y)), z(ToHalf(z)), w(ToHalf(w)) {}
+    };
+
+    // [-1, 1] in 1/32767 steps, enough for positions in a small local space.
+    struct Snorm16x2
+    {
+        int16_t x, y;
+        Snorm16x2() = default;
+        constexpr Snorm16x2(float x, float y) : x(ToSnorm16(x)), y(ToSnorm16(y)) {}
+    };
+
+    // [0, 1] in 1/65535 steps, precise enough for texture coordinates of any texture Vulkan can create.
+    struct Unorm16x2
+    {
+        uint16_t x, y;
+        Unorm16x2() = default;
+        constexpr Unorm16x2(float x, float y) : x(ToUnorm16(x)), y(ToUnorm16(y)) {}
+    };
+
+    // 8 bits per channel color, 4 bytes instead of the 12 or 16 of a float vec3 or vec4.
+    struct Unorm8x4
+    {
+        uint8_t r, g, b, a;
+        Unorm8x4() = default;
+        constexpr Unorm8x4(float r, float g, float b, float a = 1.0f) : r(ToUnorm8(r)), g(ToUnorm8(g)), b(ToUnorm8(b)), a(ToUnorm8(a)) {}
+    };
+
+    // The Vulkan format of a member type. Types without a specialization don't compile as attributes.
+    template <typename T>
+    struct FormatOf;
+
+    template <> struct FormatOf<float> { static constexpr VkFormat value = VK_FORMAT_R32_SFLOAT; };
+    template <> struct FormatOf<glm::vec2> { static constexpr VkFormat value = VK_FORMAT_R32G32_SFLOAT; };
+    template <> struct FormatOf<glm::vec3> { static constexpr VkFormat value = VK_FORMAT_R32G32B32_SFLOAT; };
+    template <> struct FormatOf<glm::vec4> { static constexpr VkFormat value = VK_FORMAT_R32G32B32A32_SFLOAT; };
+    template <> struct FormatOf<uint32_t> { static constexpr VkFormat value = VK_FORMAT_R32_UINT; };
+    template <> struct FormatOf<int32_t> { static constexpr VkFormat value = VK_FORMAT_R32_SINT; };
+    template <> struct FormatOf<Half2> { static constexpr VkFormat value = VK_FORMAT_R16G16_SFLOAT; };
+    template <> struct FormatOf<Half4> { static constexpr VkFormat value = VK_FORMAT_R16G16B16A16_SFLOAT; };
+    template <> struct FormatOf<Snorm16x2> { static constexpr VkFormat value = VK_FORMAT_R16G16_SNORM; };
+    template <> struct FormatOf<Unorm16x2> { static constexpr VkFormat value = VK_FORMAT_R16G16_UNORM; };
+    template <> struct FormatOf<Unorm8x4> { static constexpr VkFormat value = VK_FORMAT_R8G8B8A8_UNORM; };
+
+    // Bytes of one attribute of a format, 0 for formats that aren't used as vertex attributes here.
+    constexpr uint32_t FormatSize(VkFormat format)
+    {
+        switch (format)
+        {
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R16G16_SFLOAT:
+        case VK_FORMAT_R16G16_SNORM:
+        case VK_FORMAT_R16G16_UNORM:
+        case VK_FORMAT_R32_SFLOAT:
+        case VK_FORMAT_R32_UINT:
+        case VK_FORMAT_R32_SINT:
+            return 4;
+        case VK_FORMAT_R16G16B16A16_SFLOAT:
+        case VK_FORMAT_R32G32_SFLOAT:
+            return 8;
+        case VK_FORMAT_R32G32B32_SFLOAT:
+            return 12;
+        case VK_FORMAT_R32G32B32A32_SFLOAT:
+            return 16;
+        default:
+            return 0;
+        }
+    }
+
+    struct Attribute
+    {
+        uint32_t location;
+        VkFormat format;
+        uint32_t offset;
+        uint32_t size;
+    };
+
+    template <typename Member>
+    constexpr Attribute MakeAttribute(uint32_t location, size_t offset)
+    {
+        static_assert(sizeof(Member) == FormatSize(FormatOf<Member>::value), "Member type and its vertex format differ in size.");
+        return {location, FormatOf<Member>::value, static_cast<uint32_t>(offset), static_cast<uint32_t>(sizeof(Member))};
+    }
+
+    // For a member whose type doesn't say how it is packed, like a uint32_t holding RGBA8.
+    // Used in a constant expression, a size mismatch is a compile error rather than an exception.
+    constexpr Attribute MakeAttribute(uint32_t location, size_t offset, VkFormat format, size_t memberSize)
+    {
+        return FormatSize(format) == memberSize ? Attribute{location, format, static_cast<uint32_t>(offset), static_cast<uint32_t>(memberSize)}
+                                                : throw std::logic_error("Vertex attribute format doesn't match its member's size.");
+    }
+
+    // Specialize for every vertex struct with `static constexpr std::array<Attribute, N> ATTRIBUTES`, one entry per
+    // member, built with the macros below. See Vertex::Vertex.
+    template <typename V>
+    struct Layout;
+
+    // Every byte of V belongs to exactly one attribute and no location is used twice. A layout with padding or a
+    // forgotten member fails this, so the struct and what the GPU reads from it can't drift apart.
+    template <typename V>
+    constexpr bool IsExact()
+    {
+        constexpr auto &attributes = Layout<V>::ATTRIBUTES;
+        size_t covered = 0;
+        for (size_t i = 0; i < attributes.size(); i++)
+        {
+            if (attributes[i].offset + attributes[i].size > sizeof(V))
+            {
+                return false;
+            }
+            for (size_t j = i + 1; j < attributes.size(); j++)
+            {
+                bool overlap = attributes[i].offset < attributes[j].offset + attributes[j].size && attributes[j].offset < attributes[i].offset + attributes[i].size;
+                if (overlap || attributes[i].location == attributes[j].location)
+                {
+                    return false;
+                }
+            }
+            covered += attributes[i].size;
+        }
+        return covered == sizeof(V);
+    }
+
+    // Changes whenever V's layout does, for files that store vertices as they are (see MeshFormat). FNV-1a over
+    // every attribute and the stride.
+    template <typename V>
+    constexpr uint32_t LayoutHash()
+    {
+        uint32_t hash = 2166136261u;
+        for (const Attribute &attribute : Layout<V>::ATTRIBUTES)
+        {
+            for (uint32_t value : {attribute.location, static_cast<uint32_t>(attribute.format), attribute.offset, attribute.size})
+            {
+                hash = (hash ^ value) * 16777619u;
+            }
+        }
+        return (hash ^ static_cast<uint32_t>(sizeof(V))) * 16777619u;
+    }
+
+    template <typename V>
+    constexpr VkVertexInputBindingDescription BindingDescription(uint32_t binding, VkVertexInputRate inputRate)
+    {
+        static_assert(IsExact<V>(), "Vertex layout has to cover every byte of its struct exactly once, with unique locations.");
+        return {binding, static_cast<uint32_t>(sizeof(V)), inputRate};
+    }
+
+    template <typename V>
+    constexpr std::array<VkVertexInputAttributeDescription, Layout<V>::ATTRIBUTES.size()> AttributeDescriptions(uint32_t binding)
+    {
+        static_assert(IsExact<V>(), "Vertex layout has to cover every byte of its struct exactly once, with unique locations.");
+        std::array<VkVertexInputAttributeDescription, Layout<V>::ATTRIBUTES.size()> descriptions = {};
+        for (size_t i = 0; i < descriptions.size(); i++)
+        {
+            descriptions[i] = {Layout<V>::ATTRIBUTES[i].location, binding, Layout<V>::ATTRIBUTES[i].format, Layout<V>::ATTRIBUTES[i].offset};
+        }
+        return descriptions;
+    }
+}
+
+// The format follows from the member's type.
+#define VERTEX_ATTRIBUTE(Struct, member, location) VertexFormat::MakeAttribute<decltype(Struct::member)>(location, offsetof(Struct, member))
+// The format is given, and has to be the member's size.
+#define VERTEX_ATTRIBUTE_AS(Struct, member, location, format) VertexFormat::MakeAttribute(location, offsetof(Struct, member), format, sizeof(Struct::member))
+
+#endif
@@ -0,0 +1,209 @@
+#include <vector>
+#include <string>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+
+#include "archive.h"
+#include "lz4.h"
+
+namespace
+{
+    uint64_t alignUp(uint64_t value, uint64_t alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    // Sort order of the table of contents. Names only break ties between hash collisions.
+    bool entryLess(uint64_t leftHash, const std::string &leftName, uint64_t rightHash, const std::string &rightName)
+    {
+        return leftHash != rightHash ? leftHash < rightHash : leftName < rightName;
+    }
+}
+
+// https://en.wikipedia.org/wiki/Fowler%E2%80%93Noll%E2%80%93Vo_hash_function
+uint64_t ArchiveFormat::HashName(const std::string &name)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (char character : name)
+    {
+        hash ^= static_cast<unsigned char>(character);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+std::shared_ptr<const Archive> Archive::Open(const std::string &path)
+{
+    std::shared_ptr<Archive> archive = std::make_shared<Archive>();
+    archive->_path = path;
+    archive->_file = FileIOSystem::FileView::Map(path);
+
+    const FileIOSystem::FileView &file = *archive->_file;
+    if (file.Size() < sizeof(ArchiveFormat::ArchiveHeader))
+    {
+        throw std::runtime_error("Archive is too small to be one: " + path);
+    }
+    // The mapping is page aligned, so the header and the entries behind it can be read in place.
+    const ArchiveFormat::ArchiveHeader *header = reinterpret_cast<const ArchiveFormat::ArchiveHeader *>(file.Data());
+    if (std::memcmp(header->magic, ArchiveFormat::MAGIC, sizeof(header->magic)) != 0)
+    {
+        throw std::runtime_error("Not an asset archive: " + path);
+    }
+    if (header->version != ArchiveFormat::VERSION)
+    {
+        throw std::runtime_error("Asset archive " + path + " is version " + std::to_string(header->version) + ", expected " + std::to_string(ArchiveFormat::VERSION));
+    }
+
+    uint64_t size = file.Size();
+    uint64_t entriesEnd = sizeof(ArchiveFormat::ArchiveHeader) + uint64_t(header->entryCount) * sizeof(ArchiveFormat::ArchiveEntry);
+    // namesOffset is checked against the size before it is subtracted from it, a corrupt one would wrap around.
+    if (entriesEnd > size || header->namesOffset < entriesEnd || header->namesOffset > size || header->namesSize > size - header->namesOffset)
+    {
+        throw std::runtime_error("Asset archive is truncated: " + path);
+    }
+    archive->_header = header;
+    archive->_entries = reinterpret_cast<const ArchiveFormat::ArchiveEntry *>(file.Data() + sizeof(ArchiveFormat::ArchiveHeader));
+    archive->_names = file.Data() + header->namesOffset;
+
+    // Checked once here, before any name is read, so Find, Read and GetName can trust every offset.
+    for (uint32_t i = 0; i < header->entryCount; i++)
+    {
+        const ArchiveFormat::ArchiveEntry &entry = archive->_entries[i];
+        bool nameInside = uint64_t(entry.nameOffset) + entry.nameLength <= header->namesSize;
+        bool blobInside = entry.offset <= size && entry.storedSize <= size - entry.offset;
+        bool knownCompression = entry.compression == ArchiveFormat::COMPRESSION_NONE || entry.compression == ArchiveFormat::COMPRESSION_LZ4;
+        bool sizeMatches = entry.compression != ArchiveFormat::COMPRESSION_NONE || entry.storedSize == entry.size;
+        if (!nameInside || !blobInside || !knownCompression || !sizeMatches)
+        {
+            throw std::runtime_error("Asset archive " + path + " has a corrupt entry at index " + std::to_string(i));
+        }
+    }
+    return archive;
+}
+
+const ArchiveFormat::ArchiveEntry *Archive::Find(const std::string &name) const
+{
+    uint64_t hash = ArchiveFormat::HashName(name);
+    const ArchiveFormat::ArchiveEntry *begin = _entries;
+    const ArchiveFormat::ArchiveEntry *end = _entries + _header->entryCount;
+    const ArchiveFormat::ArchiveEntry *found = std::lower_bound(begin, end, hash, [](const ArchiveFormat::ArchiveEntry &entry, uint64_t value) {
+        return entry.nameHash < value;
+    });
+    // Walk past the (almost always zero) other names that share the hash.
+    for (; found != end && found->nameHash == hash; found++)
+    {
+        if (name.size() == found->nameLength && std::memcmp(name.data(), _names + found->nameOffset, name.size()) == 0)
+        {
+            return found;
+        }
+    }
+    return nullptr;
+}
+
+std::shared_ptr<const FileIOSystem::FileView> Archive::Read(const ArchiveFormat::ArchiveEntry &entry) const
+{
+    if (entry.compression == ArchiveFormat::COMPRESSION_NONE)
+    {
+        return FileIOSystem::FileView::Slice(_file, entry.offset, entry.size);
+    }
+
+    std::vector<char> contents(entry.size);
+    if (!LZ4::Decompress(_file->Data() + entry.offset, entry.storedSize, contents.data(), contents.size()))
+    {
+        throw std::runtime_error("Failed to decompress " + GetName(entry) + " from " + _path);
+    }
+    return FileIOSystem::FileView::Adopt(std::move(contents));
+}
+
+std::string Archive::GetName(const ArchiveFormat::ArchiveEntry &entry) const
+{
+    return std::string(_names + entry.nameOffset, entry.nameLength);
+}
+
+// Writes the table of contents as a placeholder first, streams the blobs behind it one file at a time so only one
+// asset is ever in memory, then goes back and fills in the real table.
+void Archive::Pack(const std::string &path, std::vector<Input> inputs, bool compress)
+{
+    std::vector<uint64_t> hashes;
+    std::vector<size_t> order(inputs.size());
+    for (size_t i = 0; i < inputs.size(); i++)
+    {
+        hashes.push_back(ArchiveFormat::HashName(inputs[i].name));
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&](size_t left, size_t right) {
+        return entryLess(hashes[left], inputs[left].name, hashes[right], inputs[right].name);
+    });
+
+    std::vector<ArchiveFormat::ArchiveEntry> entries(inputs.size());
+    std::string names;
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        const Input &input = inputs[order[i]];
+        if (i > 0 && input.name == inputs[order[i - 1]].name)
+        {
+            throw std::runtime_error("Duplicate archive entry: " + input.name);
+        }
+        ArchiveFormat::ArchiveEntry &entry = entries[i];
+        entry = {};
+        entry.nameHash = hashes[order[i]];
+        entry.nameOffset = static_cast<uint32_t>(names.size());
+        entry.nameLength = static_cast<uint32_t>(input.name.size());
+        names += input.name;
+    }
+
+    ArchiveFormat::ArchiveHeader header = {};
+    std::memcpy(header.magic, ArchiveFormat::MAGIC, sizeof(header.magic));
+    header.version = ArchiveFormat::VERSION;
+    header.entryCount = static_cast<uint32_t>(entries.size());
+    header.namesOffset = sizeof(ArchiveFormat::ArchiveHeader) + entries.size() * sizeof(ArchiveFormat::ArchiveEntry);
+    header.namesSize = names.size();
+
+    uint64_t totalSize = 0;
+    uint64_t totalStored = 0;
+    // A mounted archive being replaced keeps its old mapping, new opens get the new archive.
+    FileIOSystem::WriteFile(path, [&](std::ostream &file) {
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char *>(entries.data()), entries.size() * sizeof(ArchiveFormat::ArchiveEntry));
+        file.write(names.data(), names.size());
+
+        uint64_t position = header.namesOffset + header.namesSize;
+        const char padding[ArchiveFormat::BLOB_ALIGNMENT] = {};
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            ArchiveFormat::ArchiveEntry &entry = entries[i];
+            std::shared_ptr<const FileIOSystem::FileView> source = FileIOSystem::FileView::Map(inputs[order[i]].path);
+            entry.size = source->Size();
+
+            const char *stored = source->Data();
+            entry.storedSize = entry.size;
+            entry.compression = ArchiveFormat::COMPRESSION_NONE;
+            std::vector<char> compressed;
+            if (compress && entry.size > 0)
+            {
+                // Not worth a decompression on every load for less than an eighth.
+                compressed = LZ4::Compress(source->Data(), source->Size());
+                if (compressed.size() < entry.size - entry.size / 8)
+                {
+                    stored = compressed.data();
+                    entry.storedSize = compressed.size();
+                    entry.compression = ArchiveFormat::COMPRESSION_LZ4;
+                }
+            }
+
+            uint64_t aligned = alignUp(position, ArchiveFormat::BLOB_ALIGNMENT);
+            file.write(padding, aligned - position);
+            entry.offset = aligned;
+            file.write(stored, entry.storedSize);
+            position = aligned + entry.storedSize;
+            totalSize += entry.size;
+            totalStored += entry.storedSize;
+        }
+
+        file.seekp(sizeof(ArchiveFormat::ArchiveHeader));
+        file.write(reinterpret_cast<const char *>(entries.data()), entries.size() * sizeof(ArchiveFormat::ArchiveEntry));
+    });
+    std::cout << "Packed " << entries.size() << " files, " << totalSize << " bytes stored as " << totalStored << ", into " << path << std::endl;
+}
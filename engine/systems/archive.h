@@ -0,0 +1,97 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdint>
+
+#include "fileio.h"
+
+// A packed asset archive, every asset in one file that is mapped once. Built by tools/assetpacker at build time.
+//
+//     ArchiveHeader
+//     ArchiveEntry[entryCount]   sorted by (nameHash, name), looked up with a binary search
+//     names                      entry names back to back, not null terminated
+//     blobs                      each starting on a BLOB_ALIGNMENT boundary
+//
+// Names are paths relative to the packed directory with forward slashes, like "shaders/vert.spv".
+// Entries are LZ4 compressed only when that saves at least an eighth, everything else (SPIR-V mostly) is stored
+// as is and handed out as a slice of the mapping, no copy at all. Everything is little endian.
+namespace ArchiveFormat
+{
+    const char MAGIC[4] = {'R', 'P', 'A', 'K'};
+    const uint32_t VERSION = 1;
+    // Covers SPIR-V's 4 byte words and lets anything up to a vec4 be read in place.
+    const uint64_t BLOB_ALIGNMENT = 16;
+
+    enum Compression : uint32_t
+    {
+        COMPRESSION_NONE = 0,
+        COMPRESSION_LZ4 = 1,
+    };
+
+    struct ArchiveHeader
+    {
+        char magic[4];
+        uint32_t version;
+        uint32_t entryCount;
+        uint32_t reserved;
+        uint64_t namesOffset;
+        uint64_t namesSize;
+    };
+
+    struct ArchiveEntry
+    {
+        // FNV-1a of the name.
+        uint64_t nameHash;
+        uint64_t offset;
+        // Bytes in the archive, smaller than size when compressed.
+        uint64_t storedSize;
+        uint64_t size;
+        uint32_t nameOffset;
+        uint32_t nameLength;
+        uint32_t compression;
+        uint32_t reserved;
+    };
+
+    static_assert(sizeof(ArchiveHeader) == 32, "ArchiveHeader is read straight from the file");
+    static_assert(sizeof(ArchiveEntry) == 48, "ArchiveEntry is read straight from the file");
+
+    uint64_t HashName(const std::string &name);
+}
+
+class Archive
+{
+  public:
+    // A file to pack: the name it is looked up by and where it is read from.
+    struct Input
+    {
+        std::string name;
+        std::string path;
+    };
+
+    // Maps the archive and checks that the header and every entry stay inside the file, throws if they don't.
+    static std::shared_ptr<const Archive> Open(const std::string &path);
+    // Writes a new archive, throws on duplicate names. compress = false stores every entry as is.
+    static void Pack(const std::string &path, std::vector<Input> inputs, bool compress);
+
+    // nullptr if there is no such entry.
+    const ArchiveFormat::ArchiveEntry *Find(const std::string &name) const;
+    // Stored entries are a view into the archive's mapping, compressed ones are decompressed into a view of their own.
+    // Throws if a compressed entry is corrupt.
+    std::shared_ptr<const FileIOSystem::FileView> Read(const ArchiveFormat::ArchiveEntry &entry) const;
+
+    uint32_t GetEntryCount() const { return _header->entryCount; }
+    const ArchiveFormat::ArchiveEntry &GetEntry(uint32_t index) const { return _entries[index]; }
+    std::string GetName(const ArchiveFormat::ArchiveEntry &entry) const;
+
+  private:
+    std::string _path;
+    std::shared_ptr<const FileIOSystem::FileView> _file;
+    const ArchiveFormat::ArchiveHeader *_header = nullptr;
+    const ArchiveFormat::ArchiveEntry *_entries = nullptr;
+    const char *_names = nullptr;
+};
+
+#endif
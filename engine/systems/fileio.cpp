@@ -1,8 +1,244 @@
 #include <vector>
 #include <string>
 #include <fstream>
+#include <iostream>
+#include <cstdio>
+#include <stdexcept>
+#include <mutex>
+#include <unordered_map>
+#include <cerrno>
+#include <cstring>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
 #include "fileio.h"
+#include "archive.h"
+
+namespace
+{
+    struct MountedArchive
+    {
+        // With a trailing slash, "assets/".
+        std::string prefix;
+        std::shared_ptr<const Archive> archive;
+    };
+
+    std::mutex fileCacheMutex;
+    std::unordered_map<std::string, std::shared_ptr<const FileIOSystem::FileView>> fileCache;
+    // Guarded by fileCacheMutex as well.
+    std::vector<MountedArchive> mountedArchives;
+
+    // "./assets/a.spv" and "assets/a.spv" are the same entry.
+    std::string stripCurrentDirectory(const std::string &filename)
+    {
+        size_t start = 0;
+        while (filename.compare(start, 2, "./") == 0)
+        {
+            start += 2;
+        }
+        return filename.substr(start);
+    }
+
+    std::shared_ptr<const FileIOSystem::FileView> openFromArchives(const std::string &filename)
+    {
+        std::string path = stripCurrentDirectory(filename);
+        std::vector<MountedArchive> archives;
+        {
+            std::lock_guard<std::mutex> lock(fileCacheMutex);
+            archives = mountedArchives;
+        }
+        for (std::vector<MountedArchive>::reverse_iterator mounted = archives.rbegin(); mounted != archives.rend(); mounted++)
+        {
+            if (path.compare(0, mounted->prefix.size(), mounted->prefix) != 0)
+            {
+                continue;
+            }
+            const ArchiveFormat::ArchiveEntry *entry = mounted->archive->Find(path.substr(mounted->prefix.size()));
+            if (entry != nullptr)
+            {
+                return mounted->archive->Read(*entry);
+            }
+        }
+        return nullptr;
+    }
+}
+
+FileIOSystem::FileView::~FileView()
+{
+    if (_mapping != nullptr)
+    {
+#ifdef _WIN32
+        UnmapViewOfFile(_mapping);
+#else
+        munmap(_mapping, _mappingSize);
+#endif
+    }
+}
+
+#ifdef _WIN32
+// The same read-only mapping through a file mapping object. Views are aligned to the allocation granularity (64KB),
+// which covers everything the page alignment does on other platforms.
+// https://learn.microsoft.com/en-us/windows/win32/memory/creating-a-file-mapping-object
+std::shared_ptr<const FileIOSystem::FileView> FileIOSystem::FileView::Map(const std::string &filename)
+{
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        throw std::runtime_error("Failed to open file: " + filename + " (error " + std::to_string(GetLastError()) + ")");
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize))
+    {
+        CloseHandle(file);
+        throw std::runtime_error("Failed to stat file: " + filename);
+    }
+
+    std::shared_ptr<FileView> view = std::make_shared<FileView>();
+    view->_size = static_cast<size_t>(fileSize.QuadPart);
+    // Mapping objects can't be empty either, an empty file is just an empty view.
+    if (view->_size > 0)
+    {
+        HANDLE mappingObject = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        void *mapping = mappingObject != nullptr ? MapViewOfFile(mappingObject, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        DWORD error = GetLastError();
+        if (mappingObject != nullptr)
+        {
+            // The view keeps its own reference to the mapping object.
+            CloseHandle(mappingObject);
+        }
+        if (mapping == nullptr)
+        {
+            CloseHandle(file);
+            throw std::runtime_error("Failed to map file: " + filename + " (error " + std::to_string(error) + ")");
+        }
+        view->_mapping = mapping;
+        view->_mappingSize = view->_size;
+        view->_data = static_cast<const char *>(mapping);
+    }
+    CloseHandle(file);
+    return view;
+}
+#else
+std::shared_ptr<const FileIOSystem::FileView> FileIOSystem::FileView::Map(const std::string &filename)
+{
+    int descriptor = open(filename.c_str(), O_RDONLY);
+    if (descriptor < 0)
+    {
+        throw std::runtime_error("Failed to open file: " + filename + " (" + std::strerror(errno) + ")");
+    }
+
+    struct stat status;
+    if (fstat(descriptor, &status) != 0)
+    {
+        close(descriptor);
+        throw std::runtime_error("Failed to stat file: " + filename);
+    }
+
+    std::shared_ptr<FileView> view = std::make_shared<FileView>();
+    view->_size = static_cast<size_t>(status.st_size);
+    // mmap refuses zero length mappings, an empty file is just an empty view.
+    if (view->_size > 0)
+    {
+        void *mapping = mmap(nullptr, view->_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        if (mapping == MAP_FAILED)
+        {
+            close(descriptor);
+            throw std::runtime_error("Failed to map file: " + filename + " (" + std::strerror(errno) + ")");
+        }
+        view->_mapping = mapping;
+        view->_mappingSize = view->_size;
+        view->_data = static_cast<const char *>(mapping);
+    }
+    // The mapping keeps its own reference to the file.
+    close(descriptor);
+    return view;
+}
+#endif
+
+std::shared_ptr<const FileIOSystem::FileView> FileIOSystem::OpenFile(const std::string &filename)
+{
+    {
+        std::lock_guard<std::mutex> lock(fileCacheMutex);
+        std::unordered_map<std::string, std::shared_ptr<const FileView>>::iterator cached = fileCache.find(filename);
+        if (cached != fileCache.end())
+        {
+            return cached->second;
+        }
+    }
+
+    // Mapped outside the lock so a slow disk doesn't block every other lookup. Two threads racing on the same
+    // path both map it, and the first one to get back into the cache wins.
+    std::shared_ptr<const FileView> view = openFromArchives(filename);
+    if (view == nullptr)
+    {
+        view = FileView::Map(filename);
+    }
+    std::lock_guard<std::mutex> lock(fileCacheMutex);
+    return fileCache.emplace(filename, view).first->second;
+}
+
+std::shared_ptr<const FileIOSystem::FileView> FileIOSystem::FileView::Slice(const std::shared_ptr<const FileView> &parent, size_t offset, size_t size)
+{
+    if (offset > parent->Size() || size > parent->Size() - offset)
+    {
+        throw std::runtime_error("File view slice is out of bounds.");
+    }
+    std::shared_ptr<FileView> view = std::make_shared<FileView>();
+    view->_parent = parent;
+    view->_data = parent->Data() + offset;
+    view->_size = size;
+    return view;
+}
+
+std::shared_ptr<const FileIOSystem::FileView> FileIOSystem::FileView::Adopt(std::vector<char> &&contents)
+{
+    std::shared_ptr<FileView> view = std::make_shared<FileView>();
+    view->_contents = std::move(contents);
+    view->_data = view->_contents.data();
+    view->_size = view->_contents.size();
+    return view;
+}
+
+void FileIOSystem::MountArchive(const std::string &archivePath, const std::string &mountPoint)
+{
+    std::cout << "Mounting asset archive " << archivePath << " at " << mountPoint << "..." << std::endl;
+    std::shared_ptr<const Archive> archive = Archive::Open(archivePath);
+    std::string prefix = stripCurrentDirectory(mountPoint);
+    if (!prefix.empty() && prefix.back() != '/')
+    {
+        prefix += '/';
+    }
+    std::lock_guard<std::mutex> lock(fileCacheMutex);
+    mountedArchives.push_back({prefix, archive});
+    std::cout << "Archive has " << archive->GetEntryCount() << " entries" << std::endl;
+}
+
+void FileIOSystem::UnmountArchives()
+{
+    std::lock_guard<std::mutex> lock(fileCacheMutex);
+    mountedArchives.clear();
+}
+
+void FileIOSystem::InvalidateFile(const std::string &filename)
+{
+    std::lock_guard<std::mutex> lock(fileCacheMutex);
+    fileCache.erase(filename);
+}
+
+void FileIOSystem::ClearFileCache()
+{
+    std::lock_guard<std::mutex> lock(fileCacheMutex);
+    fileCache.clear();
+}
 
 std::vector<char> FileIOSystem::ReadFileToVector(const std::string &filename)
 {
@@ -12,11 +248,61 @@ std::vector<char> FileIOSystem::ReadFileToVector(const std::string &filename)
         throw std::runtime_error("Failed to open file: " + filename);
     }
 
-    uint32_t size = file.tellg();
+    // Not uint32_t, files past 4GB would silently come back truncated.
+    size_t size = static_cast<size_t>(file.tellg());
     std::vector<char> fileContents(size);
     file.seekg(0);
     file.read(fileContents.data(), size);
     file.close();
 
     return fileContents;
+}
+
+bool FileIOSystem::FileExists(const std::string &filename)
+{
+    std::ifstream file(filename, std::ifstream::binary);
+    return file.is_open();
+}
+
+void FileIOSystem::WriteVectorToFile(const std::string &filename, const std::vector<char> &contents)
+{
+    WriteFile(filename, [&contents](std::ostream &file) { file.write(contents.data(), contents.size()); });
+}
+
+void FileIOSystem::WriteFile(const std::string &filename, const std::function<void(std::ostream &file)> &write)
+{
+    std::string temporaryName = filename + ".tmp";
+    {
+        std::ofstream file(temporaryName, std::ofstream::binary | std::ofstream::trunc);
+        if (!file.is_open())
+        {
+            throw std::runtime_error("Failed to open file for writing: " + temporaryName);
+        }
+        try
+        {
+            write(file);
+        }
+        catch (...)
+        {
+            file.close();
+            std::remove(temporaryName.c_str());
+            throw;
+        }
+        file.close();
+        if (!file)
+        {
+            std::remove(temporaryName.c_str());
+            throw std::runtime_error("Failed to write file: " + temporaryName);
+        }
+    }
+
+    // POSIX rename replaces the target in one step, readers see either the old file or the new one. Windows
+    // refuses to rename over an existing file, so there it has to go first and the replace isn't atomic.
+#ifdef _WIN32
+    std::remove(filename.c_str());
+#endif
+    if (std::rename(temporaryName.c_str(), filename.c_str()) != 0)
+    {
+        throw std::runtime_error("Failed to replace file: " + filename);
+    }
 }
\ No newline at end of file
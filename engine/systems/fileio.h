@@ -3,10 +3,85 @@
 
 #include <vector>
 #include <string>
+#include <memory>
+#include <functional>
+#include <iosfwd>
+#include <cstddef>
+#include <cstdint>
 
 namespace FileIOSystem
 {
+    // A read-only, contiguous range of bytes inside a FileView. Only valid while the view is alive.
+    struct Span
+    {
+        const char *data = nullptr;
+        size_t size = 0;
+
+        // SPIR-V is consumed as 32 bit words. Views start on a page boundary or, for archive entries, a 16 byte one,
+        // so any span at a multiple of 4 bytes is aligned for it.
+        const uint32_t *Words() const { return reinterpret_cast<const uint32_t *>(data); }
+        size_t WordCount() const { return size / sizeof(uint32_t); }
+        Span Subspan(size_t offset, size_t length) const { return {data + offset, length}; }
+    };
+
+    // A whole file mapped read-only into memory. Nothing is read or copied up front, the OS pages the file in on first touch
+    // and can drop those pages again under memory pressure, so large assets never cost a heap copy.
+    // The mapping starts on a page boundary, which covers the 4 byte alignment Vulkan wants for shader code.
+    // mmap everywhere but Windows, which maps through CreateFileMapping and MapViewOfFile instead.
+    // https://man7.org/linux/man-pages/man2/mmap.2.html
+    class FileView
+    {
+      public:
+        FileView() = default;
+        ~FileView();
+        FileView(const FileView &) = delete;
+        FileView &operator=(const FileView &) = delete;
+
+        // Throws if the file can't be opened or mapped. Empty files map to an empty span.
+        static std::shared_ptr<const FileView> Map(const std::string &filename);
+        // A range of another view that keeps the whole parent alive, how archive entries are handed out without a copy.
+        static std::shared_ptr<const FileView> Slice(const std::shared_ptr<const FileView> &parent, size_t offset, size_t size);
+        // Bytes that don't live in any file, like a decompressed archive entry. Heap blocks are at least 16 byte aligned.
+        static std::shared_ptr<const FileView> Adopt(std::vector<char> &&contents);
+
+        const char *Data() const { return _data; }
+        size_t Size() const { return _size; }
+        Span GetSpan() const { return {_data, _size}; }
+
+      private:
+        const char *_data = nullptr;
+        size_t _size = 0;
+        void *_mapping = nullptr;
+        size_t _mappingSize = 0;
+        std::shared_ptr<const FileView> _parent;
+        std::vector<char> _contents;
+    };
+
+    // Maps a file through a cache keyed by path, so loading the same file again (shaders on every pipeline rebuild)
+    // is a map lookup. The cache holds on to every view until it is invalidated, files changed on disk since
+    // aren't noticed before that. Paths under a mounted archive are served from the archive, and only fall back to
+    // loose files for entries it doesn't have. Safe to call from any thread.
+    std::shared_ptr<const FileView> OpenFile(const std::string &filename);
+    // Serves "<mountPoint>/<entry>" paths from an archive written by the asset packer, e.g. mounting "./assets.pak"
+    // at "assets" makes "./assets/shaders/vert.spv" its "shaders/vert.spv" entry. Archives mounted later win.
+    // One open() and one mapping for every asset instead of one each. Call before loading anything, mounting
+    // doesn't drop files that are already cached.
+    void MountArchive(const std::string &archivePath, const std::string &mountPoint);
+    void UnmountArchives();
+    // Drops the cache's reference. Views already handed out stay valid until their last owner lets go.
+    void InvalidateFile(const std::string &filename);
+    void ClearFileCache();
+
+    // Copies the whole file, for callers that need to own or modify the bytes. Prefer OpenFile for assets.
+    // This and the functions below only ever touch loose files, never archive entries.
     std::vector<char> ReadFileToVector(const std::string &filename);
+    bool FileExists(const std::string &filename);
+    // Writes to a temporary file first and renames it over `filename`, so a crash mid-write never leaves a truncated file behind.
+    void WriteVectorToFile(const std::string &filename, const std::vector<char> &contents);
+    // The same for files written piece by piece: `write` gets the temporary file, which is renamed over `filename`
+    // once everything was written. If write throws or the stream fails, the temporary file is deleted and `filename`
+    // is left as it was.
+    void WriteFile(const std::string &filename, const std::function<void(std::ostream &file)> &write);
 }
 
 
@@ -0,0 +1,174 @@
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+
+#include "imagefile.h"
+
+namespace
+{
+    const size_t TGA_HEADER_SIZE = 18;
+    const uint8_t TGA_TRUE_COLOR = 2;
+    const uint8_t TGA_GRAYSCALE = 3;
+    const uint8_t TGA_RLE_TRUE_COLOR = 10;
+    const uint8_t TGA_RLE_GRAYSCALE = 11;
+    const uint8_t TGA_RIGHT_TO_LEFT = 0x10;
+    const uint8_t TGA_TOP_TO_BOTTOM = 0x20;
+
+    uint16_t readU16(const uint8_t *bytes)
+    {
+        return static_cast<uint16_t>(bytes[0] | bytes[1] << 8);
+    }
+
+    // TGA stores BGR(A), grayscale is a single channel.
+    void toRGBA(const uint8_t *source, uint32_t bytesPerPixel, uint8_t *destination)
+    {
+        if (bytesPerPixel == 1)
+        {
+            destination[0] = source[0];
+            destination[1] = source[0];
+            destination[2] = source[0];
+            destination[3] = 255;
+            return;
+        }
+        destination[0] = source[2];
+        destination[1] = source[1];
+        destination[2] = source[0];
+        destination[3] = bytesPerPixel == 4 ? source[3] : 255;
+    }
+}
+
+ImageFile::Pixels ImageFile::DecodeTGA(const FileIOSystem::Span &file)
+{
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(file.data);
+    if (file.size < TGA_HEADER_SIZE)
+    {
+        throw std::runtime_error("TGA file is too small for a header.");
+    }
+    uint8_t idLength = bytes[0];
+    uint8_t colorMapType = bytes[1];
+    uint8_t imageType = bytes[2];
+    uint16_t colorMapLength = readU16(bytes + 5);
+    uint8_t colorMapEntryBits = bytes[7];
+    uint32_t width = readU16(bytes + 12);
+    uint32_t height = readU16(bytes + 14);
+    uint8_t pixelDepth = bytes[16];
+    uint8_t descriptor = bytes[17];
+
+    bool grayscale = imageType == TGA_GRAYSCALE || imageType == TGA_RLE_GRAYSCALE;
+    bool rle = imageType == TGA_RLE_TRUE_COLOR || imageType == TGA_RLE_GRAYSCALE;
+    if (imageType != TGA_TRUE_COLOR && !grayscale && !rle)
+    {
+        throw std::runtime_error("Unsupported TGA image type " + std::to_string(imageType) + ", only true color and grayscale are.");
+    }
+    if ((grayscale && pixelDepth != 8) || (!grayscale && pixelDepth != 24 && pixelDepth != 32))
+    {
+        throw std::runtime_error("Unsupported TGA pixel depth " + std::to_string(pixelDepth) + ".");
+    }
+    if (width == 0 || height == 0)
+    {
+        throw std::runtime_error("TGA image is empty.");
+    }
+
+    // A true color image may still carry an unused color map, which sits between the id and the pixels.
+    size_t offset = TGA_HEADER_SIZE + idLength;
+    if (colorMapType == 1)
+    {
+        offset += static_cast<size_t>(colorMapLength) * ((colorMapEntryBits + 7) / 8);
+    }
+
+    uint32_t bytesPerPixel = pixelDepth / 8;
+    size_t pixelCount = static_cast<size_t>(width) * height;
+    // Decoded in file order first, the rows are put top to bottom afterwards.
+    std::vector<uint8_t> decoded(pixelCount * 4);
+    if (!rle)
+    {
+        if (offset > file.size || file.size - offset < pixelCount * bytesPerPixel)
+        {
+            throw std::runtime_error("TGA pixel data is truncated.");
+        }
+        for (size_t i = 0; i < pixelCount; i++)
+        {
+            toRGBA(bytes + offset + i * bytesPerPixel, bytesPerPixel, &decoded[i * 4]);
+        }
+    }
+    else
+    {
+        // Run length packets: a header byte with the high bit set repeats the one pixel that follows (low 7 bits + 1)
+        // times, otherwise (low 7 bits + 1) raw pixels follow. Packets may run across rows.
+        size_t pixel = 0;
+        while (pixel < pixelCount)
+        {
+            if (offset >= file.size)
+            {
+                throw std::runtime_error("TGA run length data is truncated.");
+            }
+            uint8_t packet = bytes[offset++];
+            size_t count = std::min<size_t>((packet & 0x7F) + 1, pixelCount - pixel);
+            if (packet & 0x80)
+            {
+                if (file.size - offset < bytesPerPixel)
+                {
+                    throw std::runtime_error("TGA run length data is truncated.");
+                }
+                uint8_t rgba[4];
+                toRGBA(bytes + offset, bytesPerPixel, rgba);
+                for (size_t i = 0; i < count; i++)
+                {
+                    memcpy(&decoded[(pixel + i) * 4], rgba, 4);
+                }
+                offset += bytesPerPixel;
+            }
+            else
+            {
+                if (file.size - offset < count * bytesPerPixel)
+                {
+                    throw std::runtime_error("TGA run length data is truncated.");
+                }
+                for (size_t i = 0; i < count; i++)
+                {
+                    toRGBA(bytes + offset + i * bytesPerPixel, bytesPerPixel, &decoded[(pixel + i) * 4]);
+                }
+                offset += count * bytesPerPixel;
+            }
+            pixel += count;
+        }
+    }
+
+    // Bottom to top is the default, top to bottom is what most editors write nowadays.
+    Pixels pixels;
+    pixels.width = width;
+    pixels.height = height;
+    bool flipRows = (descriptor & TGA_TOP_TO_BOTTOM) == 0;
+    bool flipColumns = (descriptor & TGA_RIGHT_TO_LEFT) != 0;
+    if (!flipRows && !flipColumns)
+    {
+        pixels.rgba = std::move(decoded);
+        return pixels;
+    }
+    pixels.rgba.resize(decoded.size());
+    for (uint32_t y = 0; y < height; y++)
+    {
+        uint32_t sourceY = flipRows ? height - 1 - y : y;
+        for (uint32_t x = 0; x < width; x++)
+        {
+            uint32_t sourceX = flipColumns ? width - 1 - x : x;
+            memcpy(&pixels.rgba[(static_cast<size_t>(y) * width + x) * 4], &decoded[(static_cast<size_t>(sourceY) * width + sourceX) * 4], 4);
+        }
+    }
+    return pixels;
+}
+
+ImageFile::Pixels ImageFile::Load(const std::string &path)
+{
+    std::shared_ptr<const FileIOSystem::FileView> file = FileIOSystem::OpenFile(path);
+    try
+    {
+        return DecodeTGA(file->GetSpan());
+    }
+    catch (const std::runtime_error &e)
+    {
+        throw std::runtime_error(path + ": " + e.what());
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef IMAGEFILE_H
+#define IMAGEFILE_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include "fileio.h"
+
+// Decodes images into plain RGBA8 pixels for the texture cache and the atlas builder.
+// Only Truevision TGA for now: every pixel art editor exports it, it stores straight alpha, and raw or RLE
+// pixel data is simple enough that no image library is needed. Grayscale loads as opaque gray.
+// http://www.paulbourke.net/dataformats/tga/
+namespace ImageFile
+{
+    // Tightly packed RGBA8 rows, top row first.
+    struct Pixels
+    {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        std::vector<uint8_t> rgba;
+    };
+
+    // Throws on anything that isn't an uncompressed or RLE true color / grayscale TGA, or that is truncated.
+    Pixels DecodeTGA(const FileIOSystem::Span &file);
+    // Reads through FileIOSystem::OpenFile, so images inside a mounted archive load the same way as loose ones.
+    Pixels Load(const std::string &path);
+}
+
+#endif
@@ -0,0 +1,343 @@
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <stdexcept>
+
+#include "jobsystem.h"
+
+namespace
+{
+    // Jobs that don't fit into a full deque run inline on the submitting thread instead of allocating.
+    const uint32_t DEQUE_CAPACITY = 4096;
+    // Rounds of failed stealing before a worker goes to sleep.
+    const int SPIN_ROUNDS = 64;
+
+    // A fixed size ring with a short lock around each operation. Pushing and popping are a handful of instructions,
+    // so the lock is almost never contended, and it keeps stealing obviously correct compared to a lock-free deque.
+    struct WorkerQueue
+    {
+        std::mutex mutex;
+        std::vector<JobSystem::Job> jobs = std::vector<JobSystem::Job>(DEQUE_CAPACITY);
+        uint32_t top = 0;    // Next job to steal
+        uint32_t bottom = 0; // One past the newest job
+        std::atomic<uint64_t> executed{0};
+        std::atomic<uint64_t> stolen{0};
+
+        bool PushBack(const JobSystem::Job &job)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (bottom - top == DEQUE_CAPACITY)
+            {
+                return false;
+            }
+            jobs[bottom % DEQUE_CAPACITY] = job;
+            bottom += 1;
+            return true;
+        }
+
+        // Owner side: newest first, its data is most likely still in cache.
+        bool PopBack(JobSystem::Job &job)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (bottom == top)
+            {
+                return false;
+            }
+            bottom -= 1;
+            job = jobs[bottom % DEQUE_CAPACITY];
+            return true;
+        }
+
+        // Thief side: oldest first, which tends to be the biggest piece of remaining work.
+        bool PopFront(JobSystem::Job &job)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (bottom == top)
+            {
+                return false;
+            }
+            job = jobs[top % DEQUE_CAPACITY];
+            top += 1;
+            return true;
+        }
+    };
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::vector<std::thread> threads;
+    std::atomic<bool> running{false};
+    std::atomic<uint32_t> queuedJobs{0};
+    std::atomic<uint32_t> nextExternalQueue{0};
+
+    std::mutex sleepMutex;
+    std::condition_variable sleepCondition;
+    std::atomic<uint32_t> sleepingWorkers{0};
+
+    std::mutex mainThreadMutex;
+    std::vector<JobSystem::Job> mainThreadJobs;
+    // Lets a pump with nothing queued return without the lock, Wait on the main thread pumps on every spin.
+    std::atomic<uint32_t> mainThreadPending{0};
+    // Swapped with mainThreadJobs each pump, so both keep their capacity and a steady frame doesn't allocate.
+    std::vector<JobSystem::Job> mainThreadBatch;
+    bool mainThreadPumping = false;
+    std::atomic<uint64_t> mainThreadExecuted{0};
+
+    thread_local int32_t currentWorker = -1;
+
+    void execute(const JobSystem::Job &job)
+    {
+        job.function(job);
+        if (job.counter != nullptr)
+        {
+            job.counter->pending.fetch_sub(1, std::memory_order_acq_rel);
+        }
+    }
+
+    // Own deque first, then every other deque starting after our own so thieves spread out.
+    // Threads outside the job system (index -1) can only steal.
+    bool findJob(int32_t self, JobSystem::Job &job)
+    {
+        if (self >= 0 && queues[self]->PopBack(job))
+        {
+            queuedJobs.fetch_sub(1);
+            return true;
+        }
+        uint32_t count = static_cast<uint32_t>(queues.size());
+        uint32_t start = self >= 0 ? static_cast<uint32_t>(self) + 1 : 0;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            uint32_t victim = (start + i) % count;
+            if (static_cast<int32_t>(victim) == self)
+            {
+                continue;
+            }
+            if (queues[victim]->PopFront(job))
+            {
+                queuedJobs.fetch_sub(1);
+                if (self >= 0)
+                {
+                    queues[self]->stolen.fetch_add(1, std::memory_order_relaxed);
+                }
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Jobs queued while these run go out with the next pump, so a job that requeues itself can't starve the frame.
+    void runMainThreadJobs(std::vector<JobSystem::Job> &jobs)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mainThreadMutex);
+            jobs.swap(mainThreadJobs);
+            mainThreadPending.store(0, std::memory_order_relaxed);
+        }
+        for (const JobSystem::Job &job : jobs)
+        {
+            execute(job);
+        }
+        mainThreadExecuted.fetch_add(jobs.size(), std::memory_order_relaxed);
+    }
+
+    void runJob(int32_t self, const JobSystem::Job &job)
+    {
+        execute(job);
+        if (self >= 0)
+        {
+            queues[self]->executed.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void workerLoop(int32_t index)
+    {
+        currentWorker = index;
+        int idleRounds = 0;
+        while (running.load(std::memory_order_acquire))
+        {
+            JobSystem::Job job;
+            if (findJob(index, job))
+            {
+                runJob(index, job);
+                idleRounds = 0;
+                continue;
+            }
+            if (++idleRounds < SPIN_ROUNDS)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+
+            // Submit only takes the lock when it sees a sleeper, so the counter has to go up before checking for work.
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            sleepingWorkers.fetch_add(1);
+            sleepCondition.wait(lock, [] { return !running.load() || queuedJobs.load() > 0; });
+            sleepingWorkers.fetch_sub(1);
+            idleRounds = 0;
+        }
+    }
+}
+
+void JobSystem::Init(uint32_t workerThreads)
+{
+    if (running.load())
+    {
+        throw std::runtime_error("Job system is already running.");
+    }
+    if (workerThreads == 0)
+    {
+        uint32_t hardwareThreads = std::thread::hardware_concurrency();
+        workerThreads = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+    }
+
+    queues.clear();
+    for (uint32_t i = 0; i < workerThreads + 1; i++)
+    {
+        queues.push_back(std::make_unique<WorkerQueue>());
+    }
+    queuedJobs.store(0);
+    currentWorker = 0;
+    running.store(true);
+    for (uint32_t i = 1; i < workerThreads + 1; i++)
+    {
+        threads.emplace_back(workerLoop, static_cast<int32_t>(i));
+    }
+}
+
+void JobSystem::Shutdown()
+{
+    if (!running.load())
+    {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        running.store(false);
+    }
+    sleepCondition.notify_all();
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+    threads.clear();
+    queues.clear();
+    mainThreadJobs.clear();
+    mainThreadBatch.clear();
+    mainThreadPending.store(0);
+    currentWorker = -1;
+}
+
+uint32_t JobSystem::GetWorkerCount()
+{
+    return static_cast<uint32_t>(queues.size());
+}
+
+int32_t JobSystem::GetCurrentWorkerIndex()
+{
+    return currentWorker;
+}
+
+void JobSystem::Submit(const Job &job)
+{
+    if (job.counter != nullptr)
+    {
+        job.counter->pending.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    int32_t self = currentWorker;
+    uint32_t queue = self >= 0 ? static_cast<uint32_t>(self) : nextExternalQueue.fetch_add(1) % GetWorkerCount();
+    // Counted before it is visible so a thief can never take it before the count goes up.
+    queuedJobs.fetch_add(1);
+    if (!queues[queue]->PushBack(job))
+    {
+        queuedJobs.fetch_sub(1);
+        runJob(self, job);
+        return;
+    }
+
+    if (sleepingWorkers.load() > 0)
+    {
+        // Taking the lock orders this against a worker that is between checking for work and going to sleep.
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        lock.unlock();
+        sleepCondition.notify_one();
+    }
+}
+
+void JobSystem::SubmitToMainThread(const Job &job)
+{
+    if (job.counter != nullptr)
+    {
+        job.counter->pending.fetch_add(1, std::memory_order_relaxed);
+    }
+    std::lock_guard<std::mutex> lock(mainThreadMutex);
+    mainThreadJobs.push_back(job);
+    mainThreadPending.fetch_add(1, std::memory_order_release);
+}
+
+void JobSystem::PumpMainThread()
+{
+    if (currentWorker != 0)
+    {
+        throw std::runtime_error("PumpMainThread called off the main thread.");
+    }
+    if (mainThreadPending.load(std::memory_order_acquire) == 0)
+    {
+        return;
+    }
+    // A job that waits pumps again while the shared batch is still being walked, only that nested pump gets a batch of its own.
+    if (mainThreadPumping)
+    {
+        std::vector<Job> jobs;
+        runMainThreadJobs(jobs);
+        return;
+    }
+    mainThreadPumping = true;
+    runMainThreadJobs(mainThreadBatch);
+    mainThreadBatch.clear();
+    mainThreadPumping = false;
+}
+
+void JobSystem::Wait(Counter &counter)
+{
+    int32_t self = currentWorker;
+    while (!counter.IsDone())
+    {
+        // The main thread also has to keep draining its own queue, a worker job may be waiting on one of those.
+        if (self == 0)
+        {
+            PumpMainThread();
+        }
+        Job job;
+        if (findJob(self, job))
+        {
+            runJob(self, job);
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+JobSystem::Stats JobSystem::GetStats()
+{
+    Stats stats;
+    for (const std::unique_ptr<WorkerQueue> &queue : queues)
+    {
+        stats.jobsExecuted += queue->executed.load(std::memory_order_relaxed);
+        stats.jobsStolen += queue->stolen.load(std::memory_order_relaxed);
+    }
+    stats.mainThreadJobs = mainThreadExecuted.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void JobSystem::ResetStats()
+{
+    for (const std::unique_ptr<WorkerQueue> &queue : queues)
+    {
+        queue->executed.store(0, std::memory_order_relaxed);
+        queue->stolen.store(0, std::memory_order_relaxed);
+    }
+    mainThreadExecuted.store(0, std::memory_order_relaxed);
+}
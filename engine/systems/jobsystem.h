@@ -0,0 +1,127 @@
+#ifndef JOBSYSTEM_H
+#define JOBSYSTEM_H
+
+#include <atomic>
+#include <new>
+#include <algorithm>
+#include <type_traits>
+#include <cstddef>
+#include <cstdint>
+
+// Work-stealing task scheduler shared by the whole engine.
+// Every worker (the main thread is worker 0) owns a deque: it pushes and pops its own jobs at the back,
+// idle workers steal from the front of someone else's. Jobs signal a Counter when they finish, and
+// waiting on a counter runs other jobs instead of blocking, which is how dependencies are expressed:
+// a job that needs other work done spawns it with a counter and waits on that counter.
+// Jobs must not throw, catch inside the job and hand the error back through the captured state.
+// https://www.gdcvault.com/play/1022186/Parallelizing-the-Naughty-Dog-Engine
+namespace JobSystem
+{
+    // Jobs are copied around as raw bytes, so a lambda has to fit here and be trivially copyable.
+    // Capture a pointer to anything larger.
+    const size_t JOB_PAYLOAD_SIZE = 48;
+
+    struct Counter
+    {
+        std::atomic<uint32_t> pending{0};
+
+        Counter() = default;
+        Counter(const Counter &) = delete;
+        Counter &operator=(const Counter &) = delete;
+        bool IsDone() const { return pending.load(std::memory_order_acquire) == 0; }
+    };
+
+    struct Job
+    {
+        void (*function)(const Job &job) = nullptr;
+        Counter *counter = nullptr;
+        alignas(16) unsigned char payload[JOB_PAYLOAD_SIZE];
+    };
+
+    struct Stats
+    {
+        uint64_t jobsExecuted = 0;
+        uint64_t jobsStolen = 0;
+        uint64_t mainThreadJobs = 0;
+    };
+
+    template <typename F>
+    Job MakeJob(const F &body, Counter *counter)
+    {
+        static_assert(sizeof(F) <= JOB_PAYLOAD_SIZE, "Job captures too much, capture a pointer to the data instead.");
+        static_assert(alignof(F) <= 16, "Job capture is over-aligned.");
+        static_assert(std::is_trivially_copyable<F>::value, "Job captures have to be trivially copyable.");
+        Job job;
+        job.counter = counter;
+        ::new (static_cast<void *>(job.payload)) F(body);
+        job.function = [](const Job &self) { (*reinterpret_cast<const F *>(self.payload))(); };
+        return job;
+    }
+
+    // Starts workerThreads threads next to the calling thread, which becomes the main thread (worker 0).
+    // 0 picks one thread per remaining hardware thread, always at least one.
+    void Init(uint32_t workerThreads = 0);
+    // Stops the workers. Anything still queued is dropped, so wait on whatever you spawned first.
+    void Shutdown();
+    // Workers including the main thread.
+    uint32_t GetWorkerCount();
+    // 0 on the main thread, 1..GetWorkerCount()-1 on worker threads, -1 on threads the job system doesn't own.
+    int32_t GetCurrentWorkerIndex();
+
+    // Queues a job on the calling worker's deque. Bumps job.counter right away.
+    void Submit(const Job &job);
+    // Queues a job that only ever runs on the main thread, for SDL and anything else that is thread affine.
+    void SubmitToMainThread(const Job &job);
+    // Runs the main thread jobs queued so far. Called once per frame by the game loop and from Wait on the main thread.
+    void PumpMainThread();
+    // Runs other jobs until the counter reaches zero.
+    void Wait(Counter &counter);
+
+    Stats GetStats();
+    void ResetStats();
+
+    template <typename F>
+    void Run(const F &function, Counter *counter = nullptr)
+    {
+        Submit(MakeJob(function, counter));
+    }
+
+    template <typename F>
+    void RunOnMainThread(const F &function, Counter *counter = nullptr)
+    {
+        SubmitToMainThread(MakeJob(function, counter));
+    }
+
+    // Calls body(begin, end) over [0, count) split into chunks of at least grainSize, and returns once all of them ran.
+    // The calling thread takes the first chunk and helps with the rest while it waits.
+    template <typename F>
+    void ParallelFor(size_t count, size_t grainSize, const F &body)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+        grainSize = std::max<size_t>(grainSize, 1);
+        size_t chunkCount = (count + grainSize - 1) / grainSize;
+        // A few chunks per worker lets stealing even out uneven chunks without paying job overhead per element.
+        chunkCount = std::min<size_t>(chunkCount, static_cast<size_t>(GetWorkerCount()) * 4);
+        if (chunkCount <= 1)
+        {
+            body(static_cast<size_t>(0), count);
+            return;
+        }
+
+        Counter counter;
+        const F *bodyPointer = &body;
+        for (size_t chunk = 1; chunk < chunkCount; chunk++)
+        {
+            size_t begin = count * chunk / chunkCount;
+            size_t end = count * (chunk + 1) / chunkCount;
+            Run([bodyPointer, begin, end]() { (*bodyPointer)(begin, end); }, &counter);
+        }
+        body(static_cast<size_t>(0), count / chunkCount);
+        Wait(counter);
+    }
+}
+
+#endif
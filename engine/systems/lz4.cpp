@@ -0,0 +1,188 @@
+#include <vector>
+#include <cstring>
+#include <cstdint>
+
+#include "lz4.h"
+
+namespace
+{
+    const size_t MIN_MATCH = 4;
+    // The format requires the last 5 bytes to be literals, and the last match to start at least 12 bytes before the end.
+    const size_t LAST_LITERALS = 5;
+    const size_t MATCH_FIND_LIMIT = 12;
+    const size_t MAX_OFFSET = 65535;
+    const int HASH_BITS = 16;
+    const uint32_t EMPTY_SLOT = UINT32_MAX;
+
+    uint32_t read32(const char *source)
+    {
+        uint32_t value;
+        std::memcpy(&value, source, sizeof(value));
+        return value;
+    }
+
+    // Knuth's multiplicative hash of the next 4 bytes.
+    uint32_t hash(uint32_t sequence)
+    {
+        return (sequence * 2654435761u) >> (32 - HASH_BITS);
+    }
+
+    // Lengths past the 4 bit token field continue in bytes of 255 until one is smaller.
+    void writeLength(std::vector<char> &output, size_t length)
+    {
+        while (length >= 255)
+        {
+            output.push_back(static_cast<char>(255));
+            length -= 255;
+        }
+        output.push_back(static_cast<char>(length));
+    }
+
+    bool readLength(const unsigned char *source, size_t size, size_t &position, size_t &length)
+    {
+        unsigned char byte;
+        do
+        {
+            if (position >= size)
+            {
+                return false;
+            }
+            byte = source[position++];
+            length += byte;
+        } while (byte == 255);
+        return true;
+    }
+
+    void writeSequence(std::vector<char> &output, const char *literals, size_t literalLength, size_t offset, size_t matchLength)
+    {
+        bool hasMatch = matchLength >= MIN_MATCH;
+        size_t matchCode = hasMatch ? matchLength - MIN_MATCH : 0;
+        unsigned char token = static_cast<unsigned char>(((literalLength < 15 ? literalLength : 15) << 4) | (matchCode < 15 ? matchCode : 15));
+        output.push_back(static_cast<char>(token));
+        if (literalLength >= 15)
+        {
+            writeLength(output, literalLength - 15);
+        }
+        output.insert(output.end(), literals, literals + literalLength);
+        if (!hasMatch)
+        {
+            return;
+        }
+        output.push_back(static_cast<char>(offset & 0xFF));
+        output.push_back(static_cast<char>(offset >> 8));
+        if (matchCode >= 15)
+        {
+            writeLength(output, matchCode - 15);
+        }
+    }
+}
+
+size_t LZ4::CompressBound(size_t size)
+{
+    return size + size / 255 + 16;
+}
+
+std::vector<char> LZ4::Compress(const char *source, size_t size)
+{
+    std::vector<char> output;
+    output.reserve(CompressBound(size));
+    std::vector<uint32_t> table(size_t(1) << HASH_BITS, EMPTY_SLOT);
+
+    size_t anchor = 0;
+    size_t position = 0;
+    if (size > MATCH_FIND_LIMIT)
+    {
+        size_t lastMatchStart = size - MATCH_FIND_LIMIT;
+        size_t matchEndLimit = size - LAST_LITERALS;
+        while (position <= lastMatchStart)
+        {
+            uint32_t sequence = read32(source + position);
+            uint32_t &slot = table[hash(sequence)];
+            size_t candidate = slot;
+            slot = static_cast<uint32_t>(position);
+            if (candidate == EMPTY_SLOT || position - candidate > MAX_OFFSET || read32(source + candidate) != sequence)
+            {
+                position++;
+                continue;
+            }
+
+            size_t matchLength = MIN_MATCH;
+            while (position + matchLength < matchEndLimit && source[candidate + matchLength] == source[position + matchLength])
+            {
+                matchLength++;
+            }
+            writeSequence(output, source + anchor, position - anchor, position - candidate, matchLength);
+            position += matchLength;
+            anchor = position;
+        }
+    }
+    // Whatever is left goes out as a final literal-only sequence.
+    writeSequence(output, source + anchor, size - anchor, 0, 0);
+    return output;
+}
+
+bool LZ4::Decompress(const char *source, size_t size, char *destination, size_t decompressedSize)
+{
+    const unsigned char *input = reinterpret_cast<const unsigned char *>(source);
+    size_t position = 0;
+    size_t written = 0;
+    while (true)
+    {
+        if (position >= size)
+        {
+            return false;
+        }
+        unsigned char token = input[position++];
+
+        size_t literalLength = token >> 4;
+        if (literalLength == 15 && !readLength(input, size, position, literalLength))
+        {
+            return false;
+        }
+        if (literalLength > size - position || literalLength > decompressedSize - written)
+        {
+            return false;
+        }
+        if (literalLength > 0)
+        {
+            std::memcpy(destination + written, source + position, literalLength);
+        }
+        position += literalLength;
+        written += literalLength;
+
+        // The last sequence has no match part.
+        if (position == size)
+        {
+            return written == decompressedSize;
+        }
+
+        if (size - position < 2)
+        {
+            return false;
+        }
+        size_t offset = input[position] | (static_cast<size_t>(input[position + 1]) << 8);
+        position += 2;
+        if (offset == 0 || offset > written)
+        {
+            return false;
+        }
+
+        size_t matchLength = token & 15;
+        if (matchLength == 15 && !readLength(input, size, position, matchLength))
+        {
+            return false;
+        }
+        matchLength += MIN_MATCH;
+        if (matchLength > decompressedSize - written)
+        {
+            return false;
+        }
+        // Byte by byte: the match may overlap the bytes it is producing, that is how runs are encoded.
+        const char *match = destination + written - offset;
+        for (size_t i = 0; i < matchLength; i++)
+        {
+            destination[written + i] = match[i];
+        }
+        written += matchLength;
+    }
+}
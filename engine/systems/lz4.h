@@ -0,0 +1,21 @@
+#ifndef LZ4_H
+#define LZ4_H
+
+#include <vector>
+#include <cstddef>
+
+// LZ4 block format, compatible with the reference implementation's LZ4_compress_default / LZ4_decompress_safe.
+// Greedy single-probe matching: a lot less ratio than LZ4HC, but packing is a build step and reading is what matters,
+// and decoding is the same fast byte-oriented loop either way.
+// https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md
+namespace LZ4
+{
+    // Worst case size of a compressed block, incompressible data grows a little.
+    size_t CompressBound(size_t size);
+    std::vector<char> Compress(const char *source, size_t size);
+    // Decodes exactly decompressedSize bytes into destination. Returns false on corrupt or truncated input
+    // instead of reading or writing out of bounds.
+    bool Decompress(const char *source, size_t size, char *destination, size_t decompressedSize);
+}
+
+#endif
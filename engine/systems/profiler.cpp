@@ -0,0 +1,133 @@
+#ifdef ROGUE_PROFILER
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+#include "profiler.h"
+#include "jobsystem.h"
+
+namespace
+{
+    // One writer (the owning thread) and one occasional reader (WriteChromeTrace). The writer fills the slot
+    // and then publishes it by bumping head, so the reader never sees a zone that is only half written.
+    struct ThreadBuffer
+    {
+        std::vector<Profiler::Event> events = std::vector<Profiler::Event>(Profiler::EVENTS_PER_THREAD);
+        std::atomic<uint64_t> head{0};
+        uint32_t threadId = 0;
+        std::string name;
+    };
+
+    // Buffers outlive their threads, so the job system's workers still show up in a trace written after Shutdown.
+    std::mutex registryMutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+
+    thread_local ThreadBuffer *threadBuffer = nullptr;
+
+    const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+    ThreadBuffer &getThreadBuffer()
+    {
+        if (threadBuffer != nullptr)
+        {
+            return *threadBuffer;
+        }
+        // Once per thread, the only time recording takes a lock or allocates.
+        std::lock_guard<std::mutex> lock(registryMutex);
+        buffers.push_back(std::make_unique<ThreadBuffer>());
+        threadBuffer = buffers.back().get();
+        threadBuffer->threadId = static_cast<uint32_t>(buffers.size());
+        int32_t worker = JobSystem::GetCurrentWorkerIndex();
+        if (worker == 0)
+        {
+            threadBuffer->name = "main";
+        }
+        else if (worker > 0)
+        {
+            threadBuffer->name = "worker " + std::to_string(worker);
+        }
+        else
+        {
+            threadBuffer->name = "thread " + std::to_string(threadBuffer->threadId);
+        }
+        return *threadBuffer;
+    }
+
+    void writeEscaped(std::ofstream &file, const std::string &text)
+    {
+        for (char character : text)
+        {
+            if (character == '"' || character == '\\')
+            {
+                file << '\\';
+            }
+            file << character;
+        }
+    }
+}
+
+uint64_t Profiler::Now()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count());
+}
+
+void Profiler::Record(const char *name, uint64_t startNanoseconds, uint64_t endNanoseconds)
+{
+    ThreadBuffer &buffer = getThreadBuffer();
+    uint64_t head = buffer.head.load(std::memory_order_relaxed);
+    buffer.events[head % EVENTS_PER_THREAD] = {name, startNanoseconds, endNanoseconds};
+    buffer.head.store(head + 1, std::memory_order_release);
+}
+
+void Profiler::SetThreadName(const std::string &name)
+{
+    ThreadBuffer &buffer = getThreadBuffer();
+    std::lock_guard<std::mutex> lock(registryMutex);
+    buffer.name = name;
+}
+
+// Complete ("X") events with microsecond timestamps, plus one thread_name metadata event per thread.
+void Profiler::WriteChromeTrace(const std::string &path)
+{
+    std::ofstream file(path, std::ios::out | std::ios::trunc);
+    if (!file.is_open())
+    {
+        throw std::runtime_error("Failed to open trace file: " + path);
+    }
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    file << std::fixed << std::setprecision(3);
+    file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+    size_t eventCount = 0;
+    for (const std::unique_ptr<ThreadBuffer> &buffer : buffers)
+    {
+        file << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->threadId << ",\"args\":{\"name\":\"";
+        writeEscaped(file, buffer->name);
+        file << "\"}}";
+        first = false;
+
+        uint64_t head = buffer->head.load(std::memory_order_acquire);
+        uint64_t begin = head > EVENTS_PER_THREAD ? head - EVENTS_PER_THREAD : 0;
+        for (uint64_t i = begin; i < head; i++)
+        {
+            const Event &event = buffer->events[i % EVENTS_PER_THREAD];
+            file << ",\n{\"name\":\"";
+            writeEscaped(file, event.name);
+            file << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->threadId
+                 << ",\"ts\":" << event.startNanoseconds / 1000.0
+                 << ",\"dur\":" << (event.endNanoseconds - event.startNanoseconds) / 1000.0 << "}";
+        }
+        eventCount += head - begin;
+    }
+    file << "\n]}\n";
+    std::cout << "Wrote " << eventCount << " profiler zones from " << buffers.size() << " threads to " << path << std::endl;
+}
+
+#endif
\ No newline at end of file
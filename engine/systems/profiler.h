@@ -0,0 +1,75 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+// Scoped CPU zones for finding out where frame time goes. Configure with -DROGUE_ENABLE_PROFILER=ON to build it in,
+// otherwise every PROFILE_ macro expands to nothing and none of this is compiled.
+//
+//     void Game::update(double deltaSeconds)
+//     {
+//         PROFILE_ZONE("Game::update");
+//         ...
+//     }
+//
+// Every thread writes its zones into its own fixed size ring, so recording a zone is two clock reads and a store,
+// with no locks and no allocation after the thread's first zone. Once a ring is full the oldest zones are overwritten.
+// WriteChromeTrace turns the rings into trace event JSON that chrome://tracing and https://ui.perfetto.dev open.
+// https://docs.google.com/document/d/1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nSsKchNAySU
+#ifdef ROGUE_PROFILER
+
+#include <atomic>
+#include <string>
+#include <cstdint>
+
+namespace Profiler
+{
+    // Zones kept per thread, older ones are overwritten.
+    const uint32_t EVENTS_PER_THREAD = 65536;
+
+    struct Event
+    {
+        const char *name;
+        uint64_t startNanoseconds;
+        uint64_t endNanoseconds;
+    };
+
+    // Nanoseconds since the profiler's epoch, the first time anything asked for the time.
+    uint64_t Now();
+    // name has to stay valid until the trace is written, string literals and __func__ are what zones are meant for.
+    void Record(const char *name, uint64_t startNanoseconds, uint64_t endNanoseconds);
+    // Names the calling thread in the trace. Threads default to their job system worker index.
+    void SetThreadName(const std::string &name);
+    // Writes every thread's zones. Threads still recording while this runs may have their oldest zones
+    // overwritten mid-read, so call it once the frame loop is done.
+    void WriteChromeTrace(const std::string &path);
+
+    class Zone
+    {
+      public:
+        explicit Zone(const char *name) : _name(name), _start(Now()) {}
+        ~Zone() { Record(_name, _start, Now()); }
+        Zone(const Zone &) = delete;
+        Zone &operator=(const Zone &) = delete;
+
+      private:
+        const char *_name;
+        uint64_t _start;
+    };
+}
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_ZONE(name) Profiler::Zone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_ZONE(__func__)
+#define PROFILE_THREAD_NAME(name) Profiler::SetThreadName(name)
+#define PROFILE_WRITE_TRACE(path) Profiler::WriteChromeTrace(path)
+
+#else
+
+#define PROFILE_ZONE(name)
+#define PROFILE_FUNCTION()
+#define PROFILE_THREAD_NAME(name)
+#define PROFILE_WRITE_TRACE(path)
+
+#endif
+
+#endif
\ No newline at end of file
@@ -0,0 +1,163 @@
+#include <vulkan/vulkan.h>
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+
+#include "tilemap.h"
+#include "systems/profiler.h"
+
+void Tilemap::Init(uint32_t width, uint32_t height, uint32_t tilesetColumns, uint32_t tilesetRows)
+{
+    _width = width;
+    _height = height;
+    _chunksX = (width + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    _chunksY = (height + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    _tilesetColumns = std::max(tilesetColumns, 1u);
+    _tilesetRows = std::max(tilesetRows, 1u);
+
+    _chunks = std::vector<Chunk>(_chunksX * _chunksY);
+    for (Chunk &chunk : _chunks)
+    {
+        chunk.tiles.fill(EMPTY_TILE);
+        chunk.tints.fill(WHITE);
+    }
+    _instanceScratch.reserve(CHUNK_TILES);
+}
+
+void Tilemap::Cleanup(Memory::Allocator &allocator)
+{
+    for (Chunk &chunk : _chunks)
+    {
+        if (chunk.instances.buffer != VK_NULL_HANDLE)
+        {
+            allocator.DestroyBuffer(chunk.instances);
+        }
+    }
+    _chunks.clear();
+}
+
+void Tilemap::SetTile(uint32_t x, uint32_t y, uint16_t tile, uint32_t tint)
+{
+    if (x >= _width || y >= _height)
+    {
+        throw std::runtime_error("Tile out of tilemap bounds.");
+    }
+    Chunk &chunk = _chunks[(y / CHUNK_SIZE) * _chunksX + x / CHUNK_SIZE];
+    uint32_t index = (y % CHUNK_SIZE) * CHUNK_SIZE + x % CHUNK_SIZE;
+    if (chunk.tiles[index] != tile || chunk.tints[index] != tint)
+    {
+        chunk.tiles[index] = tile;
+        chunk.tints[index] = tint;
+        chunk.dirty = true;
+    }
+}
+
+void Tilemap::SetTileset(TextureCache::Handle texture, const glm::vec4 &uvRect)
+{
+    _tileset = texture;
+    _tilesetRect = uvRect;
+    for (Chunk &chunk : _chunks)
+    {
+        chunk.dirty = true;
+    }
+}
+
+uint16_t Tilemap::GetTile(uint32_t x, uint32_t y)
+{
+    if (x >= _width || y >= _height)
+    {
+        return EMPTY_TILE;
+    }
+    const Chunk &chunk = _chunks[(y / CHUNK_SIZE) * _chunksX + x / CHUNK_SIZE];
+    return chunk.tiles[(y % CHUNK_SIZE) * CHUNK_SIZE + x % CHUNK_SIZE];
+}
+
+void Tilemap::Render(Renderer &renderer)
+{
+    PROFILE_ZONE("Tilemap::Render");
+    _visibleChunks = 0;
+    _uploadedChunks = 0;
+    if (_chunks.empty())
+    {
+        return;
+    }
+
+    // The world rect the camera sees, in tiles (one tile is one world unit), turned straight into a chunk range.
+    // Only the chunks in that range are touched, so the cost follows the screen size instead of the map size.
+    const Camera2D &camera = renderer.GetCamera();
+    VkExtent2D extent = renderer.GetExtent();
+    float halfWidth = extent.width / (2.0f * camera.pixelsPerUnit);
+    float halfHeight = extent.height / (2.0f * camera.pixelsPerUnit);
+    float chunkSize = static_cast<float>(CHUNK_SIZE);
+    int64_t firstX = static_cast<int64_t>(std::floor((camera.position.x - halfWidth) / chunkSize));
+    int64_t lastX = static_cast<int64_t>(std::floor((camera.position.x + halfWidth) / chunkSize));
+    int64_t firstY = static_cast<int64_t>(std::floor((camera.position.y - halfHeight) / chunkSize));
+    int64_t lastY = static_cast<int64_t>(std::floor((camera.position.y + halfHeight) / chunkSize));
+    firstX = std::max<int64_t>(firstX, 0);
+    firstY = std::max<int64_t>(firstY, 0);
+    lastX = std::min<int64_t>(lastX, static_cast<int64_t>(_chunksX) - 1);
+    lastY = std::min<int64_t>(lastY, static_cast<int64_t>(_chunksY) - 1);
+
+    for (int64_t chunkY = firstY; chunkY <= lastY; chunkY++)
+    {
+        for (int64_t chunkX = firstX; chunkX <= lastX; chunkX++)
+        {
+            Chunk &chunk = _chunks[chunkY * _chunksX + chunkX];
+            _visibleChunks += 1;
+            if (chunk.dirty)
+            {
+                uploadChunk(renderer, static_cast<uint32_t>(chunkX), static_cast<uint32_t>(chunkY), chunk);
+            }
+            if (chunk.instanceCount == 0)
+            {
+                continue;
+            }
+
+            InstanceDraw draw = {};
+            draw.instanceBuffer = chunk.instances.buffer;
+            draw.instanceCount = chunk.instanceCount;
+            draw.texture = _tileset;
+            renderer.DrawInstances(draw);
+        }
+    }
+}
+
+// Rebuilds the chunk's instances from its tiles, skipping empty ones, and queues the copy on the renderer's uploader.
+// The copy goes out with the frame's upload submit ahead of the draw that reads it.
+void Tilemap::uploadChunk(Renderer &renderer, uint32_t chunkX, uint32_t chunkY, Chunk &chunk)
+{
+    float tileWidth = (_tilesetRect.z - _tilesetRect.x) / _tilesetColumns;
+    float tileHeight = (_tilesetRect.w - _tilesetRect.y) / _tilesetRows;
+    _instanceScratch.clear();
+    for (uint32_t i = 0; i < CHUNK_TILES; i++)
+    {
+        uint16_t tile = chunk.tiles[i];
+        if (tile == EMPTY_TILE)
+        {
+            continue;
+        }
+
+        float u = _tilesetRect.x + (tile % _tilesetColumns) * tileWidth;
+        float v = _tilesetRect.y + ((tile / _tilesetColumns) % _tilesetRows) * tileHeight;
+        Vertex::SpriteInstance instance = {};
+        instance.position = glm::vec2(static_cast<float>(chunkX * CHUNK_SIZE + i % CHUNK_SIZE), static_cast<float>(chunkY * CHUNK_SIZE + i / CHUNK_SIZE));
+        instance.size = glm::vec2(1.0f, 1.0f);
+        instance.uvRect = glm::vec4(u, v, u + tileWidth, v + tileHeight);
+        instance.tint = chunk.tints[i];
+        instance.layer = 0.0f;
+        _instanceScratch.push_back(instance);
+    }
+
+    if (chunk.instances.buffer == VK_NULL_HANDLE)
+    {
+        // Sized for a full chunk, so later edits never have to reallocate.
+        chunk.instances = renderer.GetAllocator().CreateBuffer(sizeof(Vertex::SpriteInstance) * CHUNK_TILES, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    }
+    if (!_instanceScratch.empty())
+    {
+        renderer.GetUploader().Enqueue(chunk.instances.buffer, 0, _instanceScratch.data(), sizeof(Vertex::SpriteInstance) * _instanceScratch.size());
+    }
+    chunk.instanceCount = static_cast<uint32_t>(_instanceScratch.size());
+    chunk.dirty = false;
+    _uploadedChunks += 1;
+}
\ No newline at end of file
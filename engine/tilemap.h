@@ -0,0 +1,69 @@
+#ifndef TILEMAP_H
+#define TILEMAP_H
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <array>
+#include <cstdint>
+
+#include "renderer/renderer.h"
+
+// A large tile grid stored as CHUNK_SIZE x CHUNK_SIZE chunks. Each chunk keeps its tiles in structure-of-arrays form
+// (tile ids and tints in separate arrays), so walking a chunk's tiles touches only the arrays that are needed.
+// Every chunk owns a DEVICE_LOCAL instance buffer. It is rebuilt and re-uploaded through the staging ring only when
+// its tiles changed, and only once it is on screen. Chunks outside the camera are never looked at.
+class Tilemap
+{
+  public:
+    static constexpr uint32_t CHUNK_SIZE = 32;
+    static constexpr uint32_t CHUNK_TILES = CHUNK_SIZE * CHUNK_SIZE;
+    static constexpr uint16_t EMPTY_TILE = 0xFFFF;
+    static constexpr uint32_t WHITE = 0xFFFFFFFF;
+
+    // tilesetColumns x tilesetRows is the grid tile ids index into, row major, for the UV rect of each tile.
+    void Init(uint32_t width, uint32_t height, uint32_t tilesetColumns, uint32_t tilesetRows);
+    // Frames in flight may still read chunk buffers, wait for the renderer to go idle first.
+    void Cleanup(Memory::Allocator &allocator);
+
+    uint32_t GetWidth() { return _width; }
+    uint32_t GetHeight() { return _height; }
+    void SetTile(uint32_t x, uint32_t y, uint16_t tile, uint32_t tint = WHITE);
+    uint16_t GetTile(uint32_t x, uint32_t y);
+    // The texture the tileset grid lives in, and where in it, so a tileset can be one sprite of an atlas page.
+    // Defaults to the white texture. Every chunk is re-uploaded the next time it is seen.
+    void SetTileset(TextureCache::Handle texture, const glm::vec4 &uvRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f));
+
+    // Culls chunks to the renderer's camera, uploads the visible chunks that changed and queues one
+    // instanced draw per visible, non-empty chunk.
+    void Render(Renderer &renderer);
+    uint32_t GetVisibleChunkCount() { return _visibleChunks; }
+    uint32_t GetUploadedChunkCount() { return _uploadedChunks; }
+
+  private:
+    struct Chunk
+    {
+        std::array<uint16_t, CHUNK_TILES> tiles;
+        std::array<uint32_t, CHUNK_TILES> tints;
+        Memory::Buffer instances = {}; // Created the first time the chunk is seen
+        uint32_t instanceCount = 0;
+        bool dirty = true;
+    };
+
+    uint32_t _width = 0;
+    uint32_t _height = 0;
+    uint32_t _chunksX = 0;
+    uint32_t _chunksY = 0;
+    uint32_t _tilesetColumns = 1;
+    uint32_t _tilesetRows = 1;
+    TextureCache::Handle _tileset = TextureCache::WHITE;
+    glm::vec4 _tilesetRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+    std::vector<Chunk> _chunks;
+    std::vector<Vertex::SpriteInstance> _instanceScratch;
+
+    uint32_t _visibleChunks = 0;
+    uint32_t _uploadedChunks = 0;
+
+    void uploadChunk(Renderer &renderer, uint32_t chunkX, uint32_t chunkY, Chunk &chunk);
+};
+
+#endif
\ No newline at end of file
@@ -1,17 +1,41 @@
 #include <stdexcept>
 #include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <string>
 #include <SDL2/SDL.h>
 
 #include "engine/game.h"
+#include "engine/systems/fileio.h"
+#include "engine/systems/jobsystem.h"
+#include "engine/systems/profiler.h"
 #include "main.h"
 
 int main(int argc, const char *argv[])
 {
     try
     {
-        init();
-        Game game = Game();
-        game.Run();
+        LaunchOptions options = parseArguments(argc, argv);
+        init(options.renderer.headless);
+        // Scoped so the game is gone before cleanup() stops the job system its asset loads run on.
+        {
+            Game game = Game(options.renderer);
+            game.SetMaxFrames(options.frames);
+            if (options.renderer.headless)
+            {
+                // Nobody is watching, render as fast as possible and the same frames every run.
+                game.SetFrameLimit(0.0);
+                game.SetLockstep(true);
+            }
+            game.Run();
+            if (!options.capturePath.empty())
+            {
+                game.SaveFrame(options.capturePath);
+            }
+        }
+        // Every zone since startup, for chrome://tracing or Perfetto. A no-op unless built with ROGUE_ENABLE_PROFILER.
+        PROFILE_WRITE_TRACE(std::getenv("ROGUE_PROFILE_TRACE") != nullptr ? std::getenv("ROGUE_PROFILE_TRACE") : "trace.json");
         cleanup();
 
         return EXIT_SUCCESS;
@@ -24,18 +48,77 @@ int main(int argc, const char *argv[])
     }
 }
 
-void init()
+// --headless           render offscreen, no window or display needed
+// --size WxH           resolution of the window or offscreen images
+// --frames N           quit after N frames
+// --capture file.ppm   save the last frame before quitting (headless only)
+LaunchOptions parseArguments(int argc, const char *argv[])
+{
+    LaunchOptions options;
+    for (int i = 1; i < argc; i++)
+    {
+        bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--headless") == 0)
+        {
+            options.renderer.headless = true;
+        }
+        else if (std::strcmp(argv[i], "--size") == 0 && hasValue)
+        {
+            unsigned int width = 0, height = 0;
+            if (std::sscanf(argv[++i], "%ux%u", &width, &height) != 2 || width == 0 || height == 0)
+            {
+                throw std::runtime_error("--size expects WIDTHxHEIGHT, like 1280x720.");
+            }
+            options.renderer.width = width;
+            options.renderer.height = height;
+        }
+        else if (std::strcmp(argv[i], "--frames") == 0 && hasValue)
+        {
+            options.frames = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (std::strcmp(argv[i], "--capture") == 0 && hasValue)
+        {
+            options.capturePath = argv[++i];
+        }
+        else
+        {
+            throw std::runtime_error("Unknown argument: " + std::string(argv[i]));
+        }
+    }
+    if (options.renderer.headless && options.frames == 0)
+    {
+        throw std::runtime_error("Headless runs need --frames, there is no window to close.");
+    }
+    return options;
+}
+
+void init(bool headless)
 {
     // Initialize SDL
+    // Headless only needs events and timers. Without the video subsystem there is nothing that needs a display,
+    // not even SDL's dummy video driver.
     std::cout << "Initializing SDL2..." << std::endl;
-    if (SDL_Init(SDL_INIT_EVERYTHING) < 0)
+    if (SDL_Init(headless ? SDL_INIT_EVENTS | SDL_INIT_TIMER : SDL_INIT_EVERYTHING) < 0)
     {
         throw std::runtime_error("Failed to initialize SDL2: " + (std::string)SDL_GetError());
     }
+
+    // Start the job system, this thread becomes its main thread
+    std::cout << "Starting job system..." << std::endl;
+    JobSystem::Init();
+    std::cout << "Job system running with " << JobSystem::GetWorkerCount() << " workers" << std::endl;
+
+    // Serve assets from the packed archive when the build made one, loose files otherwise
+    if (FileIOSystem::FileExists("./assets.pak"))
+    {
+        FileIOSystem::MountArchive("./assets.pak", "assets");
+    }
 }
 
 void cleanup()
 {
+    std::cout << "Stopping job system..." << std::endl;
+    JobSystem::Shutdown();
     std::cout << "Quitting SDL..." << std::endl;
     SDL_Quit();
 }
\ No newline at end of file
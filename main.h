@@ -1,7 +1,20 @@
 #ifndef MAIN_H
 #define MAIN_H
 
-void init();
+#include <string>
+#include <cstdint>
+
+#include "engine/renderer/renderer.h"
+
+struct LaunchOptions
+{
+    RendererOptions renderer;
+    uint64_t frames = 0;
+    std::string capturePath;
+};
+
+LaunchOptions parseArguments(int argc, const char *argv[]);
+void init(bool headless);
 void cleanup();
 
 #endif
\ No newline at end of file
@@ -0,0 +1,72 @@
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+
+#include "../engine/systems/archive.h"
+
+// Packs every file under a directory into one asset archive, see engine/systems/archive.h for the format.
+//
+//     assetpacker <output.pak> <directory> [--no-compress] [--exclude ext]...
+//
+// Entry names are paths relative to the directory, so packing build/assets and mounting the result at "assets"
+// serves exactly the paths the loose files had.
+int main(int argc, const char *argv[])
+{
+    if (argc < 3)
+    {
+        std::cerr << "Usage: assetpacker <output.pak> <directory> [--no-compress] [--exclude ext]..." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    try
+    {
+        std::string output = argv[1];
+        std::filesystem::path root = argv[2];
+        bool compress = true;
+        std::vector<std::string> excluded;
+        for (int i = 3; i < argc; i++)
+        {
+            if (std::strcmp(argv[i], "--no-compress") == 0)
+            {
+                compress = false;
+            }
+            else if (std::strcmp(argv[i], "--exclude") == 0 && i + 1 < argc)
+            {
+                excluded.push_back(argv[++i]);
+            }
+            else
+            {
+                throw std::runtime_error("Unknown argument: " + std::string(argv[i]));
+            }
+        }
+
+        std::vector<Archive::Input> inputs;
+        for (const std::filesystem::directory_entry &file : std::filesystem::recursive_directory_iterator(root))
+        {
+            if (!file.is_regular_file())
+            {
+                continue;
+            }
+            std::string extension = file.path().extension().string();
+            if (std::find(excluded.begin(), excluded.end(), extension) != excluded.end())
+            {
+                continue;
+            }
+            // generic_string for forward slashes on every platform.
+            inputs.push_back({file.path().lexically_relative(root).generic_string(), file.path().string()});
+        }
+
+        Archive::Pack(output, inputs, compress);
+        return EXIT_SUCCESS;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+}